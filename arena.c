@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+// alignment of all allocations, enough for every basic type
+#define ARENA_ALIGNMENT 16
+// size of the block header, rounded up so the block data is aligned
+#define ARENA_HEADER_SIZE ((sizeof(struct arena_block) + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1))
+
+/*
+ * Initialize an empty arena. No memory is allocated until the first allocation.
+ */
+void arena_init(struct arena *arena, size_t block_size) {
+    arena->current = NULL;
+    arena->block_size = block_size;
+    arena->block_count = 0;
+    arena->block_bytes = 0;
+    arena->alloc_count = 0;
+    arena->alloc_bytes = 0;
+}
+
+/*
+ * Get the start of the usable memory of a block.
+ */
+static char *block_data(struct arena_block *block) {
+    return (char*) block + ARENA_HEADER_SIZE;
+}
+
+/*
+ * Allocate memory from the arena. Allocations larger than the block size get their own block.
+ */
+void *arena_alloc(struct arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+    struct arena_block *block = arena->current;
+
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = malloc(ARENA_HEADER_SIZE + block_size);
+        if (block == NULL)
+            return NULL;
+        block->previous = arena->current;
+        block->size = block_size;
+        block->used = 0;
+        arena->current = block;
+        ++arena->block_count;
+        arena->block_bytes += ARENA_HEADER_SIZE + block_size;
+    }
+    ++arena->alloc_count;
+    arena->alloc_bytes += size;
+
+    void *memory = block_data(block) + block->used;
+    block->used += size;
+    return memory;
+}
+
+/*
+ * Copy a string with given length into the arena and terminate it. Returns NULL if there is not enough memory.
+ */
+char *arena_strndup(struct arena *arena, const char *str, size_t len) {
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy == NULL)
+        return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/*
+ * Get the current position of the arena.
+ */
+struct arena_mark arena_get_mark(struct arena *arena) {
+    struct arena_mark mark;
+    mark.block = arena->current;
+    mark.used = arena->current != NULL ? arena->current->used : 0;
+    return mark;
+}
+
+/*
+ * Release everything which was allocated after the mark was taken.
+ */
+void arena_reset(struct arena *arena, struct arena_mark mark) {
+    while (arena->current != mark.block) {
+        struct arena_block *previous = arena->current->previous;
+        free(arena->current);
+        arena->current = previous;
+    }
+    if (arena->current != NULL)
+        arena->current->used = mark.used;
+}
+
+/*
+ * Release all allocations but keep the first block, so an arena which is reused does not allocate again.
+ */
+void arena_clear(struct arena *arena) {
+    if (arena->current == NULL)
+        return;
+    struct arena_block *first = arena->current;
+    while (first->previous != NULL)
+        first = first->previous;
+    arena_reset(arena, (struct arena_mark) {first, 0});
+}
+
+/*
+ * Free all memory of the arena.
+ */
+void arena_free(struct arena *arena) {
+    struct arena_mark empty = {NULL, 0};
+    arena_reset(arena, empty);
+}
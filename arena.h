@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Block of memory of an arena. The allocatable memory directly follows the header.
+ */
+struct arena_block {
+    // previously filled block, NULL for the first block
+    struct arena_block *previous;
+    // usable size of this block in bytes
+    size_t size;
+    // number of bytes already handed out
+    size_t used;
+};
+
+/*
+ * Region allocator which hands out memory by bumping a pointer.
+ * Single allocations can not be freed, the whole arena is freed at once.
+ */
+struct arena {
+    // block which is currently filled
+    struct arena_block *current;
+    // default size of newly allocated blocks
+    size_t block_size;
+    // number and total size of the blocks allocated from the heap
+    long block_count;
+    size_t block_bytes;
+    // number and total size of the allocations handed out
+    long alloc_count;
+    size_t alloc_bytes;
+};
+
+/*
+ * Position in an arena, everything allocated after it can be released with arena_reset.
+ */
+struct arena_mark {
+    struct arena_block *block;
+    size_t used;
+};
+
+void arena_init(struct arena *arena, size_t block_size);
+
+void *arena_alloc(struct arena *arena, size_t size);
+
+char *arena_strndup(struct arena *arena, const char *str, size_t len);
+
+struct arena_mark arena_get_mark(struct arena *arena);
+
+void arena_reset(struct arena *arena, struct arena_mark mark);
+
+void arena_clear(struct arena *arena);
+
+void arena_free(struct arena *arena);
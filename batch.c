@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "parser.h"
+#include "optimizer.h"
+#include "simulator.h"
+#include "codegen.h"
+
+/*
+ * Initialize an empty batch.
+ */
+void batch_init(struct batch *batch, struct batch_options *options) {
+    memset(batch, 0, sizeof(struct batch));
+    batch->options = *options;
+}
+
+/*
+ * Add one program file to the batch. Its output file is the path with ".out" appended.
+ * Returns -1 if there is not enough memory, then the file is not added.
+ */
+static int add_batch_file(struct batch *batch, const char *path) {
+    if (batch->file_count == batch->file_capacity) {
+        int file_capacity = batch->file_capacity > 0 ? batch->file_capacity * 2 : 16;
+        struct batch_file *files = realloc(batch->files, file_capacity * sizeof(struct batch_file));
+        if (files == NULL)
+            return -1;
+        batch->files = files;
+        batch->file_capacity = file_capacity;
+    }
+    struct batch_file *file = &batch->files[batch->file_count];
+    memset(file, 0, sizeof(struct batch_file));
+    file->program_file_path = strdup(path);
+    file->output_file = malloc(strlen(path) + 5);
+    if (file->program_file_path == NULL || file->output_file == NULL) {
+        free(file->program_file_path);
+        free(file->output_file);
+        return -1;
+    }
+    sprintf(file->output_file, "%s.out", path);
+    ++batch->file_count;
+    return 0;
+}
+
+/*
+ * Check if a directory entry is a program file. Hidden files and the files written by the compiler are skipped,
+ * so compiling a directory twice compiles the same files.
+ */
+static int is_batch_program_file(const char *name) {
+    static const char *skipped_suffixes[] = {".out", ".cache", ".tmp"};
+    size_t len = strlen(name);
+    if (name[0] == '.')
+        return 0;
+    for (size_t i = 0; i < sizeof(skipped_suffixes) / sizeof(skipped_suffixes[0]); ++i) {
+        size_t suffix_len = strlen(skipped_suffixes[i]);
+        if (len >= suffix_len && strcmp(name + len - suffix_len, skipped_suffixes[i]) == 0)
+            return 0;
+    }
+    return 1;
+}
+
+static int compare_names(const void *name, const void *other) {
+    return strcmp(*(char**) name, *(char**) other);
+}
+
+/*
+ * Add a program file or all program files of a directory to the batch. The files of a directory are added
+ * sorted by name. Returns -1 if the directory can not be read or there is not enough memory for its files.
+ */
+int add_batch_input(struct batch *batch, char *path) {
+    struct stat file_stat;
+    if (stat(path, &file_stat) == -1 || !S_ISDIR(file_stat.st_mode)) {
+        // a missing file is added anyway and reported as failed compilation
+        return add_batch_file(batch, path);
+    }
+
+    DIR *directory = opendir(path);
+    if (directory == NULL)
+        return -1;
+    char **paths = NULL;
+    int path_count = 0;
+    int result = 0;
+    struct dirent *entry;
+    while (result == 0 && (entry = readdir(directory)) != NULL) {
+        if (!is_batch_program_file(entry->d_name))
+            continue;
+        char *file_path = malloc(strlen(path) + strlen(entry->d_name) + 2);
+        if (file_path == NULL) {
+            result = -1;
+            break;
+        }
+        sprintf(file_path, "%s/%s", path, entry->d_name);
+        if (stat(file_path, &file_stat) == -1 || !S_ISREG(file_stat.st_mode)) {
+            free(file_path);
+            continue;
+        }
+        char **new_paths = realloc(paths, (path_count + 1) * sizeof(char*));
+        if (new_paths == NULL) {
+            free(file_path);
+            result = -1;
+            break;
+        }
+        paths = new_paths;
+        paths[path_count++] = file_path;
+    }
+    closedir(directory);
+
+    if (result == 0)
+        qsort(paths, path_count, sizeof(char*), compare_names);
+    for (int i = 0; i < path_count; ++i) {
+        if (result == 0)
+            result = add_batch_file(batch, paths[i]);
+        free(paths[i]);
+    }
+    free(paths);
+    return result;
+}
+
+/*
+ * Compile one file of the batch and record the result in it.
+ */
+static void compile_batch_file(struct batch *batch, struct batch_file *file) {
+    // the files are compiled in parallel, so every compilation expands its lines sequentially
+    struct compile_options options = {.thread_count = 1, .cache_path = NULL};
+    struct program *program;
+    double start_time = get_seconds();
+
+    if (batch->options.stream) {
+        program = compile_program_streaming(file->program_file_path, file->output_file, &options, &file->error);
+    } else {
+        program = parse_program(file->program_file_path, &options, &file->error);
+        int result = 0;
+        if (program != NULL && batch->options.optimize) {
+            struct optimize_stats stats;
+            result = optimize_program(program, &stats);
+        }
+        if (program != NULL && result == 0 && batch->options.format == FORMAT_BINARY)
+            result = write_binary_program(program, file->output_file);
+        else if (program != NULL && result == 0 && batch->options.format == FORMAT_C)
+            result = write_c_program(program, file->output_file);
+        else if (program != NULL && result == 0)
+            result = write_compiled_program(program, file->output_file);
+        if (result == -1) {
+            file->error = program->error;
+            free_program(program);
+            program = NULL;
+        }
+    }
+
+    file->failed = program == NULL;
+    if (program != NULL) {
+        file->state_count = program->listed_state_count;
+        file->deltas_count = program->deltas_count + program->streamed_deltas_count;
+        free_program(program);
+    }
+    file->seconds = get_seconds() - start_time;
+}
+
+/*
+ * Thread function of the thread pool. Takes the next file of the batch until all are compiled.
+ */
+static void *run_batch_worker(void *argument) {
+    struct batch *batch = argument;
+    int index;
+    while ((index = atomic_fetch_add(&batch->next_file, 1)) < batch->file_count)
+        compile_batch_file(batch, &batch->files[index]);
+    return NULL;
+}
+
+/*
+ * Compile all files of the batch with a pool of options.thread_count threads. A thread takes the next
+ * file as soon as it finished its last one, so long and short compilations are balanced.
+ */
+void run_batch(struct batch *batch) {
+    int thread_count = batch->options.thread_count < batch->file_count ? batch->options.thread_count : batch->file_count;
+    pthread_t *threads = malloc(thread_count * sizeof(pthread_t));
+    double start_time = get_seconds();
+
+    atomic_store(&batch->next_file, 0);
+    int started_count = 0;
+    while (threads != NULL && started_count < thread_count && pthread_create(&threads[started_count], NULL, run_batch_worker, batch) == 0)
+        ++started_count;
+    // without any thread, e.g. if there is no memory for them, the files are compiled by the calling thread
+    if (started_count == 0)
+        run_batch_worker(batch);
+    for (int i = 0; i < started_count; ++i)
+        pthread_join(threads[i], NULL);
+    free(threads);
+
+    batch->seconds = get_seconds() - start_time;
+    batch->failed_count = 0;
+    for (int i = 0; i < batch->file_count; ++i)
+        batch->failed_count += batch->files[i].failed;
+}
+
+/*
+ * Print the result of every file in the order the files were given and a summary of the batch.
+ */
+void print_batch_report(struct batch *batch) {
+    double compile_seconds = 0;
+    for (int i = 0; i < batch->file_count; ++i) {
+        struct batch_file *file = &batch->files[i];
+        compile_seconds += file->seconds;
+        if (file->failed) {
+            printf("FAILED %s", file->program_file_path);
+            if (file->error.line > 0)
+                printf(":%d", file->error.line);
+            if (file->error.column > 0)
+                printf(":%d", file->error.column);
+            printf(": %s: %s\n", get_compile_error_name(file->error.code), file->error.message);
+        } else {
+            printf("OK     %s -> %s: %d states, %ld deltas in %.3f s\n", file->program_file_path, file->output_file,
+                   file->state_count, file->deltas_count, file->seconds);
+        }
+    }
+    printf("Compiled %d of %d files in %.3f s (%.3f s compile time) with %d threads, %d failed\n",
+           batch->file_count - batch->failed_count, batch->file_count, batch->seconds, compile_seconds,
+           batch->options.thread_count, batch->failed_count);
+}
+
+/*
+ * Free the files of the batch.
+ */
+void free_batch(struct batch *batch) {
+    for (int i = 0; i < batch->file_count; ++i) {
+        free(batch->files[i].program_file_path);
+        free(batch->files[i].output_file);
+    }
+    free(batch->files);
+}
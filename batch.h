@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdatomic.h>
+#include "program_helper.h"
+
+/*
+ * Options which apply to every file of a batch
+ */
+struct batch_options {
+    // number of files which are compiled at the same time
+    int thread_count;
+    // compile in streaming mode
+    int stream;
+    // format of the compiled programs
+    enum output_format format;
+    // optimize the compiled programs
+    int optimize;
+};
+
+/*
+ * One program file of a batch and the result of its compilation
+ */
+struct batch_file {
+    char *program_file_path;
+    // compiled program is written to <program file>.out
+    char *output_file;
+    // set if the compilation failed, then error describes why
+    int failed;
+    struct compile_error error;
+    // size of the compiled program
+    int state_count;
+    long deltas_count;
+    // compile time in seconds
+    double seconds;
+};
+
+/*
+ * Program files which are compiled independently on a thread pool. Every compilation has its own program struct,
+ * so an error in one file does not affect the others.
+ */
+struct batch {
+    struct batch_file *files;
+    int file_count;
+    // allocated size of files
+    int file_capacity;
+    struct batch_options options;
+    // index of the next file which is not yet taken by a thread
+    atomic_int next_file;
+    // number of failed compilations
+    int failed_count;
+    // wall time of the whole batch in seconds
+    double seconds;
+};
+
+void batch_init(struct batch *batch, struct batch_options *options);
+
+int add_batch_input(struct batch *batch, char *path);
+
+void run_batch(struct batch *batch);
+
+void print_batch_report(struct batch *batch);
+
+void free_batch(struct batch *batch);
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Benchmark of the compile phases on generated programs of growing size.
+# Every program is compiled with --time-phases, the time of the header, delta expansion and write phase,
+# the expanded deltas per second and the peak RSS are reported. With a results file every row is appended
+# to it as CSV together with the date and the git commit, so regressions can be tracked over time.
+#
+# Usage: bench/compile_bench.sh [compiler binary] [results file]
+# The generator options can be set with BENCH_OPTIONS, e.g. BENCH_OPTIONS="-a 64 -r 90", and the line
+# counts with BENCH_LINES. Compiler options like -j 4 or --stream can be set with BENCH_COMPILER_OPTIONS.
+
+COMPILER=${1:-./macro_compiler}
+RESULTS_FILE=$2
+BENCH_LINES=${BENCH_LINES:-"1000 10000 100000 400000"}
+BENCH_DIR=$(dirname "$0")
+TMP_DIR=$(mktemp -d)
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+COMMIT=$(git -C "$BENCH_DIR" rev-parse --short HEAD 2>/dev/null || echo unknown)
+DATE=$(date +%Y-%m-%dT%H:%M:%S)
+# shellcheck disable=SC2086
+OPTIONS=$(echo $BENCH_OPTIONS $BENCH_COMPILER_OPTIONS)
+if [ -n "$RESULTS_FILE" ] && [ ! -f "$RESULTS_FILE" ]; then
+    echo "date,commit,options,lines,deltas,header_s,deltas_s,write_s,total_s,deltas_per_s,peak_rss_mb" > "$RESULTS_FILE"
+fi
+
+printf "%8s %10s %9s %9s %9s %9s %14s %9s\n" lines deltas header expand write total "deltas/s" "RSS MB"
+for LINES in $BENCH_LINES; do
+    PROGRAM="$TMP_DIR/program_$LINES.mdelta"
+    # shellcheck disable=SC2086
+    "$BENCH_DIR/generate_program.sh" -l "$LINES" $BENCH_OPTIONS > "$PROGRAM" || exit 1
+    # shellcheck disable=SC2086
+    "$COMPILER" --time-phases $BENCH_COMPILER_OPTIONS "$PROGRAM" "$PROGRAM.out" > "$TMP_DIR/phases" || {
+        cat "$TMP_DIR/phases"
+        exit 1
+    }
+
+    ROW=$(awk -v lines="$LINES" '
+        /^Phase header:/ { header = $3 }
+        /^Phase deltas:/ { expand = $3 }
+        /^Phase write:/ { write = $3 }
+        /^Total:/ { total = $2 }
+        /^Expanded deltas:/ { deltas = $3; sub(",", "", deltas) }
+        /^Peak RSS:/ { rss = $3 }
+        END { printf "%d,%d,%.4f,%.4f,%.4f,%.4f,%.0f,%.1f", lines, deltas, header, expand, write, total, (total > 0 ? deltas / total : 0), rss }
+    ' "$TMP_DIR/phases")
+    echo "$ROW" | awk -F, '{ printf "%8d %10d %9.4f %9.4f %9.4f %9.4f %14.0f %9.1f\n", $1, $2, $3, $4, $5, $6, $7, $8 }'
+    if [ -n "$RESULTS_FILE" ]; then
+        echo "$DATE,$COMMIT,\"$OPTIONS\",$ROW" >> "$RESULTS_FILE"
+    fi
+    rm -f "$PROGRAM" "$PROGRAM.out"
+done
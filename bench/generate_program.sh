@@ -0,0 +1,101 @@
+#!/bin/sh
+# Generator of synthetic macro programs for benchmarks, written to stdout.
+#
+# Usage: bench/generate_program.sh [-a alphabet size] [-s states] [-l lines] [-m mix] [-r density] [-k symbols] [-x seed]
+#   -a  number of alphabet symbols besides the blank (default 16)
+#   -s  number of declared states (default 100)
+#   -l  number of delta lines (default 10000)
+#   -m  weights of the line kinds plain:[...]:{...}:*-(...) (default 1:1:1:1)
+#       plain  D: q1,s3,q7,s5,>             one delta
+#       [...]  D: q1,[s1|s4],q7,[s2|s0],>   1 to 1 list or [*], one delta per symbol
+#       {...}  D: q1,{s1|s4},q7,{s2|s0},>   1 to n lists, one delta per read symbol and write symbol
+#       *-()   D: q1,[*-(s1|s4)],q7,[*-(s1|s4)],>   wildcard without k symbols
+#   -r  percentage of lines with (*r)/(*w) substituted states (default 50)
+#   -k  number of symbols in the lists and the *-(...) difference (default 4)
+#   -x  seed of the random generator (default 1)
+#
+# A substituted line creates a new state for every read or write symbol, e.g. "q3(*r)" creates q3s0, q3s1, ...
+
+ALPHABET_SIZE=16
+STATES=100
+LINES=10000
+MIX=1:1:1:1
+DENSITY=50
+LIST_SIZE=4
+SEED=1
+while getopts "a:s:l:m:r:k:x:" OPTION; do
+    case $OPTION in
+        a) ALPHABET_SIZE=$OPTARG ;;
+        s) STATES=$OPTARG ;;
+        l) LINES=$OPTARG ;;
+        m) MIX=$OPTARG ;;
+        r) DENSITY=$OPTARG ;;
+        k) LIST_SIZE=$OPTARG ;;
+        x) SEED=$OPTARG ;;
+        *) sed -n '3,15p' "$0" | cut -c3-; exit 1 ;;
+    esac
+done
+
+awk -v symbols="$ALPHABET_SIZE" -v states="$STATES" -v lines="$LINES" -v mix="$MIX" -v density="$DENSITY" \
+    -v list_size="$LIST_SIZE" -v seed="$SEED" '
+function symbol() {
+    return "s" int(rand() * symbols)
+}
+# list of n different symbols separated by |
+function symbol_list(n,    i, j, picked, list, s) {
+    list = ""
+    split("", picked)
+    for (i = 0; i < n; ++i) {
+        do {
+            j = int(rand() * symbols)
+        } while (j in picked)
+        picked[j] = 1
+        list = list (i > 0 ? "|" : "") "s" j
+    }
+    return list
+}
+function movement() {
+    return substr("<>-", int(rand() * 3) + 1, 1)
+}
+BEGIN {
+    srand(seed)
+    if (list_size > symbols)
+        list_size = symbols
+    split(mix, weights, ":")
+    weight_sum = weights[1] + weights[2] + weights[3] + weights[4]
+
+    printf "S: start,accept,reject"
+    for (i = 0; i < states; ++i)
+        printf ",q%d", i
+    printf "\n"
+    printf "G:  "
+    for (i = 0; i < symbols; ++i)
+        printf ",s%d", i
+    printf "\n"
+
+    for (line = 0; line < lines; ++line) {
+        state = "q" int(rand() * states)
+        subsequent_state = "q" int(rand() * states)
+        kind = rand() * weight_sum
+        if (kind < weights[1]) {
+            # a plain delta has no list to substitute from
+            printf "D: %s,%s,%s,%s,%s\n", state, symbol(), subsequent_state, symbol(), movement()
+            continue
+        }
+        if (rand() * 100 < density) {
+            state = state "x" line "(*r)"
+            subsequent_state = subsequent_state "x" line "(*w)"
+        }
+        if (kind < weights[1] + weights[2]) {
+            if (rand() < 0.5)
+                printf "D: %s,[*],%s,[*],%s\n", state, subsequent_state, movement()
+            else
+                printf "D: %s,[%s],%s,[%s],%s\n", state, symbol_list(list_size), subsequent_state, symbol_list(list_size), movement()
+        } else if (kind < weights[1] + weights[2] + weights[3]) {
+            printf "D: %s,{%s},%s,{%s},%s\n", state, symbol_list(list_size), subsequent_state, symbol_list(list_size), movement()
+        } else {
+            difference = symbol_list(list_size)
+            printf "D: %s,[*-(%s)],%s,[*-(%s)],%s\n", state, difference, subsequent_state, difference, movement()
+        }
+    }
+}'
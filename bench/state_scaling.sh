@@ -0,0 +1,35 @@
+#!/bin/sh
+# Benchmark of the compile time depending on the number of generated states.
+# Every generated delta line creates 2 * ALPHABET_SIZE new states by (*r)/(*w) substitution,
+# so with interned state names the time per state should stay constant.
+#
+# Usage: bench/state_scaling.sh [compiler binary] [alphabet size]
+
+COMPILER=${1:-./macro_compiler}
+ALPHABET_SIZE=${2:-16}
+TMP_DIR=$(mktemp -d)
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+printf "%10s %10s %12s %14s\n" lines states seconds "us per state"
+for LINES in 250 500 1000 2000 4000 8000; do
+    PROGRAM="$TMP_DIR/states_$LINES.mdelta"
+    awk -v lines="$LINES" -v symbols="$ALPHABET_SIZE" 'BEGIN {
+        printf "S: start,accept,reject\n"
+        printf "G:  "
+        for (i = 0; i < symbols; ++i)
+            printf ",s%d", i
+        printf "\n"
+        printf "D: start,[*],q0x(*r),[*],>\n"
+        for (i = 0; i < lines; ++i)
+            printf "D: q%dx(*r),[*],q%dx(*w),[*],>\n", i, i + 1
+    }' > "$PROGRAM"
+
+    START=$(date +%s%N)
+    "$COMPILER" "$PROGRAM" "$PROGRAM.out" > /dev/null || exit 1
+    END=$(date +%s%N)
+
+    STATES=$(head -n 1 "$PROGRAM.out" | tr ',' '\n' | wc -l)
+    awk -v lines="$LINES" -v states="$STATES" -v ns="$((END - START))" 'BEGIN {
+        printf "%10d %10d %12.4f %14.3f\n", lines, states, ns / 1e9, ns / 1e3 / states
+    }'
+done
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Binary format of a compiled program, written with --format=bin.
+ *
+ * The file consists of the header followed by the sections it points to. All numbers are stored in the byte order
+ * of the compiling machine (little endian on x86) and every section starts at an offset aligned to 8 bytes,
+ * so the file can be memory mapped and used without deserialization:
+ * - string tables of the state names and alphabet symbols: an array of count + 1 uint32 offsets into a blob of
+ *   null terminated strings, name i starts at blob + offsets[i]
+ * - indexes of the states which are listed in the state line of the text format
+ * - all transitions as binary_delta structs, sorted by (state, read symbol)
+ * - transition index with state_count * alphabet_size + 1 uint32 entries. The transitions for state s and read
+ *   symbol a are deltas[index[s * alphabet_size + a]] up to deltas[index[s * alphabet_size + a + 1]], so the
+ *   transitions of any (state, symbol) pair are found in O(1). There can be more than one for nondeterministic programs.
+ */
+
+// first bytes of every binary program file
+#define BINARY_MAGIC "MTMB"
+// version of the format, incremented on incompatible changes
+#define BINARY_VERSION 1
+
+/*
+ * Header at the start of a binary program file. Offsets are in bytes from the start of the file.
+ */
+struct binary_header {
+    char magic[4];
+    uint32_t version;
+    // number of states including the ones not listed in the state line
+    uint32_t state_count;
+    // number of states listed in the state line
+    uint32_t listed_state_count;
+    uint32_t alphabet_size;
+    uint32_t reserved;
+    uint64_t deltas_count;
+    // uint32[state_count + 1]
+    uint64_t state_name_offsets;
+    // blob of null terminated state names
+    uint64_t state_names;
+    // uint32[listed_state_count]
+    uint64_t listed_states;
+    // uint32[alphabet_size + 1]
+    uint64_t alphabet_offsets;
+    // blob of null terminated alphabet symbols
+    uint64_t alphabet_names;
+    // binary_delta[deltas_count]
+    uint64_t deltas;
+    // uint32[state_count * alphabet_size + 1]
+    uint64_t index;
+    // size of the whole file
+    uint64_t file_size;
+};
+
+/*
+ * One transition in a binary program file.
+ */
+struct binary_delta {
+    uint32_t state;
+    uint32_t subsequent_state;
+    uint16_t read_symbol;
+    uint16_t write_symbol;
+    // Move direction of head. Can be '<', '>' and '-'.
+    char movement;
+    // always zero
+    char padding[3];
+};
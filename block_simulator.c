@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block_simulator.h"
+
+/*
+ * Create a block simulator for the table with a cache of at most cache_size bytes.
+ * Returns -1 if the block size is not between 1 and MAX_BLOCK_SIZE or the cache can not be allocated.
+ */
+int block_simulator_init(struct block_simulator *simulator, struct transition_table *table, int block_size, size_t cache_size) {
+    memset(simulator, 0, sizeof(struct block_simulator));
+    if (block_size < 1 || block_size > MAX_BLOCK_SIZE)
+        return -1;
+    simulator->table = table;
+    simulator->block_size = block_size;
+    // keep the entries aligned for their 64 bit step count
+    simulator->entry_size = (sizeof(struct block_entry) + 2 * block_size * sizeof(uint16_t) + 7) & ~(size_t) 7;
+
+    size_t slot_count = BLOCK_CACHE_PROBES;
+    while (slot_count * 2 * simulator->entry_size <= cache_size)
+        slot_count *= 2;
+    simulator->slots = calloc(slot_count, simulator->entry_size);
+    if (simulator->slots == NULL)
+        return -1;
+    simulator->stats.slot_count = slot_count;
+    simulator->stats.memory_used = slot_count * simulator->entry_size;
+    return 0;
+}
+
+/*
+ * Hash of the entry state, the entry side and the block contents. Never 0, which marks empty slots.
+ * The cells are mixed in 8 bytes at a time, a lookup hashes a block for every block the head enters.
+ */
+static uint32_t hash_block(int state, int side, const uint16_t *cells, int block_size) {
+    uint64_t hash = ((uint64_t) state << 1 | side) * 0x9E3779B97F4A7C15ull;
+    size_t len = block_size * sizeof(uint16_t);
+    const uint8_t *bytes = (const uint8_t*) cells;
+    for (size_t i = 0; i < len; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, len - i < 8 ? len - i : 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+    uint32_t result = (uint32_t) hash;
+    return result != 0 ? result : 1;
+}
+
+static struct block_entry *get_slot(struct block_simulator *simulator, size_t slot) {
+    return (struct block_entry*) (simulator->slots + (slot & (simulator->stats.slot_count - 1)) * simulator->entry_size);
+}
+
+/*
+ * Find the cached simulation of a block. Returns NULL if it is not cached.
+ */
+static struct block_entry *find_block(struct block_simulator *simulator, uint32_t hash, int state, int side, const uint16_t *cells) {
+    for (int probe = 0; probe < BLOCK_CACHE_PROBES; ++probe) {
+        struct block_entry *entry = get_slot(simulator, hash + probe);
+        if (entry->hash == 0)
+            return NULL;
+        if (entry->hash == hash && entry->state == state && entry->side == side
+            && memcmp(entry->cells, cells, simulator->block_size * sizeof(uint16_t)) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/*
+ * Get the slot for a new entry: the first empty slot of the probe sequence, or the first slot, whose entry is
+ * replaced, if all are used.
+ */
+static struct block_entry *insert_block(struct block_simulator *simulator, uint32_t hash) {
+    for (int probe = 0; probe < BLOCK_CACHE_PROBES; ++probe) {
+        struct block_entry *entry = get_slot(simulator, hash + probe);
+        if (entry->hash == 0) {
+            ++simulator->stats.entry_count;
+            return entry;
+        }
+    }
+    ++simulator->stats.evictions;
+    return get_slot(simulator, hash);
+}
+
+/*
+ * Run the program like run_program, but with the blocks of the tape as macro symbols. A block is simulated
+ * transition by transition the first time it is entered in a state with its contents, and in one cache lookup
+ * every further time, as long as the cached steps fit into the step limit. The head has to enter a block at its
+ * left or right cell for a lookup, after the start and after the tape grew it may be inside a block, then the
+ * block is simulated without caching. Steps are counted exactly. Returns -1 if the tape can not grow.
+ */
+int run_program_blocks(struct block_simulator *simulator, struct tape *tape, long long max_steps, struct run_result *result) {
+    struct transition_table *table = simulator->table;
+    const struct transition_action *actions = table->actions;
+    int block_size = simulator->block_size;
+    long row = (long) table->start_state * table->alphabet_size;
+    long long steps = 0;
+    long long step_limit = max_steps == 0 ? INT64_MAX : max_steps;
+    int halted = 0;
+    int status = 0;
+    uint16_t block[MAX_BLOCK_SIZE];
+    double start_time = get_seconds();
+
+    while (!halted && steps < step_limit) {
+        uint16_t *cells = tape->cells;
+        long head = tape->head;
+        long first = head - head % block_size;
+        long last = first + block_size - 1;
+        int state = row / table->alphabet_size;
+        int side = head == first ? 0 : (head == last ? 1 : -1);
+        // a block which is cut by the end of the tape or entered inside is not cached
+        int is_cacheable = side != -1 && last < tape->size;
+        uint32_t hash = 0;
+        struct block_entry *entry = NULL;
+
+        if (is_cacheable) {
+            ++simulator->stats.lookups;
+            hash = hash_block(state, side, cells + first, block_size);
+            entry = find_block(simulator, hash, state, side, cells + first);
+            // a cached block which would exceed the step limit is simulated, so the run stops at the exact step
+            if (entry != NULL && (long long) entry->steps > step_limit - steps)
+                entry = NULL;
+        }
+
+        if (entry != NULL) {
+            ++simulator->stats.hits;
+            simulator->stats.cached_steps += entry->steps;
+            memcpy(cells + first, entry->cells + block_size, block_size * sizeof(uint16_t));
+            row = (long) entry->exit_state * table->alphabet_size;
+            steps += entry->steps;
+            head = entry->exit_side == 0 ? first - 1 : last + 1;
+        } else {
+            if (is_cacheable)
+                memcpy(block, cells + first, block_size * sizeof(uint16_t));
+            // simulate the block transition by transition until the head leaves it
+            long long block_steps = 0;
+            long block_end = last < tape->size ? last : tape->size - 1;
+            while (head >= first && head <= block_end && steps < step_limit) {
+                const struct transition_action *action = &actions[row + cells[head]];
+                if (action->next_row < 0) {
+                    halted = 1;
+                    break;
+                }
+                cells[head] = action->write_symbol;
+                head += action->movement;
+                row = action->next_row;
+                ++steps;
+                ++block_steps;
+            }
+            // only a block which was left is cached, not one where the machine halted or reached the step limit
+            if (is_cacheable && (head < first || head > last)) {
+                entry = insert_block(simulator, hash);
+                entry->hash = hash;
+                entry->state = state;
+                entry->side = side;
+                entry->exit_state = row / table->alphabet_size;
+                entry->exit_side = head > last;
+                entry->steps = block_steps;
+                memcpy(entry->cells, block, block_size * sizeof(uint16_t));
+                memcpy(entry->cells + block_size, cells + first, block_size * sizeof(uint16_t));
+            }
+        }
+
+        tape->head = head;
+        if (head < 0 || head >= tape->size) {
+            // the head is at most one cell outside of the tape
+            tape->head = head < 0 ? 0 : tape->size - 1;
+            if (tape_grow(tape) == -1) {
+                status = -1;
+                break;
+            }
+            tape->head += head < 0 ? -1 : 1;
+        }
+    }
+
+    result->state = row / table->alphabet_size;
+    result->steps = steps;
+    result->accelerated_steps = simulator->stats.cached_steps;
+    result->step_limit_reached = !halted && status == 0;
+    result->interrupted = 0;
+    result->seconds = get_seconds() - start_time;
+    return status;
+}
+
+/*
+ * Print the hit rate and the memory use of the block cache.
+ */
+void print_block_stats(struct block_simulator *simulator) {
+    struct block_stats *stats = &simulator->stats;
+    printf("Block cache: %lld lookups, %lld hits (%.1f %%), %lld cached steps\n", stats->lookups, stats->hits,
+           stats->lookups > 0 ? 100.0 * stats->hits / stats->lookups : 0.0, stats->cached_steps);
+    printf("Block cache size: %lld of %zu entries used, %lld evictions, %.1f MB\n", stats->entry_count, stats->slot_count,
+           stats->evictions, stats->memory_used / (1024.0 * 1024.0));
+}
+
+/*
+ * Free the cache of the block simulator.
+ */
+void free_block_simulator(struct block_simulator *simulator) {
+    free(simulator->slots);
+}
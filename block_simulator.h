@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "simulator.h"
+
+/*
+ * Simulation of a deterministic program with blocks of block_size cells as macro symbols.
+ *
+ * When the head enters a block at its left or right cell, the machine is simulated inside the block until the
+ * head leaves it. The result (exit state, new block contents, exit side and steps) is stored in a bounded cache
+ * under the entry state, the entry side and the old block contents, so entering a block with the same contents
+ * in the same state again executes all its steps with one lookup.
+ */
+
+// Maximal number of cells of a block
+#define MAX_BLOCK_SIZE 64
+
+// Number of slots which are probed for an entry before an old entry is replaced
+#define BLOCK_CACHE_PROBES 8
+
+/*
+ * Cached simulation of one block
+ */
+struct block_entry {
+    // hash of entry state, entry side and block contents, 0 for an empty slot
+    uint32_t hash;
+    int32_t state;
+    int32_t exit_state;
+    // side the head entered and left the block: 0 left, 1 right
+    int8_t side;
+    int8_t exit_side;
+    // number of transitions executed inside the block
+    uint64_t steps;
+    // block_size cells before and block_size cells after the simulation
+    uint16_t cells[];
+};
+
+/*
+ * Statistics of the block cache
+ */
+struct block_stats {
+    // number of lookups when the head entered a block at its side
+    long long lookups;
+    long long hits;
+    // number of entries which replaced an older entry in a full probe sequence
+    long long evictions;
+    // number of used slots
+    long long entry_count;
+    // number of steps executed by cache hits
+    long long cached_steps;
+    // number of slots and bytes of the cache
+    size_t slot_count;
+    size_t memory_used;
+};
+
+struct block_simulator {
+    struct transition_table *table;
+    int block_size;
+    // bytes of one slot, struct block_entry and 2 * block_size cells
+    size_t entry_size;
+    // slot_count slots of entry_size bytes, slot_count is a power of 2
+    char *slots;
+    struct block_stats stats;
+};
+
+int block_simulator_init(struct block_simulator *simulator, struct transition_table *table, int block_size, size_t cache_size);
+
+int run_program_blocks(struct block_simulator *simulator, struct tape *tape, long long max_steps, struct run_result *result);
+
+void print_block_stats(struct block_simulator *simulator);
+
+void free_block_simulator(struct block_simulator *simulator);
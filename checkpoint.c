@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "parser.h"
+#include "writer.h"
+
+/*
+ * Hash of all transitions of the table, so a checkpoint is not resumed with another program.
+ */
+static uint64_t hash_transition_table(struct transition_table *table) {
+    uint64_t hash = UINT64_C(14695981039346656037);
+    size_t entry_count = (size_t) table->state_count * table->alphabet_size;
+    for (size_t i = 0; i < entry_count; ++i) {
+        struct transition_action *action = &table->actions[i];
+        uint64_t value = (uint64_t) (uint32_t) action->next_row << 32 | (uint64_t) action->write_symbol << 16 | (uint16_t) action->movement;
+        hash = (hash ^ value) * UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+/*
+ * Write the configuration to the checkpoint file. The file is written next to it and renamed, so a run which
+ * is killed while writing keeps its last checkpoint. Returns -1 if the file can not be written.
+ */
+int write_checkpoint(const char *path, struct transition_table *table, struct rle_configuration *configuration) {
+    struct output_writer writer;
+    struct checkpoint_header header;
+    struct rle_tape *tape = &configuration->tape;
+    char *temporary_path = malloc(strlen(path) + 5);
+    if (temporary_path == NULL)
+        return -1;
+    sprintf(temporary_path, "%s.tmp", path);
+
+    if (writer_open(&writer, temporary_path) == -1) {
+        free(temporary_path);
+        return -1;
+    }
+    memset(&header, 0, sizeof(struct checkpoint_header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+    header.version = CHECKPOINT_VERSION;
+    header.table_hash = hash_transition_table(table);
+    header.state_count = table->state_count;
+    header.alphabet_size = table->alphabet_size;
+    header.state = configuration->state;
+    header.symbol = tape->symbol;
+    header.steps = configuration->steps;
+    header.accelerated_steps = configuration->accelerated_steps;
+    header.position = tape->position;
+    header.peak_run_count = tape->peak_run_count;
+    header.left_count = tape->left.count;
+    header.right_count = tape->right.count;
+    writer_write(&writer, (char*) &header, sizeof(struct checkpoint_header));
+    writer_write(&writer, (char*) tape->left.runs, tape->left.count * sizeof(struct tape_run));
+    writer_write(&writer, (char*) tape->right.runs, tape->right.count * sizeof(struct tape_run));
+
+    int result = 0;
+    if (writer_close(&writer) == -1 || rename(temporary_path, path) == -1)
+        result = -1;
+    free(temporary_path);
+    return result;
+}
+
+/*
+ * Read the runs of one side of the tape. remaining is the number of bytes of the file after the runs which were read
+ * so far, a count which does not fit into them is rejected before anything is allocated. Returns -1 if the file
+ * ends early or a run is invalid.
+ */
+static int read_run_stack(FILE *file, uint64_t *remaining, struct rle_tape *tape, struct run_stack *stack, uint64_t count,
+                          uint32_t alphabet_size) {
+    if (count > *remaining / sizeof(struct tape_run))
+        return -1;
+    *remaining -= count * sizeof(struct tape_run);
+    stack->count = 0;
+    stack->capacity = count > 0 ? count : 1;
+    stack->runs = malloc(stack->capacity * sizeof(struct tape_run));
+    if (stack->runs == NULL || fread(stack->runs, sizeof(struct tape_run), count, file) != count)
+        return -1;
+    stack->count = count;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (stack->runs[i].length == 0 || stack->runs[i].symbol >= alphabet_size)
+            return -1;
+    }
+    // the bottom run of a stack is never blank, see push_tape_run
+    return count > 0 && stack->runs[0].symbol == tape->blank_symbol ? -1 : 0;
+}
+
+/*
+ * Read the configuration of a run from a checkpoint file. Returns -1 if the file can not be read, is corrupt or was
+ * written for another program, then the error of the program describes it and the configuration has no runs.
+ */
+int read_checkpoint(const char *path, struct transition_table *table, struct program *program, struct rle_configuration *configuration) {
+    struct checkpoint_header header;
+    struct rle_tape *tape = &configuration->tape;
+    struct stat file_stat;
+    tape->left = (struct run_stack) {NULL, 0, 0};
+    tape->right = (struct run_stack) {NULL, 0, 0};
+    program->line_num = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "Checkpoint file %s not found!", path);
+    if (fstat(fileno(file), &file_stat) == -1 || (uint64_t) file_stat.st_size < sizeof(struct checkpoint_header)
+        || fread(&header, sizeof(struct checkpoint_header), 1, file) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0
+        || header.version != CHECKPOINT_VERSION) {
+        fclose(file);
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "File %s is not a checkpoint!", path);
+    }
+    if (header.state_count != (uint32_t) table->state_count || header.alphabet_size != (uint32_t) table->alphabet_size
+        || header.table_hash != hash_transition_table(table)) {
+        fclose(file);
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Checkpoint file %s was written for another program!", path);
+    }
+
+    int blank = intern_find(&program->alphabet, " ", 1);
+    tape->blank_symbol = blank != -1 ? blank : 0;
+    tape->symbol = header.symbol;
+    tape->position = header.position;
+    tape->peak_run_count = header.peak_run_count;
+    uint64_t remaining = file_stat.st_size - sizeof(struct checkpoint_header);
+    if (header.state >= header.state_count || header.symbol >= header.alphabet_size
+        || read_run_stack(file, &remaining, tape, &tape->left, header.left_count, header.alphabet_size) == -1
+        || read_run_stack(file, &remaining, tape, &tape->right, header.right_count, header.alphabet_size) == -1) {
+        fclose(file);
+        free_rle_tape(tape);
+        tape->left = (struct run_stack) {NULL, 0, 0};
+        tape->right = (struct run_stack) {NULL, 0, 0};
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Checkpoint file %s is corrupt!", path);
+    }
+    fclose(file);
+
+    configuration->state = header.state;
+    configuration->steps = header.steps;
+    configuration->accelerated_steps = header.accelerated_steps;
+    return 0;
+}
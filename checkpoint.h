@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include "rle_tape.h"
+
+/*
+ * Checkpoint of a run on a run length compressed tape, written with --checkpoint and resumed with --resume.
+ *
+ * The file consists of the checkpoint_header followed by the runs of the left and the right stack of the tape as
+ * tape_run structs, each stack from the run farthest from the head to the run next to it. All numbers are stored
+ * in the byte order of the machine, like the binary program format. A checkpoint can only be resumed with the
+ * program it was written for, the header contains a hash of the transition table.
+ */
+
+// first bytes of every checkpoint file
+#define CHECKPOINT_MAGIC "MTCP"
+// version of the checkpoint format, incremented on incompatible changes
+#define CHECKPOINT_VERSION 1
+
+struct checkpoint_header {
+    char magic[4];
+    uint32_t version;
+    // hash of the transition table of the program
+    uint64_t table_hash;
+    uint32_t state_count;
+    uint32_t alphabet_size;
+    uint32_t state;
+    // symbol of the cell under the head
+    uint16_t symbol;
+    uint16_t reserved;
+    uint64_t steps;
+    uint64_t accelerated_steps;
+    int64_t position;
+    uint64_t peak_run_count;
+    uint64_t left_count;
+    uint64_t right_count;
+};
+
+int write_checkpoint(const char *path, struct transition_table *table, struct rle_configuration *configuration);
+
+int read_checkpoint(const char *path, struct transition_table *table, struct program *program, struct rle_configuration *configuration);
@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "codegen.h"
+#include "parser.h"
+#include "writer.h"
+
+// Ways a state is entered, they decide which labels of the state are written
+#define ENTERED_BY_MOVE 1
+#define ENTERED_WITHOUT_MOVE 2
+#define ENTERED_AT_START 4
+
+/*
+ * One transition of a state in the generated code
+ */
+struct generated_case {
+    uint16_t read_symbol;
+    // symbol which is written, -1 if the read symbol stays on the tape
+    int write_symbol;
+    // head movement: -1 left, 0 none, 1 right
+    int movement;
+    uint32_t subsequent_state;
+};
+
+// Runtime of the generated executable before the code of the states
+static const char *runtime_head =
+    "// Number of blank cells on both sides of the input on a new tape\n"
+    "#define INITIAL_TAPE_SIZE 4096\n"
+    "\n"
+    "// index of the cell where the input started, to report the head position relative to the input\n"
+    "static long origin;\n"
+    "\n"
+    "/*\n"
+    " * Double the size of the tape. The old cells are moved to the middle, so there is room in both directions.\n"
+    " */\n"
+    "static cell *grow_tape(cell *tape, long *size, long *head) {\n"
+    "    long offset = *size / 2;\n"
+    "    long new_size = *size * 2;\n"
+    "    cell *cells = malloc(new_size * sizeof(cell));\n"
+    "    if (cells == NULL) {\n"
+    "        printf(\"Could not grow the tape to %ld cells!\\n\", new_size);\n"
+    "        exit(-1);\n"
+    "    }\n"
+    "    for (long i = 0; i < offset; ++i)\n"
+    "        cells[i] = BLANK;\n"
+    "    memcpy(cells + offset, tape, *size * sizeof(cell));\n"
+    "    for (long i = offset + *size; i < new_size; ++i)\n"
+    "        cells[i] = BLANK;\n"
+    "    free(tape);\n"
+    "    *size = new_size;\n"
+    "    *head += offset;\n"
+    "    origin += offset;\n"
+    "    return cells;\n"
+    "}\n"
+    "\n"
+    "// head is -1 or size after a move off the tape, the unsigned comparison checks both ends at once\n"
+    "#define CHECK_TAPE if ((unsigned long) head >= (unsigned long) size) tape = grow_tape(tape, &size, &head)\n"
+    "#define COUNT_STEP(current) if (++steps == limit) { state = current; goto stopped; }\n"
+    "#define HALT(halt_state) do { state = halt_state; goto halted; } while (0)\n"
+    "\n"
+    "/*\n"
+    " * Run the machine from the start state until it halts or limit transitions are executed.\n"
+    " * Returns the state the machine stopped in.\n"
+    " */\n"
+    "static int run(cell **tape_ptr, long *size_ptr, long *head_ptr, unsigned long long limit, unsigned long long *steps_ptr, int *limit_reached) {\n"
+    "    cell *tape = *tape_ptr;\n"
+    "    long size = *size_ptr;\n"
+    "    long head = *head_ptr;\n"
+    "    unsigned long long steps = 0;\n"
+    "    *limit_reached = 0;\n";
+
+// Runtime of the generated executable after the code of the states
+static const char *runtime_tail =
+    "stopped:\n"
+    "    *limit_reached = 1;\n"
+    "    goto halted;\n"
+    "halted:\n"
+    "    *tape_ptr = tape;\n"
+    "    *size_ptr = size;\n"
+    "    *head_ptr = head;\n"
+    "    *steps_ptr = steps;\n"
+    "    return state;\n"
+    "}\n"
+    "\n"
+    "static double get_seconds(void) {\n"
+    "    struct timespec time;\n"
+    "    clock_gettime(CLOCK_MONOTONIC, &time);\n"
+    "    return time.tv_sec + time.tv_nsec * 1e-9;\n"
+    "}\n"
+    "\n"
+    "static cell get_input_symbol(const char *symbol, size_t len) {\n"
+    "    for (int i = 0; i < ALPHABET_SIZE; ++i) {\n"
+    "        if (strlen(symbol_names[i]) == len && memcmp(symbol_names[i], symbol, len) == 0)\n"
+    "            return i;\n"
+    "    }\n"
+    "    printf(\"Input symbol \\\"%.*s\\\" is not part of the alphabet!\\n\", (int) len, symbol);\n"
+    "    exit(-1);\n"
+    "}\n"
+    "\n"
+    "int main(int argc, char **argv) {\n"
+    "    long long max_steps = 0;\n"
+    "    int print_tape_content = 0;\n"
+    "    const char *input = NULL;\n"
+    "    for (int i = 1; i < argc; ++i) {\n"
+    "        if (strncmp(argv[i], \"--max-steps=\", 12) == 0)\n"
+    "            max_steps = atoll(argv[i] + 12);\n"
+    "        else if (strcmp(argv[i], \"--print-tape\") == 0)\n"
+    "            print_tape_content = 1;\n"
+    "        else\n"
+    "            input = argv[i];\n"
+    "    }\n"
+    "    if (input == NULL) {\n"
+    "        printf(\"Usage: %s [--max-steps=N] [--print-tape] INPUT\\n\", argv[0]);\n"
+    "        return -1;\n"
+    "    }\n"
+    "\n"
+    "    // the input symbols are separated by ',', if the input contains no ',' every character is one symbol\n"
+    "    size_t input_len = strlen(input);\n"
+    "    long size = input_len + 2 * INITIAL_TAPE_SIZE;\n"
+    "    cell *tape = malloc(size * sizeof(cell));\n"
+    "    if (tape == NULL) {\n"
+    "        printf(\"Could not allocate the tape for %zu input symbols!\\n\", input_len);\n"
+    "        exit(-1);\n"
+    "    }\n"
+    "    for (long i = 0; i < size; ++i)\n"
+    "        tape[i] = BLANK;\n"
+    "    origin = INITIAL_TAPE_SIZE;\n"
+    "    long head = origin;\n"
+    "    long position = origin;\n"
+    "    if (strchr(input, ',') != NULL) {\n"
+    "        const char *symbol = input;\n"
+    "        for (;;) {\n"
+    "            const char *separator = strchr(symbol, ',');\n"
+    "            size_t len = separator != NULL ? (size_t) (separator - symbol) : strlen(symbol);\n"
+    "            tape[position++] = get_input_symbol(symbol, len);\n"
+    "            if (separator == NULL)\n"
+    "                break;\n"
+    "            symbol = separator + 1;\n"
+    "        }\n"
+    "    } else {\n"
+    "        for (size_t i = 0; i < input_len; ++i)\n"
+    "            tape[position++] = get_input_symbol(input + i, 1);\n"
+    "    }\n"
+    "\n"
+    "    unsigned long long steps;\n"
+    "    int limit_reached;\n"
+    "    double start_time = get_seconds();\n"
+    "    int state = run(&tape, &size, &head, max_steps > 0 ? (unsigned long long) max_steps : ~0ULL, &steps, &limit_reached);\n"
+    "    double seconds = get_seconds() - start_time;\n"
+    "\n"
+    "    const char *reason = \"no transition\";\n"
+    "    if (limit_reached)\n"
+    "        reason = \"step limit reached\";\n"
+    "    else if (state == ACCEPT_STATE)\n"
+    "        reason = \"accepted\";\n"
+    "    else if (state == REJECT_STATE)\n"
+    "        reason = \"rejected\";\n"
+    "    printf(\"Halt state: %s (%s)\\n\", state_names[state], reason);\n"
+    "    printf(\"Steps: %llu\\n\", steps);\n"
+    "    printf(\"Time: %.3f s\\n\", seconds);\n"
+    "    if (seconds > 0)\n"
+    "        printf(\"Steps per second: %.0f\\n\", steps / seconds);\n"
+    "    if (print_tape_content) {\n"
+    "        long first = 0;\n"
+    "        long last = size - 1;\n"
+    "        while (first <= last && tape[first] == BLANK)\n"
+    "            ++first;\n"
+    "        while (last >= first && tape[last] == BLANK)\n"
+    "            --last;\n"
+    "        printf(\"Tape: \");\n"
+    "        for (long i = first; i <= last; ++i)\n"
+    "            printf(i == first ? \"%s\" : \",%s\", symbol_names[tape[i]]);\n"
+    "        printf(\"\\n\");\n"
+    "        printf(\"Head position: %ld\\n\", head - origin);\n"
+    "    }\n"
+    "    free(tape);\n"
+    "    return 0;\n"
+    "}\n";
+
+static void write_string(struct output_writer *writer, const char *text) {
+    writer_write(writer, text, strlen(text));
+}
+
+/*
+ * Write formatted text, only used for short lines without names.
+ */
+static void write_format(struct output_writer *writer, const char *format, ...) {
+    char buffer[256];
+    va_list arguments;
+    va_start(arguments, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    writer_write(writer, buffer, len < (int) sizeof(buffer) ? len : (int) sizeof(buffer) - 1);
+}
+
+/*
+ * Write the names of an intern table as array of C string literals. Quotes, backslashes and
+ * non printable characters are written as octal escapes.
+ */
+static void write_name_array(struct output_writer *writer, const char *array_name, const char *size_name, struct intern_table *names) {
+    write_format(writer, "static const char *%s[%s] = {\n", array_name, size_name);
+    for (int i = 0; i < names->count; ++i) {
+        write_string(writer, "    \"");
+        const unsigned char *name = (const unsigned char*) names->names[i];
+        for (unsigned int j = 0; j < names->lengths[i]; ++j) {
+            if (name[j] < 32 || name[j] > 126 || name[j] == '"' || name[j] == '\\' || name[j] == '?')
+                write_format(writer, "\\%03o", name[j]);
+            else
+                writer_write(writer, (const char*) &name[j], 1);
+        }
+        write_string(writer, "\",\n");
+    }
+    write_string(writer, "};\n\n");
+}
+
+static int compare_read_symbols(const void *a, const void *b) {
+    const struct generated_case *case_a = a, *case_b = b;
+    return (int) case_a->read_symbol - (int) case_b->read_symbol;
+}
+
+/*
+ * Order of the cases which groups the symbols with the same action.
+ */
+static int compare_actions(const void *a, const void *b) {
+    const struct generated_case *case_a = a, *case_b = b;
+    if (case_a->write_symbol != case_b->write_symbol)
+        return case_a->write_symbol < case_b->write_symbol ? -1 : 1;
+    if (case_a->movement != case_b->movement)
+        return case_a->movement - case_b->movement;
+    if (case_a->subsequent_state != case_b->subsequent_state)
+        return case_a->subsequent_state < case_b->subsequent_state ? -1 : 1;
+    return (int) case_a->read_symbol - (int) case_b->read_symbol;
+}
+
+static int same_action(struct generated_case *case_a, struct generated_case *case_b) {
+    return case_a->write_symbol == case_b->write_symbol && case_a->movement == case_b->movement
+           && case_a->subsequent_state == case_b->subsequent_state;
+}
+
+/*
+ * Write the write, move and jump of a case. After a move the jump goes to the tape check of the subsequent
+ * state, otherwise directly to its step count.
+ */
+static void write_action(struct output_writer *writer, struct generated_case *generated_case, const char *indent) {
+    if (generated_case->write_symbol != -1)
+        write_format(writer, "%stape[head] = %d;\n", indent, generated_case->write_symbol);
+    if (generated_case->movement < 0)
+        write_format(writer, "%s--head;\n", indent);
+    else if (generated_case->movement > 0)
+        write_format(writer, "%s++head;\n", indent);
+    write_format(writer, "%sgoto %s_%u;\n", indent, generated_case->movement != 0 ? "move" : "step", generated_case->subsequent_state);
+}
+
+/*
+ * Write the code of one state. Its entry labels fall through: "move_N" checks the tape bounds, "step_N" counts the
+ * step and "state_N" dispatches on the symbol under the head, so the checks exist once per state and not once per
+ * transition. The cases are sorted by action, symbols with the same action share their code.
+ */
+static void write_state(struct output_writer *writer, int state, int entered, struct generated_case *cases, int case_count, int alphabet_size) {
+    if (entered & ENTERED_BY_MOVE)
+        write_format(writer, "move_%d:\n    CHECK_TAPE;\n", state);
+    if (entered & ENTERED_WITHOUT_MOVE)
+        write_format(writer, "step_%d:\n", state);
+    if (entered & (ENTERED_BY_MOVE | ENTERED_WITHOUT_MOVE))
+        write_format(writer, "    COUNT_STEP(%d);\n", state);
+    if (entered & ENTERED_AT_START)
+        write_format(writer, "state_%d:\n", state);
+    if (case_count == 0) {
+        write_format(writer, "    HALT(%d);\n", state);
+        return;
+    }
+    qsort(cases, case_count, sizeof(struct generated_case), compare_actions);
+
+    // one action for every symbol needs no dispatch
+    if (case_count == alphabet_size && same_action(&cases[0], &cases[case_count - 1])) {
+        write_action(writer, &cases[0], "    ");
+        return;
+    }
+
+    write_string(writer, "    switch (tape[head]) {\n");
+    for (int i = 0; i < case_count; ++i) {
+        write_format(writer, "    case %d:\n", cases[i].read_symbol);
+        if (i + 1 < case_count && same_action(&cases[i], &cases[i + 1]))
+            continue;
+        write_action(writer, &cases[i], "        ");
+    }
+    if (case_count < alphabet_size)
+        write_format(writer, "    default:\n        HALT(%d);\n", state);
+    write_string(writer, "    }\n");
+}
+
+/*
+ * Write the program as C source to an opened writer, see codegen.h.
+ * Returns -1 if the program is not deterministic or there is not enough memory, the error is set in the program.
+ */
+int write_program_c(struct output_writer *writer, struct program *program) {
+    int state_count = program->states.count;
+    int alphabet_size = program->alphabet.count;
+    int start_state = program->listed_state_count > 0 ? program->listed_states[0] : -1;
+    int accept_state = program->listed_state_count > 1 ? program->listed_states[1] : -1;
+    int reject_state = program->listed_state_count > 2 ? program->listed_states[2] : -1;
+    int blank = intern_find(&program->alphabet, " ", 1);
+    program->line_num = 0;
+
+    if (start_state == -1)
+        return set_compile_error(program, COMPILE_ERROR_INCOMPLETE, NULL, "The program has no start state!");
+
+    // counting sort of the transitions by state, the accept and reject state have none, so the machine halts there
+    int *first = calloc(state_count + 1, sizeof(int));
+    struct generated_case *cases = malloc((program->deltas_count + 1) * sizeof(struct generated_case));
+    char *entered = calloc(state_count, sizeof(char));
+    if (first == NULL || cases == NULL || entered == NULL) {
+        free(first);
+        free(cases);
+        free(entered);
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to generate the code of %d states!", state_count);
+    }
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas *delta = &program->deltas[i];
+        if ((int) delta->state != accept_state && (int) delta->state != reject_state)
+            ++first[delta->state + 1];
+    }
+    for (int state = 0; state < state_count; ++state)
+        first[state + 1] += first[state];
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas *delta = &program->deltas[i];
+        if ((int) delta->state == accept_state || (int) delta->state == reject_state)
+            continue;
+        struct generated_case *generated_case = &cases[first[delta->state]++];
+        generated_case->read_symbol = delta->read_symbol;
+        generated_case->write_symbol = delta->write_symbol != delta->read_symbol ? delta->write_symbol : -1;
+        generated_case->movement = delta->movement == '<' ? -1 : (delta->movement == '>' ? 1 : 0);
+        generated_case->subsequent_state = delta->subsequent_state;
+        entered[delta->subsequent_state] |= generated_case->movement != 0 ? ENTERED_BY_MOVE : ENTERED_WITHOUT_MOVE;
+    }
+    // placing moved every start to the start of the next state, shift them back
+    for (int state = state_count; state > 0; --state)
+        first[state] = first[state - 1];
+    first[0] = 0;
+    entered[start_state] |= ENTERED_AT_START;
+
+    // a state must not have two transitions for the same symbol
+    for (int state = 0; state < state_count; ++state) {
+        struct generated_case *state_cases = &cases[first[state]];
+        int case_count = first[state + 1] - first[state];
+        qsort(state_cases, case_count, sizeof(struct generated_case), compare_read_symbols);
+        for (int i = 1; i < case_count; ++i) {
+            if (state_cases[i].read_symbol == state_cases[i - 1].read_symbol) {
+                set_compile_error(program, COMPILE_ERROR_NONDETERMINISTIC, NULL, "The program is nondeterministic, state %s has more than one transition for symbol \"%s\"!",
+                                  program->states.names[state], program->alphabet.names[state_cases[i].read_symbol]);
+                free(first);
+                free(cases);
+                free(entered);
+                return -1;
+            }
+        }
+    }
+
+    write_format(writer, "// Turing machine with %d states and %d symbols, generated by the macro compiler\n", state_count, alphabet_size);
+    write_string(writer, "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n#include <time.h>\n\n");
+    write_string(writer, alphabet_size <= 256 ? "typedef unsigned char cell;\n\n" : "typedef unsigned short cell;\n\n");
+    write_format(writer, "#define STATE_COUNT %d\n#define ALPHABET_SIZE %d\n", state_count, alphabet_size);
+    write_format(writer, "#define ACCEPT_STATE %d\n#define REJECT_STATE %d\n", accept_state, reject_state);
+    write_format(writer, "// blank symbol \" \", the first symbol if the alphabet contains no \" \"\n#define BLANK %d\n\n", blank != -1 ? blank : 0);
+    write_name_array(writer, "state_names", "STATE_COUNT", &program->states);
+    write_name_array(writer, "symbol_names", "ALPHABET_SIZE", &program->alphabet);
+
+    write_string(writer, runtime_head);
+    write_format(writer, "    int state = %d;\n    goto state_%d;\n\n", start_state, start_state);
+    // only states which can be entered get code
+    for (int state = 0; state < state_count; ++state) {
+        if (entered[state])
+            write_state(writer, state, entered[state], &cases[first[state]], first[state + 1] - first[state], alphabet_size);
+    }
+    write_string(writer, "\n");
+    write_string(writer, runtime_tail);
+
+    free(first);
+    free(cases);
+    free(entered);
+    return 0;
+}
+
+/*
+ * Write the program as C source to a file.
+ * Returns -1 if the file can not be written, the program is not deterministic or there is not enough memory,
+ * the error is set in the program.
+ */
+int write_c_program(struct program *program, char *filename) {
+    struct output_writer writer;
+    program->line_num = 0;
+    if (writer_open(&writer, filename) == -1)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not open output file %s!", filename);
+
+    int result = write_program_c(&writer, program);
+
+    if (writer_close(&writer) == -1 && result == 0)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not write output file %s!", filename);
+    return result;
+}
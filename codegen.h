@@ -0,0 +1,20 @@
+#pragma once
+
+#include "program_helper.h"
+
+/*
+ * Backend which writes a deterministic program as C source of a standalone executable.
+ *
+ * Every state becomes a label. The code of a state switches over the symbol under the head, each case writes,
+ * moves and jumps directly to the label of the subsequent state, so there is no dispatch loop and no
+ * transition table. Symbols with the same action share one case, a symbol is only written if it differs from
+ * the read symbol and the tape bounds and the step limit are checked once at the entry of a state instead of
+ * in every case.
+ *
+ * The executable is called like "machine [--max-steps=N] [--print-tape] INPUT" and prints the same result as
+ * the --run option of the compiler.
+ */
+
+int write_program_c(struct output_writer *writer, struct program *program);
+
+int write_c_program(struct program *program, char *filename);
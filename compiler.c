@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "parser.h"
+#include "optimizer.h"
+#include "codegen.h"
+
+/*
+ * Everything which is kept between the compilations of a context
+ */
+struct compiler_context {
+    // program which is reset and parsed again by every compilation
+    struct program *program;
+    // buffer of the output writer, WRITER_BUFFER_SIZE bytes
+    char *writer_buffer;
+    // output of compile_to_buffer
+    char *output;
+    size_t output_size;
+    // allocated size of output, grows geometrically
+    size_t output_capacity;
+};
+
+/*
+ * Create a context for compiling programs from memory. Returns NULL if there is not enough memory.
+ */
+struct compiler_context *create_compiler_context(void) {
+    struct compiler_context *context = calloc(1, sizeof(struct compiler_context));
+    if (context == NULL)
+        return NULL;
+    context->program = create_program(NULL);
+    context->writer_buffer = malloc(WRITER_BUFFER_SIZE);
+    if (context->program == NULL || context->writer_buffer == NULL) {
+        if (context->program != NULL)
+            free_program(context->program);
+        free(context->writer_buffer);
+        free(context);
+        return NULL;
+    }
+    return context;
+}
+
+/*
+ * Compile the program text in source and pass the compiled program in chunks to the sink.
+ * If options is NULL, the program is written in the text format without optimization.
+ * Returns 0 on success and -1 on error, then get_compiler_error describes it. The sink can abort the compilation
+ * by returning -1.
+ */
+int compile_to_sink(struct compiler_context *context, const char *source, size_t source_size, struct compiler_options *options,
+                    output_sink sink, void *sink_data) {
+    struct compiler_options default_options = {.format = FORMAT_TEXT, .optimize = 0, .thread_count = 1};
+    struct program *program = context->program;
+    struct line_reader reader;
+    struct output_writer writer;
+
+    if (options == NULL)
+        options = &default_options;
+    reset_program(program);
+    program->options.thread_count = options->thread_count > 1 ? options->thread_count : 1;
+    program->options.cache_path = NULL;
+    program->options.max_deltas = options->max_deltas;
+    program->options.max_states = options->max_states;
+
+    line_reader_open_buffer(&reader, source, source_size);
+    int result = parse_program_lines(program, &reader);
+    line_reader_close(&reader);
+    if (result == -1)
+        return -1;
+
+    if (options->optimize) {
+        struct optimize_stats stats;
+        if (optimize_program(program, &stats) == -1)
+            return -1;
+    }
+
+    writer_init_sink(&writer, sink, sink_data, context->writer_buffer);
+    if (options->format == FORMAT_BINARY)
+        result = write_program_binary(&writer, program);
+    else if (options->format == FORMAT_C)
+        result = write_program_c(&writer, program);
+    else
+        write_program_text(&writer, program);
+    if (writer_close(&writer) == -1 && result == 0)
+        result = set_compile_error(program, COMPILE_ERROR_SINK, NULL, "Output sink aborted the compilation!");
+    return result;
+}
+
+/*
+ * Sink which appends the output to the output buffer of the context.
+ */
+static int append_to_output(void *sink_data, const char *data, size_t len) {
+    struct compiler_context *context = sink_data;
+    if (context->output_capacity - context->output_size < len) {
+        size_t new_capacity = context->output_capacity > 0 ? context->output_capacity : 1 << 16;
+        while (new_capacity - context->output_size < len)
+            new_capacity *= 2;
+        char *output = realloc(context->output, new_capacity);
+        if (output == NULL)
+            return -1;
+        context->output = output;
+        context->output_capacity = new_capacity;
+    }
+    memcpy(context->output + context->output_size, data, len);
+    context->output_size += len;
+    return 0;
+}
+
+/*
+ * Compile the program text in source into a buffer of the context. Returns the compiled program, which is
+ * valid until the next compilation with the context, and its size in output_size. Returns NULL on error,
+ * then get_compiler_error describes it.
+ */
+const char *compile_to_buffer(struct compiler_context *context, const char *source, size_t source_size, struct compiler_options *options,
+                              size_t *output_size) {
+    context->output_size = 0;
+    if (compile_to_sink(context, source, source_size, options, append_to_output, context) == -1) {
+        // the only way the buffer sink fails is a failed allocation
+        if (context->program->error.code == COMPILE_ERROR_SINK)
+            context->program->error.code = COMPILE_ERROR_RESOURCE;
+        return NULL;
+    }
+    *output_size = context->output_size;
+    // keep an empty output a valid pointer
+    return context->output != NULL ? context->output : "";
+}
+
+/*
+ * Get the error of the last compilation of the context. The code is COMPILE_OK if it succeeded.
+ */
+struct compile_error *get_compiler_error(struct compiler_context *context) {
+    return &context->program->error;
+}
+
+/*
+ * Get the program of the last successful compilation, e.g. to run it. It is valid until the next compilation
+ * with the context and must not be freed.
+ */
+struct program *get_compiled_program(struct compiler_context *context) {
+    return context->program->error.code == COMPILE_OK ? context->program : NULL;
+}
+
+/*
+ * Free the context with all its buffers.
+ */
+void free_compiler_context(struct compiler_context *context) {
+    free_program(context->program);
+    free(context->writer_buffer);
+    free(context->output);
+    free(context);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include "program_helper.h"
+#include "writer.h"
+
+/*
+ * Interface to compile programs in memory, for embedding the compiler into other processes.
+ * Build the library with "make lib", which creates libmacro_compiler.a and libmacro_compiler.so.
+ *
+ * A compiler context keeps its program struct with the arenas, tables and delta array and its output buffers
+ * between compilations, so compiling many programs of similar size does not allocate again. The compiler uses no
+ * global state. No function of the library exits the process, the compiler and the execution engines return -1
+ * or NULL and describe the error in the program. A context must only be used by one thread at a time,
+ * different contexts can be used by different threads at the same time.
+ */
+
+/*
+ * Options of a compilation with a compiler context
+ */
+struct compiler_options {
+    // format of the compiled program
+    enum output_format format;
+    // optimize the compiled program before it is written
+    int optimize;
+    // number of threads which expand the delta lines, 1 expands them sequentially
+    int thread_count;
+    // maximum number of deltas and states of the compiled program, 0 for no limit.
+    // A source which exceeds them fails with COMPILE_ERROR_LIMIT and the line which exceeded them.
+    long long max_deltas;
+    long long max_states;
+};
+
+struct compiler_context;
+
+struct compiler_context *create_compiler_context(void);
+
+int compile_to_sink(struct compiler_context *context, const char *source, size_t source_size, struct compiler_options *options,
+                    output_sink sink, void *sink_data);
+
+const char *compile_to_buffer(struct compiler_context *context, const char *source, size_t source_size, struct compiler_options *options,
+                              size_t *output_size);
+
+struct compile_error *get_compiler_error(struct compiler_context *context);
+
+struct program *get_compiled_program(struct compiler_context *context);
+
+void free_compiler_context(struct compiler_context *context);
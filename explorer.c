@@ -0,0 +1,721 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "explorer.h"
+#include "parser.h"
+
+// Number of shards of the visited set, every shard has its own lock
+#define SHARD_COUNT 64
+// Initial number of slots of a shard, always a power of two
+#define INITIAL_SHARD_SLOT_COUNT 1024
+// Number of configurations a worker takes from its frontier range at once
+#define CLAIM_CONFIGURATION_COUNT 32
+
+/*
+ * Part of the set of visited configurations. Open addressing with linear probing.
+ */
+struct visited_shard {
+    pthread_mutex_t lock;
+    // configurations in the set, NULL for empty slots
+    struct configuration **slots;
+    // number of slots, always a power of two
+    size_t slot_count;
+    // number of configurations in the shard
+    size_t count;
+};
+
+/*
+ * Range of the current frontier which belongs to a worker. Other workers steal from its end.
+ */
+struct frontier_range {
+    pthread_mutex_t lock;
+    // index of the next configuration which is not yet taken
+    size_t next;
+    // end of the range in the frontier
+    size_t end;
+};
+
+/*
+ * Thread which expands configurations of the frontier
+ */
+struct explorer_worker {
+    pthread_t thread;
+    int index;
+    struct explorer *explorer;
+    // part of the frontier which is expanded by this worker
+    struct frontier_range range;
+    // new configurations, which form the next frontier together with the ones of the other workers
+    struct configuration **next_frontier;
+    size_t next_frontier_count;
+    size_t next_frontier_capacity;
+    // arena of all configurations found by this worker
+    struct arena arena;
+    // decoded tape of the configuration which is expanded
+    uint16_t *cells;
+    size_t cells_capacity;
+    // encoding of a new configuration before it is checked against the visited set
+    struct configuration *encoded;
+    size_t encoded_capacity;
+    long long duplicate_count;
+};
+
+/*
+ * State of a breadth first exploration of the configuration tree
+ */
+struct explorer {
+    struct program *program;
+    struct ntm_table *table;
+    struct explore_options options;
+    // number of bits of a packed cell
+    int bits_per_symbol;
+    uint16_t blank_symbol;
+    struct visited_shard shards[SHARD_COUNT];
+    struct explorer_worker *workers;
+    // the workers wait on it for the start of a depth and the main thread for the end of the depth
+    pthread_barrier_t level_barrier;
+    // held by the main thread while it starts the workers, the barrier is only ready after all threads started
+    pthread_mutex_t start_lock;
+    // set by the main thread before the last start of a depth, the workers then exit
+    int finished;
+    // configurations of the current depth
+    struct configuration **frontier;
+    size_t frontier_count;
+    size_t frontier_capacity;
+    // set when an accepting configuration is found or the memory limit is reached
+    atomic_int stop;
+    atomic_int memory_limit_reached;
+    atomic_size_t memory_used;
+    atomic_llong configuration_count;
+    _Atomic(struct configuration *) accepting_configuration;
+    // first error of a worker, NULL if none, it stops the exploration
+    _Atomic(const char *) error_message;
+};
+
+/*
+ * Build the transition index of a nondeterministic program with a counting sort of the deltas by (state, read symbol).
+ * Transitions of the accept and reject state are left out, the machine halts in them.
+ */
+int build_ntm_table(struct ntm_table *table, struct program *program) {
+    table->state_count = program->states.count;
+    table->alphabet_size = program->alphabet.count;
+    table->start_state = program->listed_state_count > 0 ? program->listed_states[0] : -1;
+    table->accept_state = program->listed_state_count > 1 ? program->listed_states[1] : -1;
+    table->reject_state = program->listed_state_count > 2 ? program->listed_states[2] : -1;
+
+    table->index = NULL;
+    table->actions = NULL;
+
+    program->line_num = 0;
+    if (table->start_state == -1)
+        return set_compile_error(program, COMPILE_ERROR_INCOMPLETE, NULL, "The program has no start state!");
+
+    size_t key_count = (size_t) table->state_count * table->alphabet_size;
+    if (key_count > INT32_MAX)
+        return set_compile_error(program, COMPILE_ERROR_LIMIT, NULL, "The transition table for %d states and %d symbols is too large!",
+                                 table->state_count, table->alphabet_size);
+    table->index = calloc(key_count + 1, sizeof(uint32_t));
+    table->actions = malloc((program->deltas_count + 1) * sizeof(struct transition_action));
+    if (table->index == NULL || table->actions == NULL) {
+        free_ntm_table(table);
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the transition index!");
+    }
+
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas *delta = &program->deltas[i];
+        if ((int) delta->state != table->accept_state && (int) delta->state != table->reject_state)
+            ++table->index[(size_t) delta->state * table->alphabet_size + delta->read_symbol + 1];
+    }
+    for (size_t key = 0; key < key_count; ++key)
+        table->index[key + 1] += table->index[key];
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas *delta = &program->deltas[i];
+        if ((int) delta->state == table->accept_state || (int) delta->state == table->reject_state)
+            continue;
+        struct transition_action *action = &table->actions[table->index[(size_t) delta->state * table->alphabet_size + delta->read_symbol]++];
+        action->next_row = delta->subsequent_state * table->alphabet_size;
+        action->write_symbol = delta->write_symbol;
+        action->movement = delta->movement == '<' ? -1 : (delta->movement == '>' ? 1 : 0);
+    }
+    // placing moved every start to the start of the next key, shift them back
+    for (size_t key = key_count; key > 0; --key)
+        table->index[key] = table->index[key - 1];
+    table->index[0] = 0;
+    return 0;
+}
+
+/*
+ * Free the transition index.
+ */
+void free_ntm_table(struct ntm_table *table) {
+    free(table->index);
+    free(table->actions);
+    table->index = NULL;
+    table->actions = NULL;
+}
+
+/*
+ * Stop the exploration because of an error. Only the first error is kept.
+ */
+static void fail_exploration(struct explorer *explorer, const char *message) {
+    const char *expected = NULL;
+    atomic_compare_exchange_strong(&explorer->error_message, &expected, message);
+    atomic_store(&explorer->stop, 1);
+}
+
+/*
+ * Get the size of an encoded configuration with the given number of cells.
+ */
+static size_t get_configuration_size(struct explorer *explorer, size_t cell_count) {
+    return sizeof(struct configuration) + (cell_count * explorer->bits_per_symbol + 7) / 8;
+}
+
+/*
+ * FNV-1a hash of the state, head, cell count and packed cells of a configuration.
+ */
+static uint32_t hash_configuration(struct explorer *explorer, struct configuration *configuration) {
+    const uint8_t *bytes = (const uint8_t*) &configuration->state;
+    size_t size = get_configuration_size(explorer, configuration->cell_count) - offsetof(struct configuration, state);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Encode the cells first to last of a tape into the scratch configuration of the worker.
+ * Returns NULL and stops the exploration if the scratch configuration can not grow.
+ */
+static struct configuration *encode_configuration(struct explorer_worker *worker, uint32_t state, const uint16_t *cells,
+                                                  long first, long last, long head) {
+    struct explorer *explorer = worker->explorer;
+    size_t cell_count = last - first + 1;
+    size_t size = get_configuration_size(explorer, cell_count);
+    if (size > worker->encoded_capacity) {
+        free(worker->encoded);
+        worker->encoded = malloc(size * 2);
+        if (worker->encoded == NULL) {
+            worker->encoded_capacity = 0;
+            fail_exploration(explorer, "Not enough memory for the configurations!");
+            return NULL;
+        }
+        worker->encoded_capacity = size * 2;
+    }
+
+    struct configuration *configuration = worker->encoded;
+    configuration->state = state;
+    configuration->head = head - first;
+    configuration->cell_count = cell_count;
+
+    // pack the cells, a symbol has at most 16 bits, so the bit buffer never overflows
+    uint64_t bit_buffer = 0;
+    int buffered_bits = 0;
+    size_t position = 0;
+    for (long i = first; i <= last; ++i) {
+        bit_buffer |= (uint64_t) cells[i] << buffered_bits;
+        buffered_bits += explorer->bits_per_symbol;
+        while (buffered_bits >= 8) {
+            configuration->cells[position++] = bit_buffer & 0xff;
+            bit_buffer >>= 8;
+            buffered_bits -= 8;
+        }
+    }
+    if (buffered_bits > 0)
+        configuration->cells[position] = bit_buffer;
+
+    configuration->hash = hash_configuration(explorer, configuration);
+    return configuration;
+}
+
+/*
+ * Decode the cells of a configuration into the cell buffer of the worker, with one blank cell on each side
+ * so the head can move out of the stored cells. Returns the number of decoded cells including the blanks,
+ * 0 if the cell buffer can not grow.
+ */
+static size_t decode_configuration(struct explorer_worker *worker, struct configuration *configuration) {
+    struct explorer *explorer = worker->explorer;
+    size_t cell_count = configuration->cell_count + 2;
+    if (cell_count > worker->cells_capacity) {
+        free(worker->cells);
+        worker->cells = malloc(cell_count * 2 * sizeof(uint16_t));
+        if (worker->cells == NULL) {
+            worker->cells_capacity = 0;
+            fail_exploration(explorer, "Not enough memory for the configurations!");
+            return 0;
+        }
+        worker->cells_capacity = cell_count * 2;
+    }
+
+    uint16_t mask = (1 << explorer->bits_per_symbol) - 1;
+    uint64_t bit_buffer = 0;
+    int buffered_bits = 0;
+    size_t position = 0;
+    worker->cells[0] = explorer->blank_symbol;
+    for (size_t i = 1; i <= configuration->cell_count; ++i) {
+        while (buffered_bits < explorer->bits_per_symbol) {
+            bit_buffer |= (uint64_t) configuration->cells[position++] << buffered_bits;
+            buffered_bits += 8;
+        }
+        worker->cells[i] = bit_buffer & mask;
+        bit_buffer >>= explorer->bits_per_symbol;
+        buffered_bits -= explorer->bits_per_symbol;
+    }
+    worker->cells[cell_count - 1] = explorer->blank_symbol;
+    return cell_count;
+}
+
+/*
+ * Add the configuration to the memory usage and stop the exploration if the memory limit is exceeded.
+ */
+static void add_memory_usage(struct explorer *explorer, size_t size) {
+    size_t memory_used = atomic_fetch_add(&explorer->memory_used, size) + size;
+    if (explorer->options.max_memory != 0 && memory_used > explorer->options.max_memory) {
+        atomic_store(&explorer->memory_limit_reached, 1);
+        atomic_store(&explorer->stop, 1);
+    }
+}
+
+/*
+ * Double the number of slots of a shard. The shard has to be locked. If there is not enough memory, the shard
+ * keeps its slots and the exploration stops.
+ */
+static void grow_shard(struct explorer *explorer, struct visited_shard *shard) {
+    size_t slot_count = shard->slot_count * 2;
+    struct configuration **slots = calloc(slot_count, sizeof(struct configuration*));
+    if (slots == NULL) {
+        fail_exploration(explorer, "Not enough memory for the visited configurations!");
+        return;
+    }
+    for (size_t i = 0; i < shard->slot_count; ++i) {
+        struct configuration *configuration = shard->slots[i];
+        if (configuration == NULL)
+            continue;
+        size_t slot = (configuration->hash / SHARD_COUNT) & (slot_count - 1);
+        while (slots[slot] != NULL)
+            slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = configuration;
+    }
+    free(shard->slots);
+    shard->slots = slots;
+    add_memory_usage(explorer, shard->slot_count * sizeof(struct configuration*));
+    shard->slot_count = slot_count;
+}
+
+/*
+ * Add the encoded configuration of the worker to the visited set. Returns the copy in the worker arena
+ * or NULL if the configuration was already visited or there is not enough memory for it.
+ */
+static struct configuration *visit_configuration(struct explorer_worker *worker, struct configuration *encoded) {
+    struct explorer *explorer = worker->explorer;
+    struct visited_shard *shard = &explorer->shards[encoded->hash % SHARD_COUNT];
+    size_t size = get_configuration_size(explorer, encoded->cell_count);
+
+    pthread_mutex_lock(&shard->lock);
+    size_t slot = (encoded->hash / SHARD_COUNT) & (shard->slot_count - 1);
+    for (struct configuration *other; (other = shard->slots[slot]) != NULL; slot = (slot + 1) & (shard->slot_count - 1)) {
+        if (other->hash == encoded->hash && other->cell_count == encoded->cell_count && memcmp(other, encoded, size) == 0) {
+            pthread_mutex_unlock(&shard->lock);
+            ++worker->duplicate_count;
+            return NULL;
+        }
+    }
+
+    // a shard which could not grow is never filled up, so every probe still ends at an empty slot
+    struct configuration *configuration = shard->count + 1 < shard->slot_count ? arena_alloc(&worker->arena, size) : NULL;
+    if (configuration == NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        fail_exploration(explorer, "Not enough memory for the visited configurations!");
+        return NULL;
+    }
+    memcpy(configuration, encoded, size);
+    shard->slots[slot] = configuration;
+    // keep the load factor below one half
+    if (++shard->count * 2 > shard->slot_count)
+        grow_shard(explorer, shard);
+    pthread_mutex_unlock(&shard->lock);
+
+    add_memory_usage(explorer, size);
+    atomic_fetch_add(&explorer->configuration_count, 1);
+    return configuration;
+}
+
+/*
+ * Append a configuration to the next frontier of the worker. Stops the exploration if the frontier can not grow.
+ */
+static void add_to_next_frontier(struct explorer_worker *worker, struct configuration *configuration) {
+    if (worker->next_frontier_count == worker->next_frontier_capacity) {
+        size_t capacity = worker->next_frontier_capacity == 0 ? 1024 : worker->next_frontier_capacity * 2;
+        struct configuration **next_frontier = realloc(worker->next_frontier, capacity * sizeof(struct configuration*));
+        if (next_frontier == NULL) {
+            fail_exploration(worker->explorer, "Not enough memory for the frontier!");
+            return;
+        }
+        worker->next_frontier = next_frontier;
+        worker->next_frontier_capacity = capacity;
+    }
+    worker->next_frontier[worker->next_frontier_count++] = configuration;
+}
+
+/*
+ * Check a new configuration: stop on accept, otherwise add it to the next frontier if the machine can continue.
+ */
+static void handle_new_configuration(struct explorer_worker *worker, struct configuration *configuration) {
+    struct explorer *explorer = worker->explorer;
+    if ((int) configuration->state == explorer->table->accept_state) {
+        struct configuration *expected = NULL;
+        atomic_compare_exchange_strong(&explorer->accepting_configuration, &expected, configuration);
+        atomic_store(&explorer->stop, 1);
+    } else if ((int) configuration->state != explorer->table->reject_state) {
+        add_to_next_frontier(worker, configuration);
+    }
+}
+
+/*
+ * Generate all successors of a configuration and add the ones which were not visited yet.
+ */
+static void expand_configuration(struct explorer_worker *worker, struct configuration *configuration) {
+    struct explorer *explorer = worker->explorer;
+    struct ntm_table *table = explorer->table;
+    size_t alphabet_size = table->alphabet_size;
+    long cell_count = decode_configuration(worker, configuration);
+    if (cell_count == 0)
+        return;
+    uint16_t *cells = worker->cells;
+    uint16_t blank = explorer->blank_symbol;
+    long head = configuration->head + 1;
+    uint16_t read_symbol = cells[head];
+    size_t key = configuration->state * alphabet_size + read_symbol;
+
+    for (uint32_t i = table->index[key]; i < table->index[key + 1]; ++i) {
+        struct transition_action *action = &table->actions[i];
+        long new_head = head + action->movement;
+        cells[head] = action->write_symbol;
+
+        // stored cells are the non blank cells, extended to the head
+        long first = 0;
+        long last = cell_count - 1;
+        while (first < new_head && cells[first] == blank)
+            ++first;
+        while (last > new_head && cells[last] == blank)
+            --last;
+
+        struct configuration *encoded = encode_configuration(worker, action->next_row / alphabet_size, cells, first, last, new_head);
+        struct configuration *successor = encoded != NULL ? visit_configuration(worker, encoded) : NULL;
+        if (successor != NULL)
+            handle_new_configuration(worker, successor);
+        cells[head] = read_symbol;
+    }
+}
+
+/*
+ * Take configurations from the end of the range of another worker. Returns 0 if all ranges are empty.
+ */
+static int steal_configurations(struct explorer_worker *worker) {
+    struct explorer *explorer = worker->explorer;
+    for (int i = 1; i < explorer->options.thread_count; ++i) {
+        struct explorer_worker *victim = &explorer->workers[(worker->index + i) % explorer->options.thread_count];
+        size_t begin, end;
+
+        pthread_mutex_lock(&victim->range.lock);
+        size_t remaining = victim->range.end - victim->range.next;
+        // take half of the remaining configurations, rounded up
+        end = victim->range.end;
+        begin = end - (remaining + 1) / 2;
+        victim->range.end = begin;
+        pthread_mutex_unlock(&victim->range.lock);
+
+        if (begin < end) {
+            pthread_mutex_lock(&worker->range.lock);
+            worker->range.next = begin;
+            worker->range.end = end;
+            pthread_mutex_unlock(&worker->range.lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Expand the configurations of the own range of the frontier and steal from the other workers when the own
+ * range is empty, until the whole frontier is expanded.
+ */
+static void expand_frontier(struct explorer_worker *worker) {
+    struct explorer *explorer = worker->explorer;
+
+    while (!atomic_load(&explorer->stop)) {
+        pthread_mutex_lock(&worker->range.lock);
+        size_t begin = worker->range.next;
+        size_t end = worker->range.end - begin > CLAIM_CONFIGURATION_COUNT ? begin + CLAIM_CONFIGURATION_COUNT : worker->range.end;
+        worker->range.next = end;
+        pthread_mutex_unlock(&worker->range.lock);
+
+        if (begin == end) {
+            if (!steal_configurations(worker))
+                break;
+            continue;
+        }
+        for (size_t i = begin; i < end && !atomic_load(&explorer->stop); ++i)
+            expand_configuration(worker, explorer->frontier[i]);
+    }
+}
+
+/*
+ * Thread function of the workers besides the first, whose part is done by the main thread. The threads live for
+ * the whole exploration and expand their part of every depth between two waits on the level barrier.
+ */
+static void *run_explorer_worker(void *argument) {
+    struct explorer_worker *worker = argument;
+    struct explorer *explorer = worker->explorer;
+
+    // the barrier is ready once the main thread has started all workers
+    pthread_mutex_lock(&explorer->start_lock);
+    pthread_mutex_unlock(&explorer->start_lock);
+    for (;;) {
+        pthread_barrier_wait(&explorer->level_barrier);
+        if (explorer->finished)
+            break;
+        expand_frontier(worker);
+        pthread_barrier_wait(&explorer->level_barrier);
+    }
+    return NULL;
+}
+
+/*
+ * Create an explorer for the program. The table has to be built from the same program.
+ * Returns NULL and sets the error of the program if there is not enough memory.
+ */
+struct explorer *create_explorer(struct program *program, struct ntm_table *table, struct explore_options *options) {
+    program->line_num = 0;
+    struct explorer *explorer = calloc(1, sizeof(struct explorer));
+    if (explorer == NULL) {
+        set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the explorer!");
+        return NULL;
+    }
+    explorer->program = program;
+    explorer->table = table;
+    explorer->options = *options;
+    int blank = intern_find(&program->alphabet, " ", 1);
+    explorer->blank_symbol = blank != -1 ? blank : 0;
+    explorer->bits_per_symbol = 1;
+    while ((1 << explorer->bits_per_symbol) < program->alphabet.count)
+        ++explorer->bits_per_symbol;
+
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        pthread_mutex_init(&explorer->shards[i].lock, NULL);
+        explorer->shards[i].slot_count = INITIAL_SHARD_SLOT_COUNT;
+        explorer->shards[i].slots = calloc(INITIAL_SHARD_SLOT_COUNT, sizeof(struct configuration*));
+    }
+    atomic_init(&explorer->memory_used, SHARD_COUNT * INITIAL_SHARD_SLOT_COUNT * sizeof(struct configuration*));
+    atomic_init(&explorer->stop, 0);
+    atomic_init(&explorer->memory_limit_reached, 0);
+    atomic_init(&explorer->configuration_count, 0);
+    atomic_init(&explorer->accepting_configuration, NULL);
+    atomic_init(&explorer->error_message, NULL);
+    pthread_mutex_init(&explorer->start_lock, NULL);
+
+    explorer->workers = calloc(options->thread_count, sizeof(struct explorer_worker));
+    if (explorer->workers == NULL)
+        explorer->options.thread_count = 0;
+    for (int w = 0; w < explorer->options.thread_count; ++w) {
+        struct explorer_worker *worker = &explorer->workers[w];
+        worker->index = w;
+        worker->explorer = explorer;
+        pthread_mutex_init(&worker->range.lock, NULL);
+        arena_init(&worker->arena, 1 << 20);
+    }
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        if (explorer->shards[i].slots == NULL || explorer->workers == NULL) {
+            free_explorer(explorer);
+            set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the explorer!");
+            return NULL;
+        }
+    }
+    return explorer;
+}
+
+/*
+ * Collect the new configurations of all workers into the frontier. If there is not enough memory, the frontier
+ * is left empty and the exploration stops.
+ */
+static void gather_next_frontier(struct explorer *explorer) {
+    size_t count = 0;
+    for (int w = 0; w < explorer->options.thread_count; ++w)
+        count += explorer->workers[w].next_frontier_count;
+    explorer->frontier_count = 0;
+    if (count > explorer->frontier_capacity) {
+        free(explorer->frontier);
+        explorer->frontier = malloc(count * sizeof(struct configuration*));
+        explorer->frontier_capacity = explorer->frontier != NULL ? count : 0;
+        if (explorer->frontier == NULL) {
+            for (int w = 0; w < explorer->options.thread_count; ++w)
+                explorer->workers[w].next_frontier_count = 0;
+            fail_exploration(explorer, "Not enough memory for the frontier!");
+            return;
+        }
+    }
+
+    for (int w = 0; w < explorer->options.thread_count; ++w) {
+        struct explorer_worker *worker = &explorer->workers[w];
+        if (worker->next_frontier_count == 0)
+            continue;
+        memcpy(explorer->frontier + explorer->frontier_count, worker->next_frontier, worker->next_frontier_count * sizeof(struct configuration*));
+        explorer->frontier_count += worker->next_frontier_count;
+        worker->next_frontier_count = 0;
+    }
+}
+
+/*
+ * Explore the configuration tree breadth first, one depth at a time. The frontier of a depth is split into
+ * equal ranges for the workers, which steal from each other when they run out of work. The worker threads are
+ * started once and meet on a barrier before and after every depth, the main thread works as the first worker.
+ * Every configuration is expanded at most once, the exploration stops at the first accepting configuration or
+ * at a limit. Returns -1 and sets the error of the program if the exploration runs out of memory or can not
+ * start its threads.
+ */
+int explore_program(struct explorer *explorer, const char *input, struct explore_result *result) {
+    struct ntm_table *table = explorer->table;
+    struct explorer_worker *first_worker = &explorer->workers[0];
+    struct tape tape;
+    long long depth = 0;
+    double start_time = get_seconds();
+
+    // initial configuration with the trimmed input
+    if (tape_init(&tape, explorer->program, input) == -1)
+        return -1;
+    long first = 0;
+    long last = tape.size - 1;
+    while (first < tape.head && tape.cells[first] == tape.blank_symbol)
+        ++first;
+    while (last > tape.head && tape.cells[last] == tape.blank_symbol)
+        --last;
+    struct configuration *encoded = encode_configuration(first_worker, table->start_state, tape.cells, first, last, tape.head);
+    struct configuration *configuration = encoded != NULL ? visit_configuration(first_worker, encoded) : NULL;
+    if (configuration != NULL)
+        handle_new_configuration(first_worker, configuration);
+    free_tape(&tape);
+    gather_next_frontier(explorer);
+
+    // the barrier counts only the threads which were started, after a failed start they are released at once
+    int thread_count = 1;
+    explorer->finished = 0;
+    pthread_mutex_lock(&explorer->start_lock);
+    while (thread_count < explorer->options.thread_count) {
+        if (pthread_create(&explorer->workers[thread_count].thread, NULL, run_explorer_worker, &explorer->workers[thread_count]) != 0) {
+            fail_exploration(explorer, "Could not create exploration thread!");
+            explorer->finished = 1;
+            break;
+        }
+        ++thread_count;
+    }
+    pthread_barrier_init(&explorer->level_barrier, NULL, thread_count);
+    pthread_mutex_unlock(&explorer->start_lock);
+
+    while (!explorer->finished && explorer->frontier_count > 0 && !atomic_load(&explorer->stop)) {
+        if (explorer->options.max_steps != 0 && depth >= explorer->options.max_steps)
+            break;
+
+        // split the frontier into equal ranges
+        for (int w = 0; w < explorer->options.thread_count; ++w) {
+            struct explorer_worker *worker = &explorer->workers[w];
+            worker->range.next = explorer->frontier_count * w / explorer->options.thread_count;
+            worker->range.end = explorer->frontier_count * (w + 1) / explorer->options.thread_count;
+        }
+
+        // the barrier releases the workers into the depth and waits until all of them are done
+        pthread_barrier_wait(&explorer->level_barrier);
+        expand_frontier(first_worker);
+        pthread_barrier_wait(&explorer->level_barrier);
+
+        ++depth;
+        gather_next_frontier(explorer);
+    }
+
+    explorer->finished = 1;
+    pthread_barrier_wait(&explorer->level_barrier);
+    for (int w = 1; w < thread_count; ++w)
+        pthread_join(explorer->workers[w].thread, NULL);
+    pthread_barrier_destroy(&explorer->level_barrier);
+
+    result->accepting_configuration = atomic_load(&explorer->accepting_configuration);
+    result->accepted = result->accepting_configuration != NULL;
+    result->memory_limit_reached = !result->accepted && atomic_load(&explorer->memory_limit_reached);
+    result->step_limit_reached = !result->accepted && !result->memory_limit_reached && explorer->frontier_count > 0;
+    result->depth = depth;
+    result->configuration_count = atomic_load(&explorer->configuration_count);
+    result->duplicate_count = 0;
+    for (int w = 0; w < explorer->options.thread_count; ++w)
+        result->duplicate_count += explorer->workers[w].duplicate_count;
+    result->memory_used = atomic_load(&explorer->memory_used);
+    result->seconds = get_seconds() - start_time;
+
+    const char *error_message = atomic_load(&explorer->error_message);
+    if (error_message != NULL) {
+        explorer->program->line_num = 0;
+        return set_compile_error(explorer->program, COMPILE_ERROR_RESOURCE, NULL, "%s", error_message);
+    }
+    return 0;
+}
+
+/*
+ * Print the outcome, the number of configurations and the speed of an exploration.
+ */
+void print_explore_result(struct explorer *explorer, struct explore_result *result, int print_tape_content) {
+    if (result->accepted)
+        printf("Result: accepted at depth %lld\n", result->depth);
+    else if (result->memory_limit_reached)
+        printf("Result: memory limit reached at depth %lld\n", result->depth);
+    else if (result->step_limit_reached)
+        printf("Result: step limit reached at depth %lld\n", result->depth);
+    else
+        printf("Result: not accepted, all branches halted after depth %lld\n", result->depth);
+
+    printf("Configurations: %lld\n", result->configuration_count);
+    printf("Duplicate configurations: %lld\n", result->duplicate_count);
+    printf("Memory: %.1f MB\n", result->memory_used / (1024.0 * 1024.0));
+    printf("Time: %.3f s\n", result->seconds);
+    if (result->seconds > 0)
+        printf("Configurations per second: %.0f\n", result->configuration_count / result->seconds);
+
+    if (print_tape_content && result->accepted) {
+        struct explorer_worker *worker = &explorer->workers[0];
+        struct configuration *configuration = result->accepting_configuration;
+        struct tape tape;
+        tape.size = decode_configuration(worker, configuration);
+        if (tape.size == 0)
+            return;
+        tape.cells = worker->cells;
+        tape.blank_symbol = explorer->blank_symbol;
+        tape.head = configuration->head + 1;
+        // report the head position relative to the leftmost non blank cell
+        tape.origin = 0;
+        while (tape.origin < tape.size - 1 && tape.cells[tape.origin] == tape.blank_symbol)
+            ++tape.origin;
+        print_tape(explorer->program, &tape);
+    }
+}
+
+/*
+ * Free the explorer with all configurations.
+ */
+void free_explorer(struct explorer *explorer) {
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        pthread_mutex_destroy(&explorer->shards[i].lock);
+        free(explorer->shards[i].slots);
+    }
+    for (int w = 0; w < explorer->options.thread_count; ++w) {
+        struct explorer_worker *worker = &explorer->workers[w];
+        pthread_mutex_destroy(&worker->range.lock);
+        arena_free(&worker->arena);
+        free(worker->next_frontier);
+        free(worker->cells);
+        free(worker->encoded);
+    }
+    pthread_mutex_destroy(&explorer->start_lock);
+    free(explorer->workers);
+    free(explorer->frontier);
+    free(explorer);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include "program_helper.h"
+#include "simulator.h"
+
+/*
+ * Transitions of a nondeterministic program, sorted by (state, read symbol).
+ * The transitions for state s and read symbol a are actions[index[s * alphabet_size + a]]
+ * up to actions[index[s * alphabet_size + a + 1]].
+ */
+struct ntm_table {
+    struct transition_action *actions;
+    uint32_t *index;
+    int state_count;
+    int alphabet_size;
+    // start, accept and reject state are the first three states of the state line, -1 if not declared
+    int start_state;
+    int accept_state;
+    int reject_state;
+};
+
+/*
+ * Configuration of the machine in a compact encoding. Only the cells between the leftmost non blank cell
+ * and the rightmost non blank cell (extended to the head) are stored, packed with bits_per_symbol bits per cell,
+ * so configurations which differ only by the position on the infinite tape are equal.
+ */
+struct configuration {
+    // hash of all other fields, also used to pick the shard of the visited set
+    uint32_t hash;
+    uint32_t state;
+    // position of the head in the stored cells
+    uint32_t head;
+    // number of stored cells
+    uint32_t cell_count;
+    // packed alphabet indexes of the cells
+    uint8_t cells[];
+};
+
+/*
+ * Limits and settings of an exploration
+ */
+struct explore_options {
+    // number of threads which expand the frontier
+    int thread_count;
+    // maximal depth of the configuration tree, 0 for no limit
+    long long max_steps;
+    // maximal memory for configurations and the visited set in bytes, 0 for no limit
+    size_t max_memory;
+};
+
+/*
+ * Result of an exploration
+ */
+struct explore_result {
+    // set if an accepting configuration was found
+    int accepted;
+    // set if the step or memory limit stopped the exploration before all branches halted
+    int step_limit_reached;
+    int memory_limit_reached;
+    // depth of the accepting configuration or the number of explored levels
+    long long depth;
+    // number of distinct configurations
+    long long configuration_count;
+    // number of generated configurations which were already visited
+    long long duplicate_count;
+    // bytes used by configurations and the visited set
+    size_t memory_used;
+    // run time in seconds
+    double seconds;
+    // accepting configuration, NULL if none was found
+    struct configuration *accepting_configuration;
+};
+
+struct explorer;
+
+int build_ntm_table(struct ntm_table *table, struct program *program);
+
+void free_ntm_table(struct ntm_table *table);
+
+struct explorer *create_explorer(struct program *program, struct ntm_table *table, struct explore_options *options);
+
+int explore_program(struct explorer *explorer, const char *input, struct explore_result *result);
+
+void print_explore_result(struct explorer *explorer, struct explore_result *result, int print_tape_content);
+
+void free_explorer(struct explorer *explorer);
@@ -0,0 +1,498 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "incremental.h"
+#include "binary_format.h"
+#include "parallel_expansion.h"
+#include "parser.h"
+#include "writer.h"
+
+/*
+ * Set of cache entries, indexed by line hash. Open addressing with linear probing.
+ */
+struct cache_table {
+    // entries, NULL for empty slots
+    struct cache_entry **slots;
+    // number of slots, always a power of two
+    size_t slot_count;
+    // number of entries
+    size_t count;
+};
+
+/*
+ * Remove the line break from the end of a line.
+ */
+static struct slice trim_line_break(struct slice line) {
+    while (line.len > 0 && (line.ptr[line.len - 1] == '\n' || line.ptr[line.len - 1] == '\r'))
+        --line.len;
+    return line;
+}
+
+/*
+ * FNV-1a hash of a line, continuing the given hash. The line break is always hashed as a single '\n',
+ * so the last line of a file hashes the same with or without it and consecutive lines can not run together.
+ */
+uint64_t hash_line(uint64_t hash, struct slice line) {
+    size_t len = trim_line_break(line).len;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char) line.ptr[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    hash ^= '\n';
+    hash *= UINT64_C(1099511628211);
+    return hash;
+}
+
+/*
+ * Get the size of the line text of a cache entry including padding.
+ */
+static size_t get_line_text_size(struct cache_entry *entry) {
+    return ((size_t) entry->line_size + 7) & ~(size_t) 7;
+}
+
+/*
+ * Get the line text of a cache entry, it follows the entry.
+ */
+static char *get_entry_line(struct cache_entry *entry) {
+    return (char*) (entry + 1);
+}
+
+/*
+ * Get the state names of a cache entry, they follow the line text.
+ */
+static char *get_entry_names(struct cache_entry *entry) {
+    return get_entry_line(entry) + get_line_text_size(entry);
+}
+
+/*
+ * Get the deltas of a cache entry, they follow the state names.
+ */
+static struct binary_delta *get_entry_deltas(struct cache_entry *entry) {
+    return (struct binary_delta*) (get_entry_names(entry) + entry->names_size);
+}
+
+/*
+ * Get the size of a cache entry with its line, names and deltas.
+ */
+static size_t get_entry_size(struct cache_entry *entry) {
+    return sizeof(struct cache_entry) + get_line_text_size(entry) + entry->names_size + (size_t) entry->deltas_count * sizeof(struct binary_delta);
+}
+
+/*
+ * Initialize an empty cache table. Returns -1 if there is not enough memory, then the table has no slots.
+ */
+static int cache_table_init(struct cache_table *table) {
+    table->slot_count = 1024;
+    table->count = 0;
+    table->slots = calloc(table->slot_count, sizeof(struct cache_entry*));
+    return table->slots != NULL ? 0 : -1;
+}
+
+/*
+ * Remove all entries of the table, the slots are kept.
+ */
+static void cache_table_clear(struct cache_table *table) {
+    memset(table->slots, 0, table->slot_count * sizeof(struct cache_entry*));
+    table->count = 0;
+}
+
+/*
+ * Find the entry of a line, NULL if the table has none. The line is given without its line break, an entry
+ * only matches if both the hash and the text of its line are equal.
+ */
+static struct cache_entry *cache_table_find(struct cache_table *table, uint64_t line_hash, struct slice line) {
+    for (size_t slot = line_hash & (table->slot_count - 1); table->slots[slot] != NULL; slot = (slot + 1) & (table->slot_count - 1)) {
+        struct cache_entry *entry = table->slots[slot];
+        if (entry->line_hash == line_hash && entry->line_size == line.len && memcmp(get_entry_line(entry), line.ptr, line.len) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/*
+ * Put an entry into the first free slot of its hash.
+ */
+static void cache_table_insert(struct cache_entry **slots, size_t slot_count, struct cache_entry *entry) {
+    size_t slot = entry->line_hash & (slot_count - 1);
+    while (slots[slot] != NULL)
+        slot = (slot + 1) & (slot_count - 1);
+    slots[slot] = entry;
+}
+
+/*
+ * Add an entry whose line is not yet contained in the table.
+ * Returns -1 if the slots can not grow, then the table is unchanged.
+ */
+static int cache_table_add(struct cache_table *table, struct cache_entry *entry) {
+    // keep the load factor at most 1/2
+    if ((table->count + 1) * 2 > table->slot_count) {
+        size_t slot_count = table->slot_count * 2;
+        struct cache_entry **slots = calloc(slot_count, sizeof(struct cache_entry*));
+        if (slots == NULL)
+            return -1;
+        for (size_t i = 0; i < table->slot_count; ++i) {
+            if (table->slots[i] != NULL)
+                cache_table_insert(slots, slot_count, table->slots[i]);
+        }
+        free(table->slots);
+        table->slots = slots;
+        table->slot_count = slot_count;
+    }
+    cache_table_insert(table->slots, table->slot_count, entry);
+    ++table->count;
+    return 0;
+}
+
+/*
+ * Check that an entry fits into the cache file and only contains valid names, states and symbols.
+ */
+static int is_valid_entry(struct program *program, char *map, size_t map_size, size_t offset) {
+    if (map_size - offset < sizeof(struct cache_entry))
+        return 0;
+    struct cache_entry *entry = (struct cache_entry*) (map + offset);
+    if (entry->names_size % 8 != 0 || map_size - offset < get_entry_size(entry))
+        return 0;
+
+    // the names blob has to contain state_count null terminated names
+    char *names = get_entry_names(entry);
+    uint32_t name_count = 0;
+    for (uint32_t i = 0; i < entry->names_size && name_count < entry->state_count; ++i) {
+        if (names[i] == '\0')
+            ++name_count;
+    }
+    if (name_count != entry->state_count)
+        return 0;
+
+    struct binary_delta *deltas = get_entry_deltas(entry);
+    for (uint32_t i = 0; i < entry->deltas_count; ++i) {
+        if (deltas[i].state >= entry->state_count || deltas[i].subsequent_state >= entry->state_count
+            || deltas[i].read_symbol >= program->alphabet.count || deltas[i].write_symbol >= program->alphabet.count)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Map the cache file and add its entries to the table. The cache is ignored if it does not exist,
+ * belongs to other headers, is corrupt or there is not enough memory for its entries.
+ * Returns the mapping, NULL if no entries were loaded.
+ */
+static char *load_cache(struct program *program, struct cache_table *table, uint64_t header_hash, size_t *map_size) {
+    int fd = open(program->options.cache_path, O_RDONLY);
+    struct stat file_stat;
+    if (fd == -1)
+        return NULL;
+    if (fstat(fd, &file_stat) == -1 || (size_t) file_stat.st_size < sizeof(struct cache_header)) {
+        close(fd);
+        return NULL;
+    }
+    char *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    *map_size = file_stat.st_size;
+
+    struct cache_header *header = (struct cache_header*) map;
+    if (memcmp(header->magic, CACHE_MAGIC, 4) != 0 || header->version != CACHE_VERSION || header->header_hash != header_hash) {
+        munmap(map, *map_size);
+        return NULL;
+    }
+
+    size_t offset = sizeof(struct cache_header);
+    for (uint64_t i = 0; i < header->entry_count; ++i) {
+        const char *problem = NULL;
+        struct cache_entry *entry = (struct cache_entry*) (map + offset);
+        if (!is_valid_entry(program, map, *map_size, offset))
+            problem = "is corrupt";
+        else if (cache_table_find(table, entry->line_hash, (struct slice) {get_entry_line(entry), entry->line_size}) == NULL
+                 && cache_table_add(table, entry) == -1)
+            problem = "does not fit into memory";
+        if (problem != NULL) {
+            fprintf(stderr, "Cache file %s %s, all delta lines are expanded again\n", program->options.cache_path, problem);
+            cache_table_clear(table);
+            munmap(map, *map_size);
+            return NULL;
+        }
+        offset += get_entry_size(entry);
+    }
+    return map;
+}
+
+/*
+ * Report that there is not enough memory for the cache entry of the current line. Returns NULL.
+ */
+static struct cache_entry *set_cache_entry_error(struct program *worker_program) {
+    set_compile_error(worker_program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to cache the deltas of the line!");
+    return NULL;
+}
+
+/*
+ * Expand a delta line with the worker program into a new cache entry in the arena.
+ * local_indexes maps the states of the worker program to the states of the entry and is -1 for all states.
+ * Returns NULL if the line is malformed or there is not enough memory, the error is set in the worker program.
+ */
+static struct cache_entry *create_cache_entry(struct program *worker_program, struct slice line, int line_num, uint64_t line_hash,
+                                              struct arena *arena, int **local_indexes, int *local_indexes_size) {
+    struct expanded_line expanded_line;
+    struct intern_table *states = &worker_program->states;
+
+    worker_program->deltas_count = 0;
+    if (expand_delta_line(worker_program, line, line_num, &expanded_line) == -1)
+        return NULL;
+    if (states->count > *local_indexes_size) {
+        int *new_local_indexes = realloc(*local_indexes, states->count * sizeof(int));
+        if (new_local_indexes == NULL)
+            return set_cache_entry_error(worker_program);
+        *local_indexes = new_local_indexes;
+        for (int i = *local_indexes_size; i < states->count; ++i)
+            (*local_indexes)[i] = -1;
+        *local_indexes_size = states->count;
+    }
+
+    // number the states in the order they are used, like the sequential expansion adds them
+    int *state_order = arena_alloc(&worker_program->scratch, 2 * expanded_line.deltas_count * sizeof(int));
+    if (state_order == NULL)
+        return set_cache_entry_error(worker_program);
+    uint32_t state_count = 0;
+    size_t names_size = 0;
+    for (int i = 0; i < expanded_line.deltas_count; ++i) {
+        int used_states[2] = {worker_program->deltas[i].state, worker_program->deltas[i].subsequent_state};
+        for (int j = 0; j < 2; ++j) {
+            if ((*local_indexes)[used_states[j]] == -1) {
+                (*local_indexes)[used_states[j]] = state_count;
+                state_order[state_count++] = used_states[j];
+                names_size += states->lengths[used_states[j]] + 1;
+            }
+        }
+    }
+    names_size = (names_size + 7) & ~(size_t) 7;
+    struct slice line_text = trim_line_break(line);
+    size_t line_text_size = (line_text.len + 7) & ~(size_t) 7;
+
+    size_t entry_size = sizeof(struct cache_entry) + line_text_size + names_size + expanded_line.deltas_count * sizeof(struct binary_delta);
+    struct cache_entry *entry = arena_alloc(arena, entry_size);
+    if (entry == NULL) {
+        for (uint32_t i = 0; i < state_count; ++i)
+            (*local_indexes)[state_order[i]] = -1;
+        arena_clear(&worker_program->scratch);
+        return set_cache_entry_error(worker_program);
+    }
+    memset(entry, 0, sizeof(struct cache_entry) + line_text_size + names_size);
+    entry->line_hash = line_hash;
+    entry->line_size = line_text.len;
+    entry->state_count = state_count;
+    entry->deltas_count = expanded_line.deltas_count;
+    entry->names_size = names_size;
+    entry->state_substituted = expanded_line.state_substituted;
+    entry->subsequent_state_substituted = expanded_line.subsequent_state_substituted;
+
+    memcpy(get_entry_line(entry), line_text.ptr, line_text.len);
+    char *names = get_entry_names(entry);
+    for (uint32_t i = 0; i < state_count; ++i) {
+        memcpy(names, states->names[state_order[i]], states->lengths[state_order[i]] + 1);
+        names += states->lengths[state_order[i]] + 1;
+    }
+
+    struct binary_delta *binary_deltas = get_entry_deltas(entry);
+    for (int i = 0; i < expanded_line.deltas_count; ++i) {
+        struct deltas *delta = &worker_program->deltas[i];
+        binary_deltas[i].state = (*local_indexes)[delta->state];
+        binary_deltas[i].subsequent_state = (*local_indexes)[delta->subsequent_state];
+        binary_deltas[i].read_symbol = delta->read_symbol;
+        binary_deltas[i].write_symbol = delta->write_symbol;
+        binary_deltas[i].movement = delta->movement;
+        memset(binary_deltas[i].padding, 0, sizeof(binary_deltas[i].padding));
+    }
+
+    for (uint32_t i = 0; i < state_count; ++i)
+        (*local_indexes)[state_order[i]] = -1;
+    arena_clear(&worker_program->scratch);
+    return entry;
+}
+
+/*
+ * Add the deltas of a cache entry to the program. States are added in the same order as the sequential
+ * expansion of the line would add them, so the result is identical. Returns -1 if there is not enough memory.
+ */
+static int merge_cache_entry(struct program *program, struct cache_entry *entry) {
+    int *states = arena_alloc(&program->scratch, entry->state_count * sizeof(int) + 1);
+    char **names = arena_alloc(&program->scratch, entry->state_count * sizeof(char*) + 1);
+    if (states == NULL || names == NULL || reserve_deltas(program, entry->deltas_count) == -1) {
+        arena_clear(&program->scratch);
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to merge the deltas of the line!");
+    }
+    char *name = get_entry_names(entry);
+    for (uint32_t i = 0; i < entry->state_count; ++i) {
+        states[i] = -1;
+        names[i] = name;
+        name += strlen(name) + 1;
+    }
+
+    struct binary_delta *binary_deltas = get_entry_deltas(entry);
+    for (uint32_t i = 0; i < entry->deltas_count; ++i) {
+        struct binary_delta *binary_delta = &binary_deltas[i];
+        uint32_t local_states[2] = {binary_delta->state, binary_delta->subsequent_state};
+        char substituted[2] = {entry->state_substituted, entry->subsequent_state_substituted};
+        int failed = 0;
+        for (int j = 0; j < 2 && !failed; ++j) {
+            if (states[local_states[j]] == -1)
+                states[local_states[j]] = intern_string(&program->states, names[local_states[j]], strlen(names[local_states[j]]));
+            failed = states[local_states[j]] == -1 || (substituted[j] && list_state(program, states[local_states[j]]) == -1);
+        }
+
+        struct deltas *delta = failed ? NULL : add_delta(program);
+        if (delta == NULL) {
+            arena_clear(&program->scratch);
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to merge the deltas of the line!");
+        }
+        delta->state = states[binary_delta->state];
+        delta->subsequent_state = states[binary_delta->subsequent_state];
+        delta->read_symbol = binary_delta->read_symbol;
+        delta->write_symbol = binary_delta->write_symbol;
+        delta->movement = binary_delta->movement;
+    }
+
+    arena_clear(&program->scratch);
+    return 0;
+}
+
+/*
+ * Write the entries of the current delta lines to the cache file. The file is written next to it and
+ * renamed, so an interrupted compilation does not leave a broken cache. Returns -1 if the cache can not be written.
+ */
+static int write_cache(struct program *program, uint64_t header_hash, struct cache_entry **entries, uint64_t entry_count) {
+    struct output_writer writer;
+    struct cache_header header;
+    char *temporary_path = malloc(strlen(program->options.cache_path) + 5);
+
+    program->line_num = 0;
+    if (temporary_path == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to write cache file %s!", program->options.cache_path);
+    sprintf(temporary_path, "%s.tmp", program->options.cache_path);
+    if (writer_open(&writer, temporary_path) == -1) {
+        set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not open cache file %s!", temporary_path);
+        free(temporary_path);
+        return -1;
+    }
+    memset(&header, 0, sizeof(struct cache_header));
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.header_hash = header_hash;
+    header.entry_count = entry_count;
+    writer_write(&writer, (char*) &header, sizeof(struct cache_header));
+    for (uint64_t i = 0; i < entry_count; ++i)
+        writer_write(&writer, (char*) entries[i], get_entry_size(entries[i]));
+
+    int result = 0;
+    if (writer_close(&writer) == -1 || rename(temporary_path, program->options.cache_path) == -1)
+        result = set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not write cache file %s!", program->options.cache_path);
+    free(temporary_path);
+    return result;
+}
+
+/*
+ * Report that there is not enough memory to cache a delta line of the program. Returns -1.
+ */
+static int set_line_cache_error(struct program *program, int line_num) {
+    program->line_num = program->first_delta_line + line_num;
+    program->line_start = NULL;
+    return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to cache the deltas of the line!");
+}
+
+/*
+ * Parse the delta lines with the expansion cache. Lines which are found in the cache are not expanded,
+ * their cached deltas are merged into the program. The other lines are expanded and added to the cache, a line
+ * which occurs several times is expanded once. Afterwards the cache contains exactly the lines of the program and
+ * reused_lines of the program the number of lines which were taken from the previous cache. Returns the number
+ * of delta lines or -1 if a line is malformed, then the cache is not changed.
+ */
+int parse_deltas_incremental(struct program *program, struct line_reader *reader, uint64_t header_hash) {
+    struct cache_table old_entries;
+    struct cache_table new_entries;
+    struct arena entry_arena;
+    size_t map_size = 0;
+    struct program *worker_program = create_worker_program(program);
+    int *local_indexes = NULL;
+    int local_indexes_size = 0;
+    // unique entries of the current lines in line order, written to the new cache
+    struct cache_entry **entries = NULL;
+    uint64_t entry_count = 0;
+    uint64_t entry_capacity = 0;
+    int line_count = 0;
+    struct slice line;
+
+    int old_result = cache_table_init(&old_entries);
+    int new_result = cache_table_init(&new_entries);
+    if (worker_program == NULL || old_result == -1 || new_result == -1) {
+        free_worker_program(worker_program);
+        free(old_entries.slots);
+        free(new_entries.slots);
+        program->line_num = 0;
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the incremental compilation!");
+    }
+    arena_init(&entry_arena, 1 << 20);
+    char *map = load_cache(program, &old_entries, header_hash, &map_size);
+
+    for (; line_reader_next(reader, &line); ++line_count) {
+        uint64_t line_hash = hash_line(LINE_HASH_INIT, line);
+        struct slice line_text = trim_line_break(line);
+        struct cache_entry *entry = cache_table_find(&new_entries, line_hash, line_text);
+        if (entry == NULL) {
+            entry = cache_table_find(&old_entries, line_hash, line_text);
+            // only the first occurrence of a line is taken from the previous cache, repeated lines are not counted
+            if (entry != NULL)
+                ++program->reused_lines;
+            else
+                entry = create_cache_entry(worker_program, line, line_count, line_hash, &entry_arena, &local_indexes, &local_indexes_size);
+            if (entry == NULL) {
+                program->error = worker_program->error;
+                line_count = -1;
+                break;
+            }
+            if (entry_count == entry_capacity) {
+                uint64_t new_capacity = entry_capacity > 0 ? entry_capacity * 2 : 1024;
+                struct cache_entry **new_entries_array = realloc(entries, new_capacity * sizeof(struct cache_entry*));
+                if (new_entries_array == NULL) {
+                    line_count = set_line_cache_error(program, line_count);
+                    break;
+                }
+                entries = new_entries_array;
+                entry_capacity = new_capacity;
+            }
+            if (cache_table_add(&new_entries, entry) == -1) {
+                line_count = set_line_cache_error(program, line_count);
+                break;
+            }
+            entries[entry_count++] = entry;
+        }
+        long deltas_before = get_total_deltas_count(program);
+        int states_before = program->states.count;
+        if (check_merged_deltas(program, line_count, entry->deltas_count) == -1) {
+            line_count = -1;
+            break;
+        }
+        if (merge_cache_entry(program, entry) == -1 || check_state_limit(program, line_count, states_before) == -1
+            || record_line_stats(program, line_count, deltas_before, states_before) == -1) {
+            line_count = -1;
+            break;
+        }
+    }
+
+    if (line_count != -1 && write_cache(program, header_hash, entries, entry_count) == -1)
+        line_count = -1;
+
+    if (map != NULL)
+        munmap(map, map_size);
+    free(old_entries.slots);
+    free(new_entries.slots);
+    free(entries);
+    free(local_indexes);
+    arena_free(&entry_arena);
+    add_worker_allocations(program, worker_program);
+    free_worker_program(worker_program);
+    return line_count;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include "program_helper.h"
+
+/*
+ * Cache file of the incremental compilation. It contains the expansion of every delta line of the last
+ * compilation, keyed by a hash of the line. An entry also stores the text of its line, which is compared on a
+ * lookup, so lines with the same hash never share their deltas. All entries are only valid for the headers (state
+ * line, alphabet and symbol set definitions) with the header hash, otherwise the whole cache is discarded.
+ *
+ * The file consists of the cache_header followed by entry_count entries. An entry is a cache_entry followed by
+ * the text of its line without the line break, padded to 8 bytes, the names of its states as null terminated
+ * strings, padded to 8 bytes, and its deltas as binary_delta structs. The states of the deltas are indexes into
+ * the names of the entry, so an entry does not depend on the states of other lines and can be merged into any
+ * program with the same headers.
+ */
+
+// first bytes of every cache file
+#define CACHE_MAGIC "MTMC"
+// version of the cache format, incremented on incompatible changes
+#define CACHE_VERSION 2
+
+struct cache_header {
+    char magic[4];
+    uint32_t version;
+    uint64_t header_hash;
+    uint64_t entry_count;
+};
+
+struct cache_entry {
+    // hash of the delta line without its line break
+    uint64_t line_hash;
+    // length of the delta line without its line break
+    uint32_t line_size;
+    // number of states used by the deltas of the line
+    uint32_t state_count;
+    uint32_t deltas_count;
+    // size of the names of the states including padding
+    uint32_t names_size;
+    // flags if the state and subsequent state names are substituted, then they are listed in the compiled program
+    char state_substituted;
+    char subsequent_state_substituted;
+    char padding[6];
+};
+
+// initial value of hash_line, a line hash is continued with the next line to hash several lines
+#define LINE_HASH_INIT UINT64_C(14695981039346656037)
+
+uint64_t hash_line(uint64_t hash, struct slice line);
+
+int parse_deltas_incremental(struct program *program, struct line_reader *reader, uint64_t header_hash);
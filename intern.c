@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+/*
+ * FNV-1a hash of a string with given length.
+ */
+static unsigned int hash_string(const char *str, size_t len) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char) str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Count the allocation of the names, hashes and lengths arrays with the given capacity.
+ */
+static void count_array_allocation(struct intern_table *table) {
+    table->allocation_count += 3;
+    table->allocated_bytes += table->capacity * (sizeof(char*) + 2 * sizeof(unsigned int));
+}
+
+/*
+ * Count the allocation of the slots.
+ */
+static void count_slot_allocation(struct intern_table *table) {
+    ++table->allocation_count;
+    table->allocated_bytes += table->slot_count * sizeof(int);
+}
+
+/*
+ * Get the number of slots for the expected number of strings, which keeps the load factor at most 1/2.
+ * Returns 0 if the slot count does not fit into an int.
+ */
+static int get_slot_count(int expected_count) {
+    if (expected_count > INTERN_MAX_COUNT)
+        return 0;
+    int slot_count = 16;
+    while (slot_count < expected_count * 2)
+        slot_count *= 2;
+    return slot_count;
+}
+
+/*
+ * Grow the names, hashes and lengths arrays to the capacity. Returns -1 if there is not enough memory,
+ * then the arrays keep their old size.
+ */
+static int grow_arrays(struct intern_table *table, int capacity) {
+    char **names = realloc(table->names, capacity * sizeof(char*));
+    if (names != NULL)
+        table->names = names;
+    unsigned int *hashes = realloc(table->hashes, capacity * sizeof(unsigned int));
+    if (hashes != NULL)
+        table->hashes = hashes;
+    unsigned int *lengths = realloc(table->lengths, capacity * sizeof(unsigned int));
+    if (lengths != NULL)
+        table->lengths = lengths;
+    if (names == NULL || hashes == NULL || lengths == NULL)
+        return -1;
+    table->capacity = capacity;
+    count_array_allocation(table);
+    return 0;
+}
+
+/*
+ * Initialize an empty intern table with space for the expected number of strings.
+ * Copies of the interned strings are allocated in the given arena.
+ * Returns -1 if there is not enough memory or more than INTERN_MAX_COUNT strings are expected, then the table
+ * is empty and can be freed or reset.
+ */
+int intern_table_init(struct intern_table *table, int expected_count, struct arena *arena) {
+    if (expected_count < 8)
+        expected_count = 8;
+    memset(table, 0, sizeof(struct intern_table));
+    table->arena = arena;
+    table->slot_count = get_slot_count(expected_count);
+    if (table->slot_count == 0)
+        return -1;
+    table->slots = calloc(table->slot_count, sizeof(int));
+    if (table->slots == NULL || grow_arrays(table, expected_count) == -1) {
+        intern_table_free(table);
+        memset(table, 0, sizeof(struct intern_table));
+        return -1;
+    }
+    count_slot_allocation(table);
+    return 0;
+}
+
+/*
+ * Empty the table for reuse with space for the expected number of strings. The arrays are only reallocated if
+ * they are too small. A table which was never initialized (all fields zero) is initialized.
+ * Returns -1 like intern_table_init, a table which was initialized before stays empty and usable.
+ */
+int intern_table_reset(struct intern_table *table, int expected_count, struct arena *arena) {
+    if (table->names == NULL)
+        return intern_table_init(table, expected_count, arena);
+    table->arena = arena;
+    table->count = 0;
+    if (expected_count > table->capacity && grow_arrays(table, expected_count) == -1)
+        return -1;
+    int slot_count = get_slot_count(expected_count);
+    if (slot_count == 0)
+        return -1;
+    if (table->slot_count < slot_count) {
+        int *slots = calloc(slot_count, sizeof(int));
+        if (slots == NULL)
+            return -1;
+        free(table->slots);
+        table->slots = slots;
+        table->slot_count = slot_count;
+        count_slot_allocation(table);
+    } else {
+        memset(table->slots, 0, table->slot_count * sizeof(int));
+    }
+    return 0;
+}
+
+/*
+ * Double the number of slots and reinsert all ids with their stored hashes.
+ * Returns -1 if there is not enough memory, then the old slots are kept.
+ */
+static int grow_slots(struct intern_table *table) {
+    int slot_count = table->slot_count * 2;
+    int *slots = calloc(slot_count, sizeof(int));
+    if (slots == NULL)
+        return -1;
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    count_slot_allocation(table);
+    unsigned int mask = table->slot_count - 1;
+    for (int id = 0; id < table->count; ++id) {
+        unsigned int slot = table->hashes[id] & mask;
+        while (table->slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        table->slots[slot] = id + 1;
+    }
+    return 0;
+}
+
+/*
+ * Get the slot of a string. The slot either contains the matching id or is empty.
+ */
+static unsigned int find_slot(struct intern_table *table, const char *str, size_t len, unsigned int hash) {
+    unsigned int mask = table->slot_count - 1;
+    unsigned int slot = hash & mask;
+    while (table->slots[slot] != 0) {
+        int id = table->slots[slot] - 1;
+        if (table->hashes[id] == hash && table->lengths[id] == len && memcmp(table->names[id], str, len) == 0)
+            return slot;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/*
+ * Get the id of a string or -1 if it is not interned.
+ */
+int intern_find(struct intern_table *table, const char *str, size_t len) {
+    unsigned int slot = find_slot(table, str, len, hash_string(str, len));
+    return table->slots[slot] - 1;
+}
+
+/*
+ * Get the id of a string and add a copy of it to the table if it is not yet contained.
+ * Returns -1 if there is not enough memory to add it, then the table is unchanged.
+ */
+int intern_string(struct intern_table *table, const char *str, size_t len) {
+    unsigned int hash = hash_string(str, len);
+    unsigned int slot = find_slot(table, str, len, hash);
+    if (table->slots[slot] != 0)
+        return table->slots[slot] - 1;
+
+    // the slots are grown first, so the load factor stays at most 1/2 and the new string always finds a slot
+    if ((table->count + 1) * 2 > table->slot_count) {
+        if (table->count >= INTERN_MAX_COUNT || grow_slots(table) == -1)
+            return -1;
+        slot = find_slot(table, str, len, hash);
+    }
+    if (table->count == table->capacity && grow_arrays(table, table->capacity * 2) == -1)
+        return -1;
+    char *name = arena_strndup(table->arena, str, len);
+    if (name == NULL)
+        return -1;
+    int id = table->count++;
+    table->names[id] = name;
+    table->hashes[id] = hash;
+    table->lengths[id] = len;
+    table->slots[slot] = id + 1;
+    return id;
+}
+
+/*
+ * Free the lookup structures of the table. The strings are freed with their arena.
+ */
+void intern_table_free(struct intern_table *table) {
+    free(table->names);
+    free(table->hashes);
+    free(table->lengths);
+    free(table->slots);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+// Maximum number of strings of a table, twice as many slots still fit into an int
+#define INTERN_MAX_COUNT (INT32_MAX / 4)
+
+/*
+ * Hash table which interns strings and maps them to dense integer ids (0,1,...,count-1).
+ * Used for state names and alphabet symbols, so lookups do not need to scan all names.
+ */
+struct intern_table {
+    // Array of all interned strings, indexed by their id
+    char **names;
+    // Number of interned strings
+    int count;
+    // Allocated size of the names array
+    int capacity;
+    // Open addressing slots, contain id + 1 of the string or 0 if the slot is empty
+    int *slots;
+    // Number of slots, always a power of two
+    int slot_count;
+    // Hash of every interned string, indexed by id. Avoids rehashing when growing.
+    unsigned int *hashes;
+    // Length of every interned string, indexed by id
+    unsigned int *lengths;
+    // Arena which stores the copies of the interned strings
+    struct arena *arena;
+    // Number and total size of the heap allocations of the arrays and slots, the strings are counted by the arena
+    long allocation_count;
+    size_t allocated_bytes;
+};
+
+int intern_table_init(struct intern_table *table, int expected_count, struct arena *arena);
+
+int intern_table_reset(struct intern_table *table, int expected_count, struct arena *arena);
+
+int intern_find(struct intern_table *table, const char *str, size_t len);
+
+int intern_string(struct intern_table *table, const char *str, size_t len);
+
+void intern_table_free(struct intern_table *table);
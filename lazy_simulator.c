@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lazy_simulator.h"
+#include "incremental.h"
+#include "parser.h"
+
+/*
+ * Transitions which match a (state, symbol) pair. Only the first is kept, more than one is an error.
+ */
+struct rule_match {
+    long long count;
+    struct macro_rule *rule;
+    int read_symbol;
+    int write_symbol;
+};
+
+/*
+ * Copy the symbols of a parsed macro into the arena. [*] and {*} are not copied.
+ */
+static void copy_macro_symbols(struct program *program, struct macro_symbols *symbols, struct alphabet_symbols *alphabet_symbols) {
+    symbols->symbol_count = alphabet_symbols->symbol_count;
+    symbols->is_sorted = 1;
+    if (alphabet_symbols->symbols == program->alphabet_indexes) {
+        symbols->symbols = NULL;
+        return;
+    }
+    symbols->symbols = arena_alloc(&program->arena, symbols->symbol_count * sizeof(uint16_t) + 1);
+    for (int i = 0; i < symbols->symbol_count; ++i) {
+        symbols->symbols[i] = alphabet_symbols->symbols[i];
+        if (i > 0 && symbols->symbols[i] < symbols->symbols[i - 1])
+            symbols->is_sorted = 0;
+    }
+}
+
+/*
+ * Get the symbol at an index of the macro.
+ */
+static int get_macro_symbol(struct macro_symbols *symbols, int index) {
+    return symbols->symbols != NULL ? symbols->symbols[index] : index;
+}
+
+/*
+ * Get the next index at or after start where the macro contains the symbol, -1 if there is none.
+ * start is 0 or the index after the previous occurrence.
+ */
+static int find_macro_symbol(struct macro_symbols *symbols, int symbol, int start) {
+    if (symbols->symbols == NULL)
+        return symbol >= start ? symbol : -1;
+    if (symbols->is_sorted && start > 0)
+        return start < symbols->symbol_count && symbols->symbols[start] == symbol ? start : -1;
+    if (symbols->is_sorted) {
+        // first occurrence by binary search, further occurrences follow it directly
+        int low = 0;
+        int high = symbols->symbol_count;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (symbols->symbols[middle] < symbol)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return low < symbols->symbol_count && symbols->symbols[low] == symbol ? low : -1;
+    }
+    for (int i = start; i < symbols->symbol_count; ++i) {
+        if (symbols->symbols[i] == symbol)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Count how often the macro contains the symbol.
+ */
+static int count_macro_symbol(struct macro_symbols *symbols, int symbol) {
+    int count = 0;
+    for (int i = find_macro_symbol(symbols, symbol, 0); i != -1; i = find_macro_symbol(symbols, symbol, i + 1))
+        ++count;
+    return count;
+}
+
+/*
+ * Copy the prefix and postfix of a state template into the arena. Unsubstituted states only have a prefix.
+ */
+static void copy_state_template(struct program *program, struct state_helper *state, const char **prefix, uint32_t *prefix_len,
+                                const char **postfix, uint32_t *postfix_len) {
+    *prefix = arena_strndup(&program->arena, state->state_prefix.ptr, state->state_prefix.len);
+    *prefix_len = state->state_prefix.len;
+    *postfix = "";
+    *postfix_len = 0;
+    if (state->substitution_type != '0') {
+        *postfix = arena_strndup(&program->arena, state->state_postfix.ptr, state->state_postfix.len);
+        *postfix_len = state->state_postfix.len;
+    }
+}
+
+/*
+ * Add a delta line to the rules. The helpers of the parsed line are copied out of the scratch arena.
+ */
+static void add_macro_rule(struct lazy_simulator *simulator, struct delta_line *delta_line, int *rule_capacity) {
+    struct program *program = simulator->program;
+    if (simulator->rule_count == *rule_capacity) {
+        *rule_capacity = *rule_capacity > 0 ? *rule_capacity * 2 : 64;
+        simulator->rules = realloc(simulator->rules, *rule_capacity * sizeof(struct macro_rule));
+    }
+    struct macro_rule *rule = &simulator->rules[simulator->rule_count++];
+    struct state_helper *state = delta_line->state;
+    struct state_helper *subsequent_state = delta_line->subsequent_state;
+
+    rule->state_substitution = state->substitution_type;
+    rule->subsequent_substitution = subsequent_state->substitution_type;
+    rule->type = delta_line->read_symbols->type;
+    rule->movement = delta_line->movement == '<' ? -1 : (delta_line->movement == '>' ? 1 : 0);
+    copy_state_template(program, state, &rule->state_prefix, &rule->state_prefix_len, &rule->state_postfix, &rule->state_postfix_len);
+    copy_state_template(program, subsequent_state, &rule->subsequent_prefix, &rule->subsequent_prefix_len, &rule->subsequent_postfix,
+                        &rule->subsequent_postfix_len);
+    rule->subsequent_index = -1;
+    copy_macro_symbols(program, &rule->read_symbols, delta_line->read_symbols);
+    copy_macro_symbols(program, &rule->write_symbols, delta_line->write_symbols);
+}
+
+/*
+ * Read the delta lines into macro rules. Returns -1 if a line is malformed.
+ */
+static int load_macro_rules(struct lazy_simulator *simulator, struct line_reader *reader) {
+    struct program *program = simulator->program;
+    int rule_capacity = 0;
+    struct slice line;
+
+    for (int line_count = 0; line_reader_next(reader, &line); ++line_count) {
+        struct delta_line delta_line;
+        if (parse_delta_line(program, line, line_count, &delta_line, 1) == -1)
+            return -1;
+        add_macro_rule(simulator, &delta_line, &rule_capacity);
+        arena_clear(&program->scratch);
+    }
+    if (simulator->rule_count == 0) {
+        program->line_num = 0;
+        return set_compile_error(program, COMPILE_ERROR_INCOMPLETE, NULL, "File does not contain enough lines!");
+    }
+    return 0;
+}
+
+/*
+ * Group the rules by their key: the state name of unsubstituted states, the prefix of substituted states.
+ * Returns -1 if there is not enough memory for the indexes.
+ */
+static int build_rule_indexes(struct lazy_simulator *simulator) {
+    struct program *program = simulator->program;
+    struct rule_index *indexes[2] = {&simulator->state_rules, &simulator->prefix_rules};
+    int *rule_keys = malloc((simulator->rule_count + 1) * sizeof(int));
+
+    program->line_num = 0;
+    if (rule_keys == NULL || intern_table_init(&indexes[0]->keys, 64, &program->arena) == -1
+        || intern_table_init(&indexes[1]->keys, 64, &program->arena) == -1) {
+        free(rule_keys);
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the rule indexes!");
+    }
+    simulator->min_prefix_len = SIZE_MAX;
+    simulator->max_prefix_len = 0;
+    for (int r = 0; r < simulator->rule_count; ++r) {
+        struct macro_rule *rule = &simulator->rules[r];
+        int is_substituted = rule->state_substitution != '0';
+        rule_keys[r] = intern_string(&indexes[is_substituted]->keys, rule->state_prefix, rule->state_prefix_len);
+        if (rule_keys[r] == -1) {
+            free(rule_keys);
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the rule indexes!");
+        }
+        if (is_substituted && rule->state_prefix_len < simulator->min_prefix_len)
+            simulator->min_prefix_len = rule->state_prefix_len;
+        if (is_substituted && rule->state_prefix_len > simulator->max_prefix_len)
+            simulator->max_prefix_len = rule->state_prefix_len;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        struct rule_index *index = indexes[i];
+        int key_count = index->keys.count;
+        index->first = calloc(key_count + 2, sizeof(int));
+        index->rules = malloc((simulator->rule_count + 1) * sizeof(int));
+        if (index->first == NULL || index->rules == NULL) {
+            free(rule_keys);
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the rule indexes!");
+        }
+        for (int r = 0; r < simulator->rule_count; ++r) {
+            if ((simulator->rules[r].state_substitution != '0') == i)
+                ++index->first[rule_keys[r] + 2];
+        }
+        for (int key = 0; key < key_count; ++key)
+            index->first[key + 2] += index->first[key + 1];
+        // the rules are filled in rule order, so every key keeps the order of the lines
+        for (int r = 0; r < simulator->rule_count; ++r) {
+            if ((simulator->rules[r].state_substitution != '0') == i)
+                index->rules[index->first[rule_keys[r] + 1]++] = r;
+        }
+    }
+    free(rule_keys);
+    return 0;
+}
+
+/*
+ * Load the delta lines of the program file as macro rules and allocate a transition cache of at most cache_size
+ * bytes. Returns -1 if the file can not be read or is malformed or the cache can not be allocated, the error is set
+ * in the program.
+ */
+int lazy_simulator_init(struct lazy_simulator *simulator, struct program *program, const char *program_file_path, size_t cache_size) {
+    struct line_reader reader;
+    uint64_t header_hash = LINE_HASH_INIT;
+
+    memset(simulator, 0, sizeof(struct lazy_simulator));
+    simulator->program = program;
+    if (line_reader_open(&reader, program_file_path) == -1)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "File %s not found!", program_file_path);
+    int result = parse_program_header(program, &reader, &header_hash);
+    if (result == 0)
+        result = load_macro_rules(simulator, &reader);
+    line_reader_close(&reader);
+    if (result == -1 || build_rule_indexes(simulator) == -1)
+        return -1;
+
+    struct transition_table *table = &simulator->table;
+    table->alphabet_size = program->alphabet.count;
+    table->start_state = program->listed_state_count > 0 ? program->listed_states[0] : -1;
+    table->accept_state = program->listed_state_count > 1 ? program->listed_states[1] : -1;
+    table->reject_state = program->listed_state_count > 2 ? program->listed_states[2] : -1;
+    program->line_num = 0;
+    if (table->start_state == -1)
+        return set_compile_error(program, COMPILE_ERROR_INCOMPLETE, NULL, "The program has no start state!");
+
+    size_t slot_count = LAZY_CACHE_PROBES;
+    while (slot_count * 2 * sizeof(struct lazy_entry) <= cache_size)
+        slot_count *= 2;
+    simulator->slots = calloc(slot_count, sizeof(struct lazy_entry));
+    if (simulator->slots == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Could not allocate the transition cache of %zu MB!", cache_size >> 20);
+    simulator->stats.slot_count = slot_count;
+    simulator->stats.memory_used = slot_count * sizeof(struct lazy_entry);
+    return 0;
+}
+
+/*
+ * Check if a state name is prefix + symbol + postfix.
+ */
+static int is_substituted_name(struct program *program, const char *name, size_t len, const char *prefix, size_t prefix_len,
+                               int symbol, const char *postfix, size_t postfix_len) {
+    size_t symbol_len = program->alphabet.lengths[symbol];
+    return len == prefix_len + symbol_len + postfix_len && memcmp(name, prefix, prefix_len) == 0
+           && memcmp(name + prefix_len, program->alphabet.names[symbol], symbol_len) == 0
+           && memcmp(name + prefix_len + symbol_len, postfix, postfix_len) == 0;
+}
+
+/*
+ * Check if the state template of a rule, substituted with the read and write symbol, is the state name.
+ * Unsubstituted templates were already matched by their name.
+ */
+static int matches_state(struct program *program, struct macro_rule *rule, const char *name, size_t len, int read_symbol, int write_symbol) {
+    if (rule->state_substitution == '0')
+        return 1;
+    int symbol = rule->state_substitution == 'r' ? read_symbol : write_symbol;
+    return is_substituted_name(program, name, len, rule->state_prefix, rule->state_prefix_len, symbol, rule->state_postfix,
+                               rule->state_postfix_len);
+}
+
+/*
+ * Add count transitions of a rule to the matches.
+ */
+static void add_matches(struct rule_match *match, long long count, struct macro_rule *rule, int read_symbol, int write_symbol) {
+    if (count > 0 && match->count == 0) {
+        match->rule = rule;
+        match->read_symbol = read_symbol;
+        match->write_symbol = write_symbol;
+    }
+    match->count += count;
+}
+
+/*
+ * Add the transitions a rule expands to for the state name and read symbol, like the generate functions of the parser.
+ */
+static void match_rule(struct program *program, struct macro_rule *rule, const char *name, size_t len, int read_symbol, struct rule_match *match) {
+    struct macro_symbols *read_symbols = &rule->read_symbols;
+    struct macro_symbols *write_symbols = &rule->write_symbols;
+
+    if (rule->type == '0') {
+        int write_symbol = get_macro_symbol(write_symbols, 0);
+        if (get_macro_symbol(read_symbols, 0) == read_symbol && matches_state(program, rule, name, len, read_symbol, write_symbol))
+            add_matches(match, 1, rule, read_symbol, write_symbol);
+    } else if (rule->type == '1') {
+        for (int i = find_macro_symbol(read_symbols, read_symbol, 0); i != -1; i = find_macro_symbol(read_symbols, read_symbol, i + 1)) {
+            int write_symbol = get_macro_symbol(write_symbols, i);
+            if (matches_state(program, rule, name, len, read_symbol, write_symbol))
+                add_matches(match, 1, rule, read_symbol, write_symbol);
+        }
+    } else {
+        int read_count = count_macro_symbol(read_symbols, read_symbol);
+        if (read_count == 0)
+            return;
+        if (rule->state_substitution == 'w') {
+            // the write symbol is the part of the name between prefix and postfix
+            size_t affix_len = rule->state_prefix_len + rule->state_postfix_len;
+            if (len <= affix_len)
+                return;
+            int write_symbol = intern_find(&program->alphabet, name + rule->state_prefix_len, len - affix_len);
+            if (write_symbol == -1 || !matches_state(program, rule, name, len, read_symbol, write_symbol))
+                return;
+            add_matches(match, (long long) read_count * count_macro_symbol(write_symbols, write_symbol), rule, read_symbol, write_symbol);
+        } else if (matches_state(program, rule, name, len, read_symbol, 0)) {
+            // every write symbol is a transition of the state, more than one make the program nondeterministic
+            add_matches(match, (long long) read_count * write_symbols->symbol_count, rule, read_symbol, get_macro_symbol(write_symbols, 0));
+        }
+    }
+}
+
+/*
+ * Match all rules of a key of the index.
+ */
+static void match_index(struct program *program, struct lazy_simulator *simulator, struct rule_index *index, int key,
+                        const char *name, size_t len, int read_symbol, struct rule_match *match) {
+    if (key == -1)
+        return;
+    for (int i = index->first[key]; i < index->first[key + 1]; ++i)
+        match_rule(program, &simulator->rules[index->rules[i]], name, len, read_symbol, match);
+}
+
+/*
+ * Get the index of the subsequent state of a matched transition and create the state if it is new.
+ * Returns -1 if there is not enough memory for the state.
+ */
+static int get_subsequent_state(struct program *program, struct rule_match *match) {
+    struct macro_rule *rule = match->rule;
+    if (rule->subsequent_substitution == '0') {
+        if (rule->subsequent_index == -1)
+            rule->subsequent_index = intern_string(&program->states, rule->subsequent_prefix, rule->subsequent_prefix_len);
+        return rule->subsequent_index;
+    }
+
+    int symbol = rule->subsequent_substitution == 'r' ? match->read_symbol : match->write_symbol;
+    size_t symbol_len = program->alphabet.lengths[symbol];
+    size_t len = rule->subsequent_prefix_len + symbol_len + rule->subsequent_postfix_len;
+    char *name = arena_alloc(&program->scratch, len + 1);
+    if (name == NULL)
+        return -1;
+    memcpy(name, rule->subsequent_prefix, rule->subsequent_prefix_len);
+    memcpy(name + rule->subsequent_prefix_len, program->alphabet.names[symbol], symbol_len);
+    memcpy(name + rule->subsequent_prefix_len + symbol_len, rule->subsequent_postfix, rule->subsequent_postfix_len);
+    int state = intern_string(&program->states, name, len);
+    arena_clear(&program->scratch);
+    return state;
+}
+
+/*
+ * Resolve the transition of a state and read symbol from the rules into the entry. The accept and reject state have
+ * no transitions. Returns -1 if the state has more than one transition for the symbol, like build_transition_table,
+ * then the entry is left empty and the error of the program describes it.
+ */
+static int materialize_transition(struct lazy_simulator *simulator, int state, int symbol, struct lazy_entry *entry) {
+    struct program *program = simulator->program;
+    struct rule_match match = {0, NULL, 0, 0};
+    const char *name = program->states.names[state];
+    size_t len = program->states.lengths[state];
+
+    ++simulator->stats.materialized;
+    entry->key_state = state + 1;
+    entry->symbol = symbol;
+    entry->next_state = -1;
+    if (state == simulator->table.accept_state || state == simulator->table.reject_state)
+        return 0;
+
+    int key = intern_find(&simulator->state_rules.keys, name, len);
+    match_index(program, simulator, &simulator->state_rules, key, name, len, symbol, &match);
+    size_t max_prefix_len = simulator->max_prefix_len < len ? simulator->max_prefix_len : len;
+    for (size_t prefix_len = simulator->min_prefix_len; prefix_len <= max_prefix_len; ++prefix_len) {
+        key = intern_find(&simulator->prefix_rules.keys, name, prefix_len);
+        match_index(program, simulator, &simulator->prefix_rules, key, name, len, symbol, &match);
+    }
+
+    if (match.count > 1) {
+        entry->key_state = 0;
+        return set_compile_error(program, COMPILE_ERROR_NONDETERMINISTIC, NULL,
+                                 "The program is nondeterministic, state %s has more than one transition for symbol \"%s\"!",
+                                 name, program->alphabet.names[symbol]);
+    }
+    if (match.count == 1) {
+        entry->write_symbol = match.write_symbol;
+        entry->movement = match.rule->movement;
+        entry->next_state = get_subsequent_state(program, &match);
+        if (entry->next_state == -1) {
+            entry->key_state = 0;
+            program->line_num = 0;
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the subsequent state of state %s!", name);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Get the transition of a state and read symbol from the cache, it is materialized if it is not cached.
+ * A full probe sequence replaces its first entry. Returns NULL if the transition can not be materialized.
+ */
+static struct lazy_entry *get_transition(struct lazy_simulator *simulator, int state, int symbol) {
+    uint64_t hash = ((uint64_t) state << 16 | symbol) * 0x9E3779B97F4A7C15ull;
+    size_t mask = simulator->stats.slot_count - 1;
+    size_t slot = (size_t) (hash >> 32);
+
+    ++simulator->stats.lookups;
+    for (int probe = 0; probe < LAZY_CACHE_PROBES; ++probe) {
+        struct lazy_entry *entry = &simulator->slots[(slot + probe) & mask];
+        if (entry->key_state == (uint32_t) state + 1 && entry->symbol == symbol) {
+            ++simulator->stats.hits;
+            return entry;
+        }
+        if (entry->key_state == 0) {
+            ++simulator->stats.entry_count;
+            return materialize_transition(simulator, state, symbol, entry) == 0 ? entry : NULL;
+        }
+    }
+    ++simulator->stats.evictions;
+    struct lazy_entry *entry = &simulator->slots[slot & mask];
+    return materialize_transition(simulator, state, symbol, entry) == 0 ? entry : NULL;
+}
+
+/*
+ * Run the program like run_program, with the transitions resolved from the rules when they are first needed.
+ * Nondeterminism is only found for the (state, symbol) pairs the machine reaches. Returns -1 if the machine reaches
+ * a state with more than one transition for the symbol under the head or the tape can not grow, then the error of
+ * the program describes it and the result contains the configuration where the run stopped.
+ */
+int run_program_lazy(struct lazy_simulator *simulator, struct tape *tape, long long max_steps, struct run_result *result) {
+    int state = simulator->table.start_state;
+    long long steps = 0;
+    long long step_limit = max_steps == 0 ? INT64_MAX : max_steps;
+    int halted = 0;
+    int status = 0;
+    double start_time = get_seconds();
+
+    while (steps < step_limit) {
+        long head = tape->head;
+        struct lazy_entry *entry = get_transition(simulator, state, tape->cells[head]);
+        if (entry == NULL) {
+            status = -1;
+            break;
+        }
+        if (entry->next_state < 0) {
+            halted = 1;
+            break;
+        }
+        tape->cells[head] = entry->write_symbol;
+        head += entry->movement;
+        state = entry->next_state;
+        ++steps;
+
+        tape->head = head;
+        if (head < 0 || head >= tape->size) {
+            // the head is at most one cell outside of the tape
+            tape->head = head < 0 ? 0 : tape->size - 1;
+            if (tape_grow(tape) == -1) {
+                status = set_compile_error(simulator->program, COMPILE_ERROR_RESOURCE, NULL, "Could not grow the tape to %ld cells!", tape->size * 2);
+                break;
+            }
+            tape->head += head < 0 ? -1 : 1;
+        }
+    }
+
+    result->state = state;
+    result->steps = steps;
+    result->accelerated_steps = 0;
+    result->step_limit_reached = !halted && status == 0;
+    result->interrupted = 0;
+    result->seconds = get_seconds() - start_time;
+    return status;
+}
+
+/*
+ * Print the number of rules and created states and the hit rate and memory use of the transition cache.
+ */
+void print_lazy_stats(struct lazy_simulator *simulator) {
+    struct lazy_stats *stats = &simulator->stats;
+    printf("Macro rules: %d, states created: %d\n", simulator->rule_count, simulator->program->states.count);
+    printf("Transition cache: %lld lookups, %lld hits (%.1f %%), %lld materialized\n", stats->lookups, stats->hits,
+           stats->lookups > 0 ? 100.0 * stats->hits / stats->lookups : 0.0, stats->materialized);
+    printf("Transition cache size: %lld of %zu entries used, %lld evictions, %.1f MB\n", stats->entry_count, stats->slot_count,
+           stats->evictions, stats->memory_used / (1024.0 * 1024.0));
+}
+
+/*
+ * Free the rules, their indexes and the cache. The names and symbols of the rules are freed with the program.
+ */
+void free_lazy_simulator(struct lazy_simulator *simulator) {
+    struct rule_index *indexes[2] = {&simulator->state_rules, &simulator->prefix_rules};
+    for (int i = 0; i < 2; ++i) {
+        intern_table_free(&indexes[i]->keys);
+        free(indexes[i]->first);
+        free(indexes[i]->rules);
+    }
+    free(simulator->rules);
+    free(simulator->slots);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "simulator.h"
+
+/*
+ * Simulation of a deterministic program directly from its delta lines, without expanding them.
+ *
+ * Every delta line is kept as a macro rule: its read and write symbols and the state templates with their
+ * (*r)/(*w) substitution. The transition of a (state, symbol) pair is resolved when the machine first needs it,
+ * by matching the rules of the state name, and stored in a bounded cache of materialized transitions. Only the
+ * states the machine visits are created, so machines whose expanded program does not fit into memory can be run.
+ */
+
+// Number of slots which are probed for a transition before an old one is replaced
+#define LAZY_CACHE_PROBES 8
+
+/*
+ * Symbols of a read or write macro of a rule
+ */
+struct macro_symbols {
+    // symbols in the order of the macro, NULL if the macro is [*] or {*}: all alphabet symbols in alphabet order
+    uint16_t *symbols;
+    int symbol_count;
+    // flag if the symbols are in ascending order, then they are searched with binary search
+    char is_sorted;
+};
+
+/*
+ * Delta line in its macro form
+ */
+struct macro_rule {
+    // substitution of the state and subsequent state: 'r', 'w' or '0', see struct state_helper
+    char state_substitution;
+    char subsequent_substitution;
+    // matching of the symbols: '0' one symbol, '1' 1 to 1, 'n' 1 to n, see struct alphabet_symbols
+    char type;
+    // head movement: -1 left, 0 none, 1 right
+    int8_t movement;
+    // prefix and postfix of the state names, copied into the arena of the program
+    const char *state_prefix;
+    const char *state_postfix;
+    uint32_t state_prefix_len;
+    uint32_t state_postfix_len;
+    const char *subsequent_prefix;
+    const char *subsequent_postfix;
+    uint32_t subsequent_prefix_len;
+    uint32_t subsequent_postfix_len;
+    // state index of an unsubstituted subsequent state, -1 until it is first needed
+    int subsequent_index;
+    struct macro_symbols read_symbols;
+    struct macro_symbols write_symbols;
+};
+
+/*
+ * Materialized transition in the cache
+ */
+struct lazy_entry {
+    // state + 1, 0 for an empty slot
+    uint32_t key_state;
+    uint16_t symbol;
+    uint16_t write_symbol;
+    // subsequent state, -1 if the machine halts
+    int32_t next_state;
+    int8_t movement;
+};
+
+/*
+ * Rules grouped by a key: key i has the rules rules[first[i]], ..., rules[first[i + 1] - 1]
+ */
+struct rule_index {
+    struct intern_table keys;
+    int *first;
+    int *rules;
+};
+
+/*
+ * Statistics of the transition cache
+ */
+struct lazy_stats {
+    long long lookups;
+    long long hits;
+    // number of transitions which were resolved from the rules
+    long long materialized;
+    // number of transitions which replaced an older one in a full probe sequence
+    long long evictions;
+    long long entry_count;
+    size_t slot_count;
+    size_t memory_used;
+};
+
+struct lazy_simulator {
+    struct program *program;
+    struct macro_rule *rules;
+    int rule_count;
+    // rules with an unsubstituted state by state name
+    struct rule_index state_rules;
+    // rules with a substituted state by the prefix of the state name
+    struct rule_index prefix_rules;
+    // shortest and longest prefix of a substituted state
+    size_t min_prefix_len;
+    size_t max_prefix_len;
+    // only the start, accept and reject state are set, the states have no dense rows
+    struct transition_table table;
+    // slot_count entries, slot_count is a power of 2
+    struct lazy_entry *slots;
+    struct lazy_stats stats;
+};
+
+int lazy_simulator_init(struct lazy_simulator *simulator, struct program *program, const char *program_file_path, size_t cache_size);
+
+int run_program_lazy(struct lazy_simulator *simulator, struct tape *tape, long long max_steps, struct run_result *result);
+
+void print_lazy_stats(struct lazy_simulator *simulator);
+
+void free_lazy_simulator(struct lazy_simulator *simulator);
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "line_reader.h"
+
+/*
+ * Open a program file for reading. The path "-" reads from stdin.
+ * Returns 0 on success and -1 if the file can not be opened.
+ */
+int line_reader_open(struct line_reader *reader, const char *path) {
+    memset(reader, 0, sizeof(struct line_reader));
+
+    if (strcmp(path, "-") == 0) {
+        reader->stream = stdin;
+        return 0;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    // map regular files, everything else (pipes, fifos, character devices) is streamed
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0) {
+        void *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, file_stat.st_size, MADV_SEQUENTIAL);
+            reader->map = map;
+            reader->map_size = file_stat.st_size;
+            close(fd);
+            return 0;
+        }
+    }
+
+    reader->stream = fdopen(fd, "r");
+    if (reader->stream == NULL) {
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Read the lines of a buffer in memory. The buffer is not copied and has to stay valid until the reader is closed.
+ */
+void line_reader_open_buffer(struct line_reader *reader, const char *data, size_t size) {
+    memset(reader, 0, sizeof(struct line_reader));
+    // an empty buffer has no lines, like an empty stream
+    if (size == 0)
+        return;
+    reader->map = (char*) data;
+    reader->map_size = size;
+    reader->map_borrowed = 1;
+}
+
+/*
+ * Get the next line including its '\n' if present.
+ * Returns 1 if a line was read and 0 at the end of the input.
+ * The slice is valid until the next line is read.
+ */
+int line_reader_next(struct line_reader *reader, struct slice *line) {
+    if (reader->unread) {
+        reader->unread = 0;
+        *line = reader->last_line;
+        return 1;
+    }
+
+    if (reader->map != NULL) {
+        if (reader->position >= reader->map_size)
+            return 0;
+        const char *start = reader->map + reader->position;
+        size_t remaining = reader->map_size - reader->position;
+        const char *newline = memchr(start, '\n', remaining);
+        line->ptr = start;
+        line->len = newline != NULL ? (size_t) (newline - start) + 1 : remaining;
+        reader->position += line->len;
+        reader->last_line = *line;
+        return 1;
+    }
+
+    if (reader->stream == NULL)
+        return 0;
+    ssize_t line_length = getline(&reader->line_buffer, &reader->buffer_size, reader->stream);
+    if (line_length == -1)
+        return 0;
+    line->ptr = reader->line_buffer;
+    line->len = line_length;
+    reader->last_line = *line;
+    return 1;
+}
+
+/*
+ * Return the last line again with the next call of line_reader_next.
+ */
+void line_reader_unread(struct line_reader *reader) {
+    reader->unread = 1;
+}
+
+/*
+ * Check if the lines can be read again. Only mapped inputs and buffers can, streamed lines are gone once read.
+ */
+int line_reader_can_reset(struct line_reader *reader) {
+    return reader->map != NULL;
+}
+
+/*
+ * Get the current position of a reader which can be reset.
+ */
+struct line_reader_mark line_reader_get_mark(struct line_reader *reader) {
+    struct line_reader_mark mark;
+    mark.position = reader->position;
+    mark.last_line = reader->last_line;
+    mark.unread = reader->unread;
+    return mark;
+}
+
+/*
+ * Move the reader back to the mark, the next line is the line which followed the mark.
+ */
+void line_reader_reset(struct line_reader *reader, struct line_reader_mark mark) {
+    reader->position = mark.position;
+    reader->last_line = mark.last_line;
+    reader->unread = mark.unread;
+}
+
+/*
+ * Unmap or close the input and free the line buffer.
+ */
+void line_reader_close(struct line_reader *reader) {
+    if (reader->map != NULL && !reader->map_borrowed)
+        munmap(reader->map, reader->map_size);
+    if (reader->stream != NULL && reader->stream != stdin)
+        fclose(reader->stream);
+    free(reader->line_buffer);
+    memset(reader, 0, sizeof(struct line_reader));
+}
+
+/*
+ * Split off the part of rest up to the separator, like strsep does for strings.
+ * rest is moved behind the separator. If no separator is contained, the whole rest is returned
+ * and rest.ptr is set to NULL.
+ */
+struct slice next_field(struct slice *rest, char separator) {
+    struct slice field = *rest;
+    if (rest->ptr == NULL)
+        return field;
+
+    const char *separator_ptr = memchr(rest->ptr, separator, rest->len);
+    if (separator_ptr == NULL) {
+        rest->ptr = NULL;
+        rest->len = 0;
+        return field;
+    }
+    field.len = separator_ptr - rest->ptr;
+    rest->len -= field.len + 1;
+    rest->ptr = separator_ptr + 1;
+    return field;
+}
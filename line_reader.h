@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Part of a string given by pointer and length. Not null terminated.
+ */
+struct slice {
+    const char *ptr;
+    size_t len;
+};
+
+/*
+ * Reads the lines of a program file.
+ * Regular files are memory mapped and the lines are slices into the mapping, so no line is copied.
+ * Other inputs like stdin and pipes are streamed line by line through one reused buffer.
+ */
+struct line_reader {
+    // content of the memory mapped file or the buffer, NULL if the input is streamed
+    char *map;
+    // set if map is a buffer of the caller, which is not unmapped
+    int map_borrowed;
+    // size of the mapping
+    size_t map_size;
+    // offset of the next line in the mapping
+    size_t position;
+    // stream of the input if it is not mapped
+    FILE *stream;
+    // buffer of the current line if the input is streamed
+    char *line_buffer;
+    // allocated size of the line buffer
+    size_t buffer_size;
+    // last returned line
+    struct slice last_line;
+    // set if the last line should be returned again by the next call of line_reader_next
+    int unread;
+};
+
+/*
+ * Position of a line reader, the lines after it can be read again with line_reader_reset.
+ */
+struct line_reader_mark {
+    size_t position;
+    struct slice last_line;
+    int unread;
+};
+
+int line_reader_open(struct line_reader *reader, const char *path);
+
+void line_reader_open_buffer(struct line_reader *reader, const char *data, size_t size);
+
+int line_reader_next(struct line_reader *reader, struct slice *line);
+
+void line_reader_unread(struct line_reader *reader);
+
+int line_reader_can_reset(struct line_reader *reader);
+
+struct line_reader_mark line_reader_get_mark(struct line_reader *reader);
+
+void line_reader_reset(struct line_reader *reader, struct line_reader_mark mark);
+
+void line_reader_close(struct line_reader *reader);
+
+struct slice next_field(struct slice *rest, char separator);
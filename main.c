@@ -1,27 +1,744 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include "parser.h"
+#include "simulator.h"
+#include "explorer.h"
+#include "optimizer.h"
+#include "batch.h"
+#include "codegen.h"
+#include "block_simulator.h"
+#include "lazy_simulator.h"
+#include "profiler.h"
+#include "rle_tape.h"
+#include "checkpoint.h"
+#include "stats.h"
+
+/*
+ * Print the command line usage.
+ */
+void print_usage(char *program_name) {
+    printf("Usage: %s [options] [Program file] [opt. output file]\n", program_name);
+    printf("       %s --batch [options] [Program files or directories...]\n", program_name);
+    printf("Options:\n");
+    printf("  --stream  write deltas while expanding instead of keeping the compiled program in memory\n");
+    printf("  -j N      expand the delta lines and explore the configurations with N threads\n");
+    printf("  --format=text|bin|c  write the compiled program as text (default), in the binary format or as C source\n");
+    printf("                     of an executable which runs the deterministic program\n");
+    printf("  --max-deltas=N     fail if the delta lines expand to more than N deltas, the lines are counted first\n");
+    printf("  --max-states=N     fail if the compiled program has more than N states\n");
+    printf("  --dry-run          only count the deltas and states the delta lines expand to and print the estimate\n");
+    printf("  -O, --optimize     remove duplicate deltas and unreachable states and merge equivalent states\n");
+    printf("  --run=INPUT        run the compiled deterministic program on the input, symbols separated by ','\n");
+    printf("                     the compiled program is only written if an output file is given\n");
+    printf("  --explore=INPUT    explore all branches of the compiled nondeterministic program on the input\n");
+    printf("                     breadth first with -j N threads, stops at the first accepting configuration\n");
+    printf("  --max-steps=N      stop the run after N steps, or the exploration after depth N\n");
+    printf("  --max-memory=MB    stop the exploration when the configurations use more than MB megabytes\n");
+    printf("  --print-tape       print the tape after the run\n");
+    printf("  --time-phases      print the time of every compile phase, the deltas per second and the peak memory use\n");
+    printf("  --stats[=text|json]  print the time of every phase, the allocations and the expansion of the delta lines\n");
+    printf("  --stats-file=FILE  write the statistics to FILE instead of stdout\n");
+    printf("  --stats-top=N      number of delta lines with the most deltas in the statistics (default: 10)\n");
+    printf("  --accelerate       move the head over runs of a state which loops on the read symbols in one scan\n");
+    printf("  --block-size=N     run with blocks of N cells as macro symbols and cache the simulation of a block\n");
+    printf("  --block-cache=MB   size of the block cache (default: 64 MB)\n");
+    printf("  --lazy             run the program straight from its delta lines, a transition is only resolved when\n");
+    printf("                     the machine first needs it, the program is not compiled\n");
+    printf("  --lazy-cache=MB    size of the cache of resolved transitions (default: 64 MB)\n");
+    printf("  --profile          count the executed transitions of the run and print the delta lines, states and\n");
+    printf("                     transitions with the most steps\n");
+    printf("  --profile-folded=FILE  write the steps of every transition as folded stacks for flame graphs\n");
+    printf("  --profile-top=N    number of delta lines, states and transitions in the profile (default: 10)\n");
+    printf("  --rle-tape         run on a tape of runs of equal symbols, the head crosses a run of a self loop in one move\n");
+    printf("  --checkpoint=FILE  write the configuration of the run on the run length tape to FILE periodically,\n");
+    printf("                     when the run stops and on SIGINT or SIGTERM\n");
+    printf("  --checkpoint-interval=SECONDS  seconds between two checkpoints (default: 60)\n");
+    printf("  --resume=FILE      resume the run from a checkpoint, further checkpoints are written to FILE\n");
+    printf("  --incremental[=CACHE]  only expand the delta lines which changed since the last compilation,\n");
+    printf("                     the expansions are cached in CACHE (default: <Program file>.cache)\n");
+    printf("  --watch            compile incrementally again whenever the program file changes\n");
+    printf("  --batch            compile every given file and every file of the given directories to <file>.out,\n");
+    printf("                     -j N files at the same time, and report the result of every file\n");
+}
+
+/*
+ * Print the error of a failed compilation and exit.
+ */
+void exit_with_compile_error(struct compile_error *error) {
+    if (error->line > 0 && error->column > 0)
+        printf("Error in line %d, column %d: ", error->line, error->column);
+    else if (error->line > 0)
+        printf("Error in line %d: ", error->line);
+    printf("%s\n", error->message);
+    exit(-1);
+}
+
+/*
+ * Print the error which prevented or stopped a run to stderr, free the program and exit.
+ */
+void exit_with_run_error(struct program *program) {
+    fprintf(stderr, "%s\n", program->error.message);
+    free_program(program);
+    exit(-1);
+}
+
+/*
+ * Exit with a run error because the tape could not grow, unless the program already describes an error.
+ */
+void exit_with_tape_error(struct program *program) {
+    program->line_num = 0;
+    set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to grow the tape!");
+    exit_with_run_error(program);
+}
+
+/*
+ * Print the size of the compiled program which was estimated by the pre-pass over the delta lines.
+ */
+void print_expansion_budget(struct program *program) {
+    struct expansion_budget *budget = &program->budget;
+    if (!budget->measured) {
+        printf("The program is compiled already: %d deltas, %d states\n", program->deltas_count, program->states.count);
+        return;
+    }
+    printf("Delta lines: %d\n", budget->delta_lines);
+    printf("Deltas: %lld, %.1f MB in memory\n", budget->deltas_count, budget->deltas_count * sizeof(struct deltas) / (1024.0 * 1024.0));
+    if (budget->deltas_count > INT32_MAX)
+        printf("The deltas do not fit into memory, the program can only be compiled with --stream\n");
+    printf("States: at most %lld, %d declared\n", budget->max_states_count, program->states.count);
+    printf("Largest delta line: %d with %lld deltas\n", budget->largest_line, budget->largest_line_deltas);
+}
+
+/*
+ * Print the time of every compile phase, the expansion throughput and the peak memory use of the process.
+ */
+void print_phase_times(struct program *program) {
+    struct phase_times *times = &program->phase_times;
+    double total = times->header + times->deltas + times->optimize + times->write;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("Phase header: %.4f s\n", times->header);
+    printf("Phase deltas: %.4f s\n", times->deltas);
+    printf("Phase optimize: %.4f s\n", times->optimize);
+    printf("Phase write: %.4f s\n", times->write);
+    printf("Total: %.4f s\n", total);
+    printf("Expanded deltas: %ld, %.0f deltas/s expanded, %.0f deltas/s total\n", times->expanded_deltas,
+           times->deltas > 0 ? times->expanded_deltas / times->deltas : 0.0, total > 0 ? times->expanded_deltas / total : 0.0);
+    // ru_maxrss is in kilobytes on Linux
+    printf("Peak RSS: %.1f MB\n", usage.ru_maxrss / 1024.0);
+}
+
+/*
+ * Compile all given files and directories as a batch. Returns the exit code.
+ */
+int compile_batch(char **paths, int path_count, struct batch_options *options) {
+    struct batch batch;
+    batch_init(&batch, options);
+    for (int i = 0; i < path_count; ++i) {
+        if (add_batch_input(&batch, paths[i]) == -1) {
+            printf("Could not read directory %s or there is not enough memory for its files!\n", paths[i]);
+            exit(-1);
+        }
+    }
+    if (batch.file_count == 0) {
+        printf("No program files found!\n");
+        exit(-1);
+    }
+
+    run_batch(&batch);
+    print_batch_report(&batch);
+    int exit_code = batch.failed_count > 0 ? -1 : 0;
+    free_batch(&batch);
+    return exit_code;
+}
+
+/*
+ * Check if two stats of a file belong to the same version of the file.
+ */
+int is_same_file_version(struct stat *file_stat, struct stat *other) {
+    return file_stat->st_ino == other->st_ino && file_stat->st_size == other->st_size
+           && file_stat->st_mtim.tv_sec == other->st_mtim.tv_sec && file_stat->st_mtim.tv_nsec == other->st_mtim.tv_nsec;
+}
+
+/*
+ * Compile the program file again whenever it changes. Every compilation runs in a child process, so an error
+ * in the program does not end the watch. Returns 0 in the child, which continues with the compilation,
+ * the watching parent never returns.
+ */
+int watch_program_file(char *program_file_path) {
+    struct stat file_stat;
+    struct stat changed_stat;
+    struct timespec poll_interval = {0, 100 * 1000 * 1000};
+
+    for (;;) {
+        if (stat(program_file_path, &file_stat) == -1)
+            memset(&file_stat, 0, sizeof(struct stat));
+
+        struct timespec start_time, end_time;
+        clock_gettime(CLOCK_MONOTONIC, &start_time);
+        pid_t pid = fork();
+        if (pid == -1) {
+            printf("Could not start compilation!\n");
+            exit(-1);
+        }
+        if (pid == 0)
+            return 0;
+        int status;
+        waitpid(pid, &status, 0);
+        clock_gettime(CLOCK_MONOTONIC, &end_time);
+        double seconds = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) * 1e-9;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            fprintf(stderr, "Compiled %s in %.3f s, waiting for changes\n", program_file_path, seconds);
+        else
+            fprintf(stderr, "\nCompilation of %s failed, waiting for changes\n", program_file_path);
+        fflush(stdout);
+
+        // wait until the file changed and is not written anymore
+        for (;;) {
+            nanosleep(&poll_interval, NULL);
+            if (stat(program_file_path, &changed_stat) == -1 || is_same_file_version(&file_stat, &changed_stat))
+                continue;
+            nanosleep(&poll_interval, NULL);
+            if (stat(program_file_path, &file_stat) == 0 && is_same_file_version(&file_stat, &changed_stat))
+                break;
+        }
+    }
+}
 
 int main(int argc, char** argv) {
     char *program_file_path;
     char *output_file;
+    char *program_name = argv[0];
+    int stream = 0;
+    enum output_format format = FORMAT_TEXT;
+    char *run_input = NULL;
+    char *explore_input = NULL;
+    long long max_memory = 0;
+    long long max_steps = 0;
+    int print_tape = 0;
+    int accelerate = 0;
+    int time_phases = 0;
+    int stats = 0;
+    int stats_json = 0;
+    char *stats_file_path = NULL;
+    int stats_top = 10;
+    int block_size = 0;
+    long long block_cache_size = 64;
+    int lazy = 0;
+    long long lazy_cache_size = 64;
+    int profile = 0;
+    char *profile_folded_path = NULL;
+    int profile_top = 10;
+    int rle_tape = 0;
+    struct checkpoint_options checkpoint = {NULL, 60};
+    char *resume_path = NULL;
+    int optimize = 0;
+    int incremental = 0;
+    int watch = 0;
+    int batch = 0;
+    char *default_cache_path = NULL;
+    char *default_output_file = NULL;
+    struct compile_options options = {.thread_count = 1};
 
-    if (argc == 3) {
-        program_file_path = argv[1];
-        output_file = argv[2];
-    } else if (argc == 2) {
-        program_file_path = argv[1];
-        output_file = calloc(strlen(program_file_path) + 5, sizeof(char));
-        sprintf(output_file, "%s.out", program_file_path);
+    static struct option long_options[] = {
+        {"stream", no_argument, NULL, 's'},
+        {"format", required_argument, NULL, 'f'},
+        {"optimize", no_argument, NULL, 'O'},
+        {"run", required_argument, NULL, 'r'},
+        {"explore", required_argument, NULL, 'e'},
+        {"max-steps", required_argument, NULL, 'm'},
+        {"max-memory", required_argument, NULL, 'M'},
+        {"print-tape", no_argument, NULL, 'p'},
+        {"accelerate", no_argument, NULL, 'a'},
+        {"time-phases", no_argument, NULL, 't'},
+        {"stats", optional_argument, NULL, 'S'},
+        {"max-deltas", required_argument, NULL, 'D'},
+        {"max-states", required_argument, NULL, 'X'},
+        {"dry-run", no_argument, NULL, 'n'},
+        {"stats-file", required_argument, NULL, 'F'},
+        {"stats-top", required_argument, NULL, 'T'},
+        {"block-size", required_argument, NULL, 'B'},
+        {"block-cache", required_argument, NULL, 'C'},
+        {"lazy", no_argument, NULL, 'L'},
+        {"lazy-cache", required_argument, NULL, 'Z'},
+        {"profile", no_argument, NULL, 'P'},
+        {"profile-folded", required_argument, NULL, 'G'},
+        {"profile-top", required_argument, NULL, 'Q'},
+        {"rle-tape", no_argument, NULL, 'R'},
+        {"checkpoint", required_argument, NULL, 'K'},
+        {"checkpoint-interval", required_argument, NULL, 'I'},
+        {"resume", required_argument, NULL, 'U'},
+        {"incremental", optional_argument, NULL, 'i'},
+        {"watch", no_argument, NULL, 'w'},
+        {"batch", no_argument, NULL, 'b'},
+        {NULL, 0, NULL, 0}
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "j:O", long_options, NULL)) != -1) {
+        switch (option) {
+            case 's':
+                stream = 1;
+                break;
+            case 'f':
+                if (strcmp(optarg, "bin") == 0) {
+                    format = FORMAT_BINARY;
+                } else if (strcmp(optarg, "c") == 0) {
+                    format = FORMAT_C;
+                } else if (strcmp(optarg, "text") == 0) {
+                    format = FORMAT_TEXT;
+                } else {
+                    printf("Unknown output format %s!\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case 'j':
+                options.thread_count = atoi(optarg);
+                if (options.thread_count < 1) {
+                    printf("Number of threads has to be at least 1!\n");
+                    exit(-1);
+                }
+                break;
+            case 'r':
+                run_input = optarg;
+                break;
+            case 'O':
+                optimize = 1;
+                break;
+            case 'e':
+                explore_input = optarg;
+                break;
+            case 'M':
+                max_memory = atoll(optarg);
+                if (max_memory < 1) {
+                    printf("Memory limit has to be at least 1 MB!\n");
+                    exit(-1);
+                }
+                break;
+            case 'm':
+                max_steps = atoll(optarg);
+                if (max_steps < 1) {
+                    printf("Step limit has to be at least 1!\n");
+                    exit(-1);
+                }
+                break;
+            case 'p':
+                print_tape = 1;
+                break;
+            case 'a':
+                accelerate = 1;
+                break;
+            case 't':
+                time_phases = 1;
+                break;
+            case 'S':
+                stats = 1;
+                options.collect_stats = 1;
+                if (optarg != NULL && strcmp(optarg, "json") == 0) {
+                    stats_json = 1;
+                } else if (optarg != NULL && strcmp(optarg, "text") != 0) {
+                    printf("Unknown statistics format %s!\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case 'F':
+                stats_file_path = optarg;
+                break;
+            case 'D':
+                options.max_deltas = atoll(optarg);
+                if (options.max_deltas < 1) {
+                    printf("Delta limit has to be at least 1!\n");
+                    exit(-1);
+                }
+                break;
+            case 'X':
+                options.max_states = atoll(optarg);
+                if (options.max_states < 1) {
+                    printf("State limit has to be at least 1!\n");
+                    exit(-1);
+                }
+                break;
+            case 'n':
+                options.dry_run = 1;
+                break;
+            case 'T':
+                stats_top = atoi(optarg);
+                if (stats_top < 0) {
+                    printf("Number of listed delta lines can not be negative!\n");
+                    exit(-1);
+                }
+                break;
+            case 'B':
+                block_size = atoi(optarg);
+                if (block_size < 1 || block_size > MAX_BLOCK_SIZE) {
+                    printf("Block size has to be between 1 and %d!\n", MAX_BLOCK_SIZE);
+                    exit(-1);
+                }
+                break;
+            case 'C':
+                block_cache_size = atoll(optarg);
+                if (block_cache_size < 1) {
+                    printf("Block cache size has to be at least 1 MB!\n");
+                    exit(-1);
+                }
+                break;
+            case 'L':
+                lazy = 1;
+                break;
+            case 'Z':
+                lazy_cache_size = atoll(optarg);
+                if (lazy_cache_size < 1) {
+                    printf("Transition cache size has to be at least 1 MB!\n");
+                    exit(-1);
+                }
+                break;
+            case 'P':
+                profile = 1;
+                options.record_delta_lines = 1;
+                break;
+            case 'G':
+                profile = 1;
+                options.record_delta_lines = 1;
+                profile_folded_path = optarg;
+                break;
+            case 'Q':
+                profile_top = atoi(optarg);
+                if (profile_top < 0) {
+                    printf("Number of listed profile entries can not be negative!\n");
+                    exit(-1);
+                }
+                break;
+            case 'R':
+                rle_tape = 1;
+                break;
+            case 'K':
+                rle_tape = 1;
+                checkpoint.path = optarg;
+                break;
+            case 'I':
+                checkpoint.interval = atof(optarg);
+                if (checkpoint.interval <= 0) {
+                    printf("Checkpoint interval has to be positive!\n");
+                    exit(-1);
+                }
+                break;
+            case 'U':
+                rle_tape = 1;
+                resume_path = optarg;
+                break;
+            case 'i':
+                incremental = 1;
+                options.cache_path = optarg;
+                break;
+            case 'w':
+                watch = 1;
+                incremental = 1;
+                break;
+            case 'b':
+                batch = 1;
+                break;
+            default:
+                print_usage(program_name);
+                exit(-1);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (batch) {
+        if (run_input != NULL || resume_path != NULL || explore_input != NULL || incremental) {
+            printf("A batch can not be run, explored or compiled incrementally!\n");
+            exit(-1);
+        }
+        if (stream && (format != FORMAT_TEXT || optimize)) {
+            printf("A batch compiled in streaming mode can only be written in the text format and not be optimized!\n");
+            exit(-1);
+        }
+        if (argc == 0) {
+            print_usage(program_name);
+            exit(-1);
+        }
+        struct batch_options batch_options = {options.thread_count, stream, format, optimize};
+        return compile_batch(argv, argc, &batch_options);
+    }
+
+    if (argc == 2) {
+        program_file_path = argv[0];
+        output_file = argv[1];
+    } else if (argc == 1 && (run_input != NULL || resume_path != NULL || explore_input != NULL)) {
+        program_file_path = argv[0];
+        output_file = NULL;
+    } else if (argc == 1) {
+        program_file_path = argv[0];
+        default_output_file = calloc(strlen(program_file_path) + 5, sizeof(char));
+        sprintf(default_output_file, "%s.out", program_file_path);
+        output_file = default_output_file;
     } else {
-        printf("Usage: %s [Program file] [opt. output file]", argv[0]);
+        print_usage(program_name);
         exit(-1);
     }
 
-    struct program *program = parse_program(program_file_path);
+    if (stream && format != FORMAT_TEXT) {
+        printf("Only the text format can be written in streaming mode!\n");
+        exit(-1);
+    }
+
+    if ((run_input != NULL || resume_path != NULL) && explore_input != NULL) {
+        printf("A program can either be run or explored!\n");
+        exit(-1);
+    }
+
+    if (run_input != NULL && resume_path != NULL) {
+        printf("A run can either start with an input or be resumed from a checkpoint!\n");
+        exit(-1);
+    }
+
+    if (stream && optimize) {
+        printf("A program compiled in streaming mode can not be optimized!\n");
+        exit(-1);
+    }
+
+    if (accelerate && block_size > 0) {
+        printf("A program can either be run accelerated or with blocks!\n");
+        exit(-1);
+    }
+
+    if (stream && (run_input != NULL || resume_path != NULL || explore_input != NULL)) {
+        printf("A program compiled in streaming mode can not be run!\n");
+        exit(-1);
+    }
+
+    if (profile && (run_input == NULL || accelerate || block_size > 0 || lazy)) {
+        printf("Only a run with --run can be profiled, it can not be accelerated, run with blocks or lazily!\n");
+        exit(-1);
+    }
+
+    if (rle_tape && (run_input == NULL && resume_path == NULL)) {
+        printf("Only a run with --run or --resume can use the run length tape!\n");
+        exit(-1);
+    }
+
+    if (rle_tape && (accelerate || block_size > 0 || lazy || profile)) {
+        printf("A run on the run length tape crosses runs itself, it can not be accelerated, run with blocks, lazily or profiled!\n");
+        exit(-1);
+    }
+
+    if (resume_path != NULL && checkpoint.path == NULL)
+        checkpoint.path = resume_path;
+
+    if (lazy && (run_input == NULL || output_file != NULL)) {
+        printf("A program can only be run lazily with --run and without an output file!\n");
+        exit(-1);
+    }
+
+    if (lazy && (accelerate || block_size > 0 || stream || optimize || incremental || options.dry_run)) {
+        printf("A program run lazily is not compiled, it can not be accelerated, run with blocks, streamed, optimized or compiled incrementally!\n");
+        exit(-1);
+    }
+
+    if (lazy) {
+        struct lazy_simulator simulator;
+        struct tape tape;
+        struct run_result result;
+        struct program *program = create_program(&options);
+        if (program == NULL) {
+            printf("Not enough memory for the program!\n");
+            exit(-1);
+        }
+        if (lazy_simulator_init(&simulator, program, program_file_path, (size_t) lazy_cache_size << 20) == -1)
+            exit_with_compile_error(&program->error);
+        if (tape_init(&tape, program, run_input) == -1) {
+            free_lazy_simulator(&simulator);
+            exit_with_run_error(program);
+        }
+        if (run_program_lazy(&simulator, &tape, max_steps, &result) == -1) {
+            free_tape(&tape);
+            free_lazy_simulator(&simulator);
+            exit_with_run_error(program);
+        }
+        print_run_result(program, &simulator.table, &tape, &result, print_tape);
+        print_lazy_stats(&simulator);
+        free_tape(&tape);
+        free_lazy_simulator(&simulator);
+        free_program(program);
+        return 0;
+    }
+
+    if (incremental && options.cache_path == NULL) {
+        if (strcmp(program_file_path, "-") == 0) {
+            printf("A cache file has to be given for a program read from stdin!\n");
+            exit(-1);
+        }
+        default_cache_path = calloc(strlen(program_file_path) + 7, sizeof(char));
+        sprintf(default_cache_path, "%s.cache", program_file_path);
+        options.cache_path = default_cache_path;
+    }
+
+    if (watch && strcmp(program_file_path, "-") == 0) {
+        printf("A program read from stdin can not be watched!\n");
+        exit(-1);
+    }
+
+    if (watch)
+        watch_program_file(program_file_path);
+
+    struct program *program;
+    struct compile_error error;
+    if (options.dry_run) {
+        program = parse_program(program_file_path, &options, &error);
+        if (program == NULL)
+            exit_with_compile_error(&error);
+        print_expansion_budget(program);
+        free_program(program);
+        free(default_cache_path);
+        free(default_output_file);
+        return 0;
+    }
+
+    if (stream) {
+        program = compile_program_streaming(program_file_path, output_file, &options, &error);
+        if (program == NULL)
+            exit_with_compile_error(&error);
+    } else {
+        program = parse_program(program_file_path, &options, &error);
+        if (program == NULL)
+            exit_with_compile_error(&error);
+        if (optimize) {
+            struct optimize_stats stats;
+            double start_time = get_seconds();
+            if (optimize_program(program, &stats) == -1)
+                exit_with_compile_error(&program->error);
+            program->phase_times.optimize = get_seconds() - start_time;
+            print_optimize_stats(&stats);
+        }
+        int result = 0;
+        double start_time = get_seconds();
+        if (output_file != NULL && format == FORMAT_BINARY)
+            result = write_binary_program(program, output_file);
+        else if (output_file != NULL && format == FORMAT_C)
+            result = write_c_program(program, output_file);
+        else if (output_file != NULL)
+            result = write_compiled_program(program, output_file);
+        if (result == -1)
+            exit_with_compile_error(&program->error);
+        program->phase_times.write = get_seconds() - start_time;
+    }
+
+    if (time_phases)
+        print_phase_times(program);
+
+    if (stats) {
+        FILE *stats_file = stats_file_path != NULL ? fopen(stats_file_path, "w") : stdout;
+        if (stats_file == NULL) {
+            printf("Could not open statistics file %s!\n", stats_file_path);
+            exit(-1);
+        }
+        if (stats_json)
+            print_compile_stats_json(stats_file, program, stats_top);
+        else
+            print_compile_stats(stats_file, program, stats_top);
+        if (stats_file != stdout)
+            fclose(stats_file);
+    }
+
+    if (run_input != NULL || resume_path != NULL) {
+        struct transition_table table;
+        struct tape tape;
+        struct run_result result;
+        if (build_transition_table(&table, program) == -1)
+            exit_with_run_error(program);
+        if (accelerate && find_state_runs(&table, program) == -1) {
+            free_transition_table(&table);
+            exit_with_run_error(program);
+        }
+        // a resumed run takes its tape from the checkpoint
+        if (run_input != NULL && tape_init(&tape, program, run_input) == -1) {
+            free_transition_table(&table);
+            exit_with_run_error(program);
+        }
+        if (rle_tape) {
+            struct rle_configuration configuration;
+            if (resume_path != NULL && read_checkpoint(resume_path, &table, program, &configuration) == -1) {
+                free_transition_table(&table);
+                exit_with_run_error(program);
+            }
+            if (resume_path == NULL && rle_configuration_init(&configuration, &table, &tape) == -1)
+                exit_with_tape_error(program);
+            if (run_program_rle(&table, &configuration, max_steps, &checkpoint, &result) == -1)
+                exit_with_tape_error(program);
+            print_run_result(program, &table, NULL, &result, 0);
+            if (print_tape)
+                print_rle_tape(program, &configuration.tape);
+            print_rle_stats(&configuration);
+            free_rle_tape(&configuration.tape);
+        } else if (block_size > 0) {
+            struct block_simulator simulator;
+            if (block_simulator_init(&simulator, &table, block_size, (size_t) block_cache_size << 20) == -1) {
+                printf("Could not allocate the block cache of %lld MB!\n", block_cache_size);
+                exit(-1);
+            }
+            if (run_program_blocks(&simulator, &tape, max_steps, &result) == -1)
+                exit_with_tape_error(program);
+            print_run_result(program, &table, &tape, &result, print_tape);
+            print_block_stats(&simulator);
+            free_block_simulator(&simulator);
+        } else if (profile) {
+            struct run_profile run_profile;
+            if (profile_init(&run_profile, &table, program) == -1)
+                exit_with_run_error(program);
+            if (run_program_profiled(&table, &tape, max_steps, &run_profile, &result) == -1)
+                exit_with_tape_error(program);
+            print_run_result(program, &table, &tape, &result, print_tape);
+            print_profile(stdout, program, &table, &run_profile, profile_top);
+            if (profile_folded_path != NULL) {
+                FILE *folded_file = fopen(profile_folded_path, "w");
+                if (folded_file == NULL) {
+                    printf("Could not open profile file %s!\n", profile_folded_path);
+                    exit(-1);
+                }
+                write_folded_profile(folded_file, program, &table, &run_profile);
+                fclose(folded_file);
+            }
+            free_profile(&run_profile);
+        } else {
+            if (run_program(&table, &tape, max_steps, &result) == -1)
+                exit_with_tape_error(program);
+            print_run_result(program, &table, &tape, &result, print_tape);
+        }
+        if (run_input != NULL)
+            free_tape(&tape);
+        free_transition_table(&table);
+    }
+
+    if (explore_input != NULL) {
+        struct ntm_table table;
+        struct explore_options explore_options = {options.thread_count, max_steps, (size_t) max_memory << 20};
+        struct explore_result result;
+        if (build_ntm_table(&table, program) == -1)
+            exit_with_run_error(program);
+        struct explorer *explorer = create_explorer(program, &table, &explore_options);
+        if (explorer == NULL)
+            exit_with_run_error(program);
+        if (explore_program(explorer, explore_input, &result) == -1) {
+            free_explorer(explorer);
+            free_ntm_table(&table);
+            exit_with_run_error(program);
+        }
+        print_explore_result(explorer, &result, print_tape);
+        free_explorer(explorer);
+        free_ntm_table(&table);
+    }
 
-    write_compiled_program(program, output_file);
+    free_program(program);
+    free(default_cache_path);
+    free(default_output_file);
 
     return 0;
 }
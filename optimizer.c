@@ -0,0 +1,681 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "optimizer.h"
+#include "parser.h"
+#include "simulator.h"
+
+/*
+ * Check if two deltas are the same transition.
+ */
+static int deltas_equal(struct deltas *delta, struct deltas *other) {
+    return delta->state == other->state && delta->subsequent_state == other->subsequent_state
+           && delta->read_symbol == other->read_symbol && delta->write_symbol == other->write_symbol
+           && delta->movement == other->movement;
+}
+
+/*
+ * Hash of all fields of a delta.
+ */
+static uint64_t hash_delta(struct deltas *delta) {
+    uint64_t hash = ((uint64_t) delta->state << 32 | delta->subsequent_state) * 0x9e3779b97f4a7c15u;
+    hash ^= ((uint64_t) delta->read_symbol << 24 | (uint64_t) delta->write_symbol << 8 | (unsigned char) delta->movement) * 0xc2b2ae3d27d4eb4fu;
+    return hash ^ (hash >> 29);
+}
+
+/*
+ * Report that there is not enough memory for an optimization step. Returns -1.
+ */
+static int set_optimize_memory_error(struct program *program, const char *step) {
+    program->line_num = 0;
+    return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to %s!", step);
+}
+
+/*
+ * Remove deltas which are exact copies of an earlier delta, the order of the remaining deltas is kept.
+ * Returns -1 if there is not enough memory, then the deltas are unchanged.
+ */
+static int remove_duplicate_deltas(struct program *program) {
+    size_t slot_count = 16;
+    while (slot_count < (size_t) program->deltas_count * 2)
+        slot_count *= 2;
+    // index + 1 of the kept delta in every slot, 0 for empty slots
+    int *slots = calloc(slot_count, sizeof(int));
+    int kept_count = 0;
+
+    if (slots == NULL)
+        return set_optimize_memory_error(program, "remove the duplicate deltas");
+
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas *delta = &program->deltas[i];
+        size_t slot = hash_delta(delta) & (slot_count - 1);
+        int duplicate = 0;
+        for (; slots[slot] != 0; slot = (slot + 1) & (slot_count - 1)) {
+            if (deltas_equal(&program->deltas[slots[slot] - 1], delta)) {
+                duplicate = 1;
+                break;
+            }
+        }
+        if (duplicate)
+            continue;
+        program->deltas[kept_count] = *delta;
+        if (program->delta_lines != NULL)
+            program->delta_lines[kept_count] = program->delta_lines[i];
+        slots[slot] = ++kept_count;
+    }
+
+    program->deltas_count = kept_count;
+    free(slots);
+    return 0;
+}
+
+/*
+ * Group the deltas by state with a counting sort. The deltas of state s are
+ * order[first[s]] up to order[first[s + 1]], in the order of the program.
+ */
+static void group_deltas_by_state(struct program *program, int *first, int *order) {
+    memset(first, 0, (program->states.count + 1) * sizeof(int));
+    for (int i = 0; i < program->deltas_count; ++i)
+        ++first[program->deltas[i].state + 1];
+    for (int s = 0; s < program->states.count; ++s)
+        first[s + 1] += first[s];
+    for (int i = 0; i < program->deltas_count; ++i)
+        order[first[program->deltas[i].state]++] = i;
+    // placing moved every start to the start of the next state, shift them back
+    for (int s = program->states.count; s > 0; --s)
+        first[s] = first[s - 1];
+    first[0] = 0;
+}
+
+/*
+ * Replace every state by its representative and remove all states which are not their own representative
+ * together with their deltas. Removed states without representative have -1 and must not be used by kept deltas. The remaining states keep their order and are renumbered densely.
+ * A representative is listed if any state it represents was listed.
+ * Returns -1 if there is not enough memory. The program is only changed once the new state names are complete,
+ * but if the listed states can not grow afterwards, it is only fit to be freed.
+ */
+static int keep_representatives(struct program *program, int *representative) {
+    int state_count = program->states.count;
+    int *new_index = malloc(state_count * sizeof(int));
+    struct intern_table states;
+
+    if (new_index == NULL || intern_table_init(&states, state_count, &program->arena) == -1) {
+        free(new_index);
+        return set_optimize_memory_error(program, "renumber the states");
+    }
+    for (int s = 0; s < state_count; ++s) {
+        if (representative[s] == s)
+            new_index[s] = intern_string(&states, program->states.names[s], program->states.lengths[s]);
+        else
+            new_index[s] = -1;
+        if (representative[s] == s && new_index[s] == -1) {
+            intern_table_free(&states);
+            free(new_index);
+            return set_optimize_memory_error(program, "renumber the states");
+        }
+    }
+
+    int kept_count = 0;
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas delta = program->deltas[i];
+        if (representative[delta.state] != (int) delta.state)
+            continue;
+        delta.state = new_index[delta.state];
+        delta.subsequent_state = new_index[representative[delta.subsequent_state]];
+        if (program->delta_lines != NULL)
+            program->delta_lines[kept_count] = program->delta_lines[i];
+        program->deltas[kept_count++] = delta;
+    }
+    program->deltas_count = kept_count;
+
+    int *listed_states = program->listed_states;
+    int listed_state_count = program->listed_state_count;
+    free(program->state_is_listed);
+    program->listed_states = NULL;
+    program->state_is_listed = NULL;
+    program->listed_state_count = 0;
+    program->listed_capacity = 0;
+    int result = 0;
+    for (int i = 0; i < listed_state_count && result == 0; ++i) {
+        // representative is -1 for removed states
+        int state = representative[listed_states[i]];
+        if (state != -1)
+            result = list_state(program, new_index[state]);
+    }
+    free(listed_states);
+
+    intern_table_free(&program->states);
+    program->states = states;
+    free(new_index);
+    return result;
+}
+
+/*
+ * Get the start, accept and reject state, -1 if they are not declared.
+ */
+static void get_special_states(struct program *program, int *special_states) {
+    for (int i = 0; i < 3; ++i)
+        special_states[i] = program->listed_state_count > i ? program->listed_states[i] : -1;
+}
+
+/*
+ * Remove all states which are not reachable from the start state and their deltas.
+ * The start, accept and reject state are always kept. Returns -1 if there is not enough memory.
+ */
+static int remove_unreachable_states(struct program *program) {
+    int state_count = program->states.count;
+    int *first = malloc((state_count + 1) * sizeof(int));
+    int *order = malloc((program->deltas_count + 1) * sizeof(int));
+    int *queue = malloc(state_count * sizeof(int));
+    int *representative = malloc(state_count * sizeof(int));
+    int special_states[3];
+    int queue_start = 0;
+    int queue_end = 0;
+
+    if (first == NULL || order == NULL || queue == NULL || representative == NULL) {
+        free(first);
+        free(order);
+        free(queue);
+        free(representative);
+        return set_optimize_memory_error(program, "remove the unreachable states");
+    }
+    group_deltas_by_state(program, first, order);
+    get_special_states(program, special_states);
+    for (int s = 0; s < state_count; ++s)
+        representative[s] = -1;
+
+    // breadth first search, representative[s] == s marks reachable states
+    for (int i = 0; i < 3; ++i) {
+        if (special_states[i] != -1 && representative[special_states[i]] == -1) {
+            representative[special_states[i]] = special_states[i];
+            queue[queue_end++] = special_states[i];
+        }
+    }
+    while (queue_start < queue_end) {
+        int state = queue[queue_start++];
+        for (int i = first[state]; i < first[state + 1]; ++i) {
+            int subsequent_state = program->deltas[order[i]].subsequent_state;
+            if (representative[subsequent_state] == -1) {
+                representative[subsequent_state] = subsequent_state;
+                queue[queue_end++] = subsequent_state;
+            }
+        }
+    }
+
+    int result = keep_representatives(program, representative);
+
+    free(first);
+    free(order);
+    free(queue);
+    free(representative);
+    return result;
+}
+
+/*
+ * Compare two transition signature entries for qsort.
+ */
+static int compare_signature_entries(const void *a, const void *b) {
+    uint64_t entry = *(const uint64_t*) a;
+    uint64_t other = *(const uint64_t*) b;
+    return entry < other ? -1 : entry > other;
+}
+
+/*
+ * Hash of a signature.
+ */
+static uint64_t hash_signature(const uint64_t *signature, int length) {
+    uint64_t hash = length;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ signature[i]) * 0x9e3779b97f4a7c15u;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+/*
+ * Partition of the states into blocks of possibly equivalent states, used by minimize_states.
+ * The states of block b are elements[block_begin[b]] up to elements[block_end[b]].
+ */
+struct partition {
+    struct program *program;
+    // deltas of state s are deltas[order[first[s]]] up to deltas[order[first[s + 1]]]
+    int *first;
+    int *order;
+    // states with a delta into state s are predecessors[predecessor_first[s]] up to predecessors[predecessor_first[s + 1]]
+    int *predecessor_first;
+    int *predecessors;
+    int *block;
+    int *elements;
+    int *position;
+    int *block_begin;
+    int *block_end;
+    int block_count;
+};
+
+/*
+ * Write the signature of a state: its block followed by the sorted set of its transitions,
+ * with the subsequent states replaced by their blocks. Returns the length of the signature.
+ */
+static int get_signature(struct partition *partition, int state, uint64_t *signature) {
+    int length = 0;
+    signature[length++] = partition->block[state];
+    for (int i = partition->first[state]; i < partition->first[state + 1]; ++i) {
+        struct deltas *delta = &partition->program->deltas[partition->order[i]];
+        uint64_t movement = delta->movement == '<' ? 0 : (delta->movement == '>' ? 1 : 2);
+        signature[length++] = (uint64_t) delta->read_symbol << 48 | (uint64_t) delta->write_symbol << 32
+                              | movement << 30 | partition->block[delta->subsequent_state];
+    }
+    qsort(signature + 1, length - 1, sizeof(uint64_t), compare_signature_entries);
+    // transitions which became equal by replacing states with blocks count once
+    int unique_length = length > 1 ? 2 : 1;
+    for (int i = 2; i < length; ++i) {
+        if (signature[i] != signature[unique_length - 1])
+            signature[unique_length++] = signature[i];
+    }
+    return unique_length;
+}
+
+/*
+ * Move the given states of one block into a new block.
+ */
+static void split_block(struct partition *partition, int *states, int count) {
+    int block = partition->block[states[0]];
+    int end = partition->block_end[block];
+    for (int i = 0; i < count; ++i) {
+        int state = states[i];
+        int last = --partition->block_end[block];
+        int other = partition->elements[last];
+        partition->elements[partition->position[state]] = other;
+        partition->position[other] = partition->position[state];
+        partition->elements[last] = state;
+        partition->position[state] = last;
+    }
+    int new_block = partition->block_count++;
+    partition->block_begin[new_block] = partition->block_end[block];
+    partition->block_end[new_block] = end;
+    for (int i = 0; i < count; ++i)
+        partition->block[states[i]] = new_block;
+}
+
+/*
+ * Free the arrays of a partition, arrays which were not allocated are NULL.
+ */
+static void free_partition(struct partition *partition) {
+    free(partition->first);
+    free(partition->order);
+    free(partition->predecessor_first);
+    free(partition->predecessors);
+    free(partition->block);
+    free(partition->elements);
+    free(partition->position);
+    free(partition->block_begin);
+    free(partition->block_end);
+}
+
+/*
+ * Create the initial partition of the states: all states in one block, then the accept and reject state are split off.
+ * Returns -1 if there is not enough memory, then the partition is freed.
+ */
+static int create_partition(struct partition *partition, struct program *program, int *special_states) {
+    int state_count = program->states.count;
+
+    partition->program = program;
+    partition->first = malloc((state_count + 1) * sizeof(int));
+    partition->order = malloc((program->deltas_count + 1) * sizeof(int));
+    partition->predecessor_first = calloc(state_count + 1, sizeof(int));
+    partition->predecessors = malloc((program->deltas_count + 1) * sizeof(int));
+    partition->block = malloc(state_count * sizeof(int));
+    partition->elements = malloc(state_count * sizeof(int));
+    partition->position = malloc(state_count * sizeof(int));
+    partition->block_begin = malloc((state_count + 1) * sizeof(int));
+    partition->block_end = malloc((state_count + 1) * sizeof(int));
+    int *predecessor_fill = malloc((state_count + 1) * sizeof(int));
+    if (partition->first == NULL || partition->order == NULL || partition->predecessor_first == NULL
+        || partition->predecessors == NULL || partition->block == NULL || partition->elements == NULL
+        || partition->position == NULL || partition->block_begin == NULL || partition->block_end == NULL
+        || predecessor_fill == NULL) {
+        free_partition(partition);
+        free(predecessor_fill);
+        return -1;
+    }
+    group_deltas_by_state(program, partition->first, partition->order);
+
+    for (int i = 0; i < program->deltas_count; ++i)
+        ++partition->predecessor_first[program->deltas[i].subsequent_state + 1];
+    for (int s = 0; s < state_count; ++s)
+        partition->predecessor_first[s + 1] += partition->predecessor_first[s];
+    memcpy(predecessor_fill, partition->predecessor_first, (state_count + 1) * sizeof(int));
+    for (int i = 0; i < program->deltas_count; ++i)
+        partition->predecessors[predecessor_fill[program->deltas[i].subsequent_state]++] = program->deltas[i].state;
+    free(predecessor_fill);
+
+    partition->block_count = 1;
+    partition->block_begin[0] = 0;
+    partition->block_end[0] = state_count;
+    for (int s = 0; s < state_count; ++s) {
+        partition->block[s] = 0;
+        partition->elements[s] = s;
+        partition->position[s] = s;
+    }
+    for (int i = 1; i < 3; ++i) {
+        if (special_states[i] != -1 && partition->block_end[0] - partition->block_begin[0] > 1)
+            split_block(partition, &special_states[i], 1);
+    }
+    return 0;
+}
+
+/*
+ * Split the blocks of the partition until all states of a block have the same signature.
+ * Only states whose subsequent states changed their block are checked again in the next round, and the largest
+ * part of a split block keeps its number, so every state is checked O(log n) times like in Hopcroft's algorithm.
+ * Returns the number of refinement rounds, -1 if there is not enough memory.
+ */
+static int refine_partition(struct partition *partition) {
+    int state_count = partition->program->states.count;
+
+    // states which are checked in the current and the next round
+    int *dirty = malloc(state_count * sizeof(int));
+    int *next_dirty = malloc(state_count * sizeof(int));
+    char *is_dirty = calloc(state_count, sizeof(char));
+    char *is_next_dirty = calloc(state_count, sizeof(char));
+    // signatures of the dirty states, the signature of dirty[k] starts at signatures[signature_offsets[k]]
+    uint64_t *signatures = malloc((partition->program->deltas_count + 2 * (size_t) state_count + 1) * sizeof(uint64_t));
+    size_t *signature_offsets = malloc(state_count * sizeof(size_t));
+    int *signature_lengths = malloc(state_count * sizeof(int));
+    // groups of dirty states with the same signature, linked by next_in_group starting at group_first
+    int *group_first = malloc(state_count * sizeof(int));
+    int *group_size = malloc(state_count * sizeof(int));
+    int *group_next_in_block = malloc(state_count * sizeof(int));
+    int *next_in_group = malloc(state_count * sizeof(int));
+    // per block: number of dirty states, first group and the group of the states which are not dirty
+    int *block_dirty_count = calloc(state_count + 1, sizeof(int));
+    int *block_first_group = malloc((state_count + 1) * sizeof(int));
+    int *block_reference_group = malloc((state_count + 1) * sizeof(int));
+    int *touched_blocks = malloc(state_count * sizeof(int));
+    int *moved_states = malloc(state_count * sizeof(int));
+    int *slots = NULL;
+    int dirty_count = state_count;
+    int rounds = 0;
+
+    if (dirty == NULL || next_dirty == NULL || is_dirty == NULL || is_next_dirty == NULL || signatures == NULL
+        || signature_offsets == NULL || signature_lengths == NULL || group_first == NULL || group_size == NULL
+        || group_next_in_block == NULL || next_in_group == NULL || block_dirty_count == NULL
+        || block_first_group == NULL || block_reference_group == NULL || touched_blocks == NULL || moved_states == NULL)
+        rounds = -1;
+    for (int s = 0; s < state_count && rounds == 0; ++s)
+        dirty[s] = s;
+
+    while (rounds != -1 && dirty_count > 0) {
+        ++rounds;
+        int group_count = 0;
+        int touched_count = 0;
+        size_t signature_position = 0;
+        size_t slot_count = 16;
+        while (slot_count < (size_t) dirty_count * 2)
+            slot_count *= 2;
+        int *new_slots = realloc(slots, slot_count * sizeof(int));
+        if (new_slots == NULL) {
+            rounds = -1;
+            break;
+        }
+        slots = new_slots;
+        memset(slots, 0, slot_count * sizeof(int));
+
+        // group the dirty states by signature, the block is part of the signature
+        for (int k = 0; k < dirty_count; ++k) {
+            int state = dirty[k];
+            is_dirty[state] = 1;
+            uint64_t *signature = &signatures[signature_position];
+            int length = get_signature(partition, state, signature);
+            signature_offsets[k] = signature_position;
+            signature_lengths[k] = length;
+            signature_position += length;
+
+            size_t slot = hash_signature(signature, length) & (slot_count - 1);
+            for (;; slot = (slot + 1) & (slot_count - 1)) {
+                int group = slots[slot] - 1;
+                if (group == -1) {
+                    group = group_count++;
+                    slots[slot] = group + 1;
+                    group_first[group] = -1;
+                    group_size[group] = 0;
+                    int block = partition->block[state];
+                    if (block_dirty_count[block] == 0) {
+                        touched_blocks[touched_count++] = block;
+                        block_first_group[block] = -1;
+                    }
+                    group_next_in_block[group] = block_first_group[block];
+                    block_first_group[block] = group;
+                }
+                int first_state = group_first[group] == -1 ? k : group_first[group];
+                if (group_first[group] == -1 || (signature_lengths[first_state] == length
+                    && memcmp(&signatures[signature_offsets[first_state]], signature, length * sizeof(uint64_t)) == 0)) {
+                    next_in_group[k] = group_first[group];
+                    group_first[group] = k;
+                    ++group_size[group];
+                    ++block_dirty_count[partition->block[state]];
+                    break;
+                }
+            }
+        }
+
+        // find the group of the states which are not dirty, before any block number changes
+        for (int t = 0; t < touched_count; ++t) {
+            int block = touched_blocks[t];
+            block_reference_group[block] = -1;
+            if (partition->block_end[block] - partition->block_begin[block] == block_dirty_count[block])
+                continue;
+            int reference_state = -1;
+            for (int i = partition->block_begin[block]; reference_state == -1; ++i) {
+                if (!is_dirty[partition->elements[i]])
+                    reference_state = partition->elements[i];
+            }
+            uint64_t *signature = &signatures[signature_position];
+            int length = get_signature(partition, reference_state, signature);
+            for (int group = block_first_group[block]; group != -1; group = group_next_in_block[group]) {
+                int k = group_first[group];
+                if (signature_lengths[k] == length && memcmp(&signatures[signature_offsets[k]], signature, length * sizeof(uint64_t)) == 0)
+                    block_reference_group[block] = group;
+            }
+        }
+
+        // split the blocks, the largest part keeps the block number
+        int moved_count = 0;
+        for (int t = 0; t < touched_count; ++t) {
+            int block = touched_blocks[t];
+            int clean_count = partition->block_end[block] - partition->block_begin[block] - block_dirty_count[block];
+            int reference_group = block_reference_group[block];
+            // -1 stands for the part with the states which are not dirty
+            int largest_group = -1;
+            int largest_size = reference_group == -1 ? clean_count : 0;
+            for (int group = block_first_group[block]; group != -1; group = group_next_in_block[group]) {
+                int size = group_size[group] + (group == reference_group ? clean_count : 0);
+                if (size > largest_size) {
+                    largest_group = group;
+                    largest_size = size;
+                }
+            }
+            if (largest_group == reference_group)
+                largest_group = -1;
+
+            if (largest_group != -1 && clean_count > 0) {
+                // the states which are not dirty move together with the reference group
+                int count = 0;
+                for (int i = partition->block_begin[block]; i < partition->block_end[block]; ++i) {
+                    if (!is_dirty[partition->elements[i]])
+                        moved_states[moved_count + count++] = partition->elements[i];
+                }
+                if (reference_group != -1) {
+                    for (int k = group_first[reference_group]; k != -1; k = next_in_group[k])
+                        moved_states[moved_count + count++] = dirty[k];
+                }
+                split_block(partition, &moved_states[moved_count], count);
+                moved_count += count;
+            }
+            for (int group = block_first_group[block]; group != -1; group = group_next_in_block[group]) {
+                if (group == largest_group || group == reference_group)
+                    continue;
+                int count = 0;
+                for (int k = group_first[group]; k != -1; k = next_in_group[k])
+                    moved_states[moved_count + count++] = dirty[k];
+                split_block(partition, &moved_states[moved_count], count);
+                moved_count += count;
+            }
+            block_dirty_count[block] = 0;
+        }
+
+        // predecessors of states which changed their block are checked in the next round
+        int next_dirty_count = 0;
+        for (int k = 0; k < dirty_count; ++k)
+            is_dirty[dirty[k]] = 0;
+        for (int m = 0; m < moved_count; ++m) {
+            int state = moved_states[m];
+            for (int i = partition->predecessor_first[state]; i < partition->predecessor_first[state + 1]; ++i) {
+                int predecessor = partition->predecessors[i];
+                if (!is_next_dirty[predecessor]) {
+                    is_next_dirty[predecessor] = 1;
+                    next_dirty[next_dirty_count++] = predecessor;
+                }
+            }
+        }
+        for (int k = 0; k < next_dirty_count; ++k)
+            is_next_dirty[next_dirty[k]] = 0;
+        int *swap = dirty;
+        dirty = next_dirty;
+        next_dirty = swap;
+        dirty_count = next_dirty_count;
+    }
+
+
+    free(dirty);
+    free(next_dirty);
+    free(is_dirty);
+    free(is_next_dirty);
+    free(signatures);
+    free(signature_offsets);
+    free(signature_lengths);
+    free(group_first);
+    free(group_size);
+    free(group_next_in_block);
+    free(next_in_group);
+    free(block_dirty_count);
+    free(block_first_group);
+    free(block_reference_group);
+    free(touched_blocks);
+    free(moved_states);
+    free(slots);
+    return rounds;
+}
+
+/*
+ * Merge equivalent states with partition refinement. States start in one block, except the accept and reject
+ * state which get their own blocks. A block is split when its states have different signatures, see get_signature
+ * and refine_partition. At the end, states in one block behave the same on every tape and are replaced by one representative.
+ * Returns the number of refinement rounds, -1 if the program has too many states for the signatures
+ * or there is not enough memory.
+ */
+static int minimize_states(struct program *program) {
+    int state_count = program->states.count;
+    struct partition partition;
+    int special_states[3];
+
+    if (state_count >= 1 << 30) {
+        program->line_num = 0;
+        return set_compile_error(program, COMPILE_ERROR_LIMIT, NULL, "Too many states to minimize the program!");
+    }
+
+    get_special_states(program, special_states);
+    if (create_partition(&partition, program, special_states) == -1)
+        return set_optimize_memory_error(program, "minimize the program");
+    int rounds = refine_partition(&partition);
+
+    // the representative of a block is its start, accept or reject state, otherwise its first state
+    int *block_representative = malloc((state_count + 1) * sizeof(int));
+    int *representative = malloc(state_count * sizeof(int));
+    if (rounds == -1 || block_representative == NULL || representative == NULL) {
+        free_partition(&partition);
+        free(block_representative);
+        free(representative);
+        return set_optimize_memory_error(program, "minimize the program");
+    }
+    for (int b = 0; b < partition.block_count; ++b)
+        block_representative[b] = -1;
+    for (int i = 0; i < 3; ++i) {
+        if (special_states[i] != -1 && block_representative[partition.block[special_states[i]]] == -1)
+            block_representative[partition.block[special_states[i]]] = special_states[i];
+    }
+    for (int s = 0; s < state_count; ++s) {
+        if (block_representative[partition.block[s]] == -1)
+            block_representative[partition.block[s]] = s;
+        representative[s] = block_representative[partition.block[s]];
+    }
+
+    int result = keep_representatives(program, representative);
+    if (result == 0)
+        result = remove_duplicate_deltas(program);
+
+    free_partition(&partition);
+    free(block_representative);
+    free(representative);
+    return result == -1 ? -1 : rounds;
+}
+
+/*
+ * Record the size of the program before a step.
+ */
+static void begin_optimize_step(struct program *program, struct optimize_step *step) {
+    step->states_before = program->states.count;
+    step->deltas_before = program->deltas_count;
+    step->seconds = get_seconds();
+}
+
+/*
+ * Record the size of the program after a step.
+ */
+static void end_optimize_step(struct program *program, struct optimize_step *step) {
+    step->states_after = program->states.count;
+    step->deltas_after = program->deltas_count;
+    step->seconds = get_seconds() - step->seconds;
+}
+
+/*
+ * Optimize the compiled program in three steps: remove duplicate deltas, remove states which are not reachable
+ * from the start state and merge equivalent states. The machine accepts and rejects the same inputs afterwards.
+ * Returns -1 if the states can not be merged or there is not enough memory, then the error of the program describes it.
+ */
+int optimize_program(struct program *program, struct optimize_stats *stats) {
+    begin_optimize_step(program, &stats->duplicates);
+    if (remove_duplicate_deltas(program) == -1)
+        return -1;
+    end_optimize_step(program, &stats->duplicates);
+
+    begin_optimize_step(program, &stats->unreachable);
+    if (remove_unreachable_states(program) == -1)
+        return -1;
+    end_optimize_step(program, &stats->unreachable);
+
+    begin_optimize_step(program, &stats->minimization);
+    stats->refinement_rounds = minimize_states(program);
+    end_optimize_step(program, &stats->minimization);
+    return stats->refinement_rounds == -1 ? -1 : 0;
+}
+
+/*
+ * Print the savings of one optimization step.
+ */
+static void print_optimize_step(const char *name, struct optimize_step *step) {
+    fprintf(stderr, "  %-22s states %d -> %d (-%d), deltas %d -> %d (-%d), %.3f s\n", name,
+            step->states_before, step->states_after, step->states_before - step->states_after,
+            step->deltas_before, step->deltas_after, step->deltas_before - step->deltas_after, step->seconds);
+}
+
+/*
+ * Print the savings of all optimization steps to stderr, so they do not mix with a program written to stdout.
+ */
+void print_optimize_stats(struct optimize_stats *stats) {
+    fprintf(stderr, "Optimization:\n");
+    print_optimize_step("duplicate deltas:", &stats->duplicates);
+    print_optimize_step("unreachable states:", &stats->unreachable);
+    print_optimize_step("state minimization:", &stats->minimization);
+    fprintf(stderr, "  refinement rounds:     %d\n", stats->refinement_rounds);
+}
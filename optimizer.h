@@ -0,0 +1,29 @@
+#pragma once
+
+#include "program_helper.h"
+
+/*
+ * Size of the program before and after one step of the optimization
+ */
+struct optimize_step {
+    int states_before;
+    int states_after;
+    int deltas_before;
+    int deltas_after;
+    double seconds;
+};
+
+/*
+ * Savings of the optimization steps
+ */
+struct optimize_stats {
+    struct optimize_step duplicates;
+    struct optimize_step unreachable;
+    struct optimize_step minimization;
+    // number of partition refinement rounds until the partition was stable
+    int refinement_rounds;
+};
+
+int optimize_program(struct program *program, struct optimize_stats *stats);
+
+void print_optimize_stats(struct optimize_stats *stats);
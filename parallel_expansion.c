@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "parallel_expansion.h"
+#include "parser.h"
+
+// Number of delta lines which are read before they are expanded in parallel
+#define BATCH_LINE_COUNT 16384
+// Number of lines a worker takes from the batch at once
+#define CLAIM_LINE_COUNT 8
+
+/*
+ * Delta lines which are expanded by the workers together
+ */
+struct expansion_batch {
+    // delta lines of the batch
+    struct slice *lines;
+    // range of the generated deltas in the worker delta array for every line
+    struct expanded_line *expanded_lines;
+    // index of the worker which expanded the line for every line
+    int *line_workers;
+    // number of lines in the batch
+    int line_count;
+    // line number of the first line of the batch
+    int first_line_num;
+    // index of the next line which is not yet taken by a worker
+    atomic_int next_line;
+    // set when a worker found a malformed line, then no more lines are taken
+    atomic_int failed;
+};
+
+/*
+ * Thread which expands delta lines into its own delta array
+ */
+struct expansion_worker {
+    pthread_t thread;
+    // index of the worker, stored in line_workers of the batch
+    int index;
+    // private program with its own state table, delta array and arenas. The alphabet is shared read only.
+    struct program *program;
+    // global state index for every local state index, -1 if the state was not yet merged
+    int *state_remap;
+    // allocated size of state_remap
+    int state_remap_capacity;
+    // batch which is currently expanded
+    struct expansion_batch *batch;
+};
+
+/*
+ * Create the private program of a worker, which shares the alphabet of the program.
+ * Returns NULL if there is not enough memory.
+ */
+struct program *create_worker_program(struct program *program) {
+    struct program *worker_program = create_program(NULL);
+    if (worker_program == NULL)
+        return NULL;
+    worker_program->alphabet = program->alphabet;
+    worker_program->alphabet_indexes = program->alphabet_indexes;
+    worker_program->symbol_set_names = program->symbol_set_names;
+    worker_program->symbol_sets = program->symbol_sets;
+    worker_program->first_delta_line = program->first_delta_line;
+    if (intern_table_init(&worker_program->states, 1024, &worker_program->arena) == -1) {
+        free_worker_program(worker_program);
+        return NULL;
+    }
+    return worker_program;
+}
+
+/*
+ * Free the private program of a worker. The shared alphabet and symbol sets are freed with the program.
+ */
+void free_worker_program(struct program *worker_program) {
+    if (worker_program == NULL)
+        return;
+    intern_table_free(&worker_program->states);
+    free(worker_program->deltas);
+    free(worker_program->listed_states);
+    free(worker_program->state_is_listed);
+    arena_free(&worker_program->scratch);
+    arena_free(&worker_program->arena);
+    free(worker_program);
+}
+
+/*
+ * Thread function of the workers. Takes lines of the batch until all are expanded or a line is malformed.
+ * A worker stops at its first malformed line. Lines are taken in increasing order, so all lines before
+ * the first malformed line of the batch are expanded and the error with the lowest line is the first error.
+ */
+static void *run_expansion_worker(void *argument) {
+    struct expansion_worker *worker = argument;
+    struct expansion_batch *batch = worker->batch;
+    int start;
+
+    while (!atomic_load(&batch->failed) && (start = atomic_fetch_add(&batch->next_line, CLAIM_LINE_COUNT)) < batch->line_count) {
+        int end = start + CLAIM_LINE_COUNT < batch->line_count ? start + CLAIM_LINE_COUNT : batch->line_count;
+        for (int i = start; i < end; ++i) {
+            if (expand_delta_line(worker->program, batch->lines[i], batch->first_line_num + i, &batch->expanded_lines[i]) == -1) {
+                atomic_store(&batch->failed, 1);
+                return NULL;
+            }
+            batch->line_workers[i] = worker->index;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Set the first error of the workers in the program. Returns -1.
+ */
+static int take_worker_error(struct program *program, struct expansion_worker *workers, int thread_count) {
+    struct compile_error *first_error = NULL;
+    for (int w = 0; w < thread_count; ++w) {
+        struct compile_error *error = &workers[w].program->error;
+        if (error->message[0] != '\0' && (first_error == NULL || error->line < first_error->line))
+            first_error = error;
+    }
+    program->error = *first_error;
+    return -1;
+}
+
+/*
+ * Get the global index of a local state of a worker and add the state to the program if it is new.
+ * States are added in the same order as the sequential expansion would add them.
+ * Returns -1 if there is not enough memory for the state.
+ */
+static int merge_state(struct program *program, struct expansion_worker *worker, int local_state, int substituted) {
+    int state = worker->state_remap[local_state];
+    if (state == -1) {
+        struct intern_table *local_states = &worker->program->states;
+        state = intern_string(&program->states, local_states->names[local_state], local_states->lengths[local_state]);
+        if (state == -1)
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the state %s!", local_states->names[local_state]);
+        worker->state_remap[local_state] = state;
+    }
+    if (substituted && list_state(program, state) == -1)
+        return -1;
+    return state;
+}
+
+/*
+ * Copy the deltas of all lines of the batch into the program in line order and map their states to global indexes.
+ * Returns -1 if a line exceeds the delta or state limit of the program or there is not enough memory.
+ */
+static int merge_batch(struct program *program, struct expansion_worker *workers, int thread_count, struct expansion_batch *batch) {
+    // make room for the states which were added by the workers in this batch
+    for (int w = 0; w < thread_count; ++w) {
+        struct expansion_worker *worker = &workers[w];
+        int local_state_count = worker->program->states.count;
+        if (local_state_count > worker->state_remap_capacity) {
+            int *state_remap = realloc(worker->state_remap, local_state_count * sizeof(int));
+            if (state_remap == NULL) {
+                program->line_num = program->first_delta_line + batch->first_line_num;
+                return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to merge %d states!", local_state_count);
+            }
+            worker->state_remap = state_remap;
+            for (int i = worker->state_remap_capacity; i < local_state_count; ++i)
+                worker->state_remap[i] = -1;
+            worker->state_remap_capacity = local_state_count;
+        }
+    }
+
+    for (int i = 0; i < batch->line_count; ++i) {
+        struct expansion_worker *worker = &workers[batch->line_workers[i]];
+        struct expanded_line *expanded_line = &batch->expanded_lines[i];
+        long deltas_before = get_total_deltas_count(program);
+        int states_before = program->states.count;
+        if (check_merged_deltas(program, batch->first_line_num + i, expanded_line->deltas_count) == -1)
+            return -1;
+        if (reserve_deltas(program, expanded_line->deltas_count) == -1)
+            return -1;
+
+        for (int d = 0; d < expanded_line->deltas_count; ++d) {
+            struct deltas *local_delta = &worker->program->deltas[expanded_line->first_delta + d];
+            int state = merge_state(program, worker, local_delta->state, expanded_line->state_substituted);
+            int subsequent_state = state != -1 ? merge_state(program, worker, local_delta->subsequent_state, expanded_line->subsequent_state_substituted) : -1;
+            struct deltas *delta = subsequent_state != -1 ? add_delta(program) : NULL;
+            if (delta == NULL)
+                return -1;
+            *delta = *local_delta;
+            delta->state = state;
+            delta->subsequent_state = subsequent_state;
+        }
+        if (check_state_limit(program, batch->first_line_num + i, states_before) == -1
+            || record_line_stats(program, batch->first_line_num + i, deltas_before, states_before) == -1)
+            return -1;
+    }
+
+    // the local deltas are merged, the worker delta arrays can be reused for the next batch
+    for (int w = 0; w < thread_count; ++w)
+        workers[w].program->deltas_count = 0;
+    return 0;
+}
+
+/*
+ * Expand the delta lines with several threads. The lines are read in batches, each line is expanded
+ * by one of the workers into its private delta array, then the batch is merged in line order.
+ * The result is identical to the sequential expansion. Returns the number of delta lines or -1 if a line is malformed.
+ */
+int parse_deltas_parallel(struct program *program, struct line_reader *reader, int thread_count) {
+    struct expansion_batch batch;
+    struct expansion_worker *workers = calloc(thread_count, sizeof(struct expansion_worker));
+    // copies of the lines, only needed if the lines are streamed and not mapped
+    struct arena line_arena;
+    struct slice line;
+    int line_count = 0;
+
+    batch.lines = malloc(BATCH_LINE_COUNT * sizeof(struct slice));
+    batch.expanded_lines = malloc(BATCH_LINE_COUNT * sizeof(struct expanded_line));
+    batch.line_workers = malloc(BATCH_LINE_COUNT * sizeof(int));
+    arena_init(&line_arena, 1 << 20);
+
+    int allocated = workers != NULL && batch.lines != NULL && batch.expanded_lines != NULL && batch.line_workers != NULL;
+    for (int w = 0; allocated && w < thread_count; ++w) {
+        workers[w].index = w;
+        workers[w].program = create_worker_program(program);
+        workers[w].batch = &batch;
+        allocated = workers[w].program != NULL;
+    }
+    if (!allocated) {
+        program->line_num = 0;
+        line_count = set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the expansion threads!");
+    }
+
+    while (allocated) {
+        // read the next batch of lines
+        batch.line_count = 0;
+        batch.first_line_num = line_count;
+        arena_reset(&line_arena, (struct arena_mark) {NULL, 0});
+        int copied = 1;
+        while (batch.line_count < BATCH_LINE_COUNT && line_reader_next(reader, &line)) {
+            if (reader->map == NULL && (line.ptr = arena_strndup(&line_arena, line.ptr, line.len)) == NULL) {
+                copied = 0;
+                break;
+            }
+            batch.lines[batch.line_count++] = line;
+        }
+        if (!copied) {
+            program->line_num = program->first_delta_line + line_count + batch.line_count;
+            line_count = set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the delta line!");
+            break;
+        }
+        if (batch.line_count == 0)
+            break;
+        line_count += batch.line_count;
+
+        atomic_store(&batch.next_line, 0);
+        atomic_store(&batch.failed, 0);
+        int started_count = 0;
+        while (started_count < thread_count && pthread_create(&workers[started_count].thread, NULL, run_expansion_worker, &workers[started_count]) == 0)
+            ++started_count;
+        for (int w = 0; w < started_count; ++w)
+            pthread_join(workers[w].thread, NULL);
+
+        if (started_count < thread_count) {
+            program->line_num = 0;
+            line_count = set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Could not create expansion thread!");
+            break;
+        }
+        if (atomic_load(&batch.failed)) {
+            line_count = take_worker_error(program, workers, thread_count);
+            break;
+        }
+        if (merge_batch(program, workers, thread_count, &batch) == -1) {
+            line_count = -1;
+            break;
+        }
+    }
+
+    for (int w = 0; workers != NULL && w < thread_count; ++w) {
+        if (workers[w].program != NULL)
+            add_worker_allocations(program, workers[w].program);
+        free_worker_program(workers[w].program);
+        free(workers[w].state_remap);
+    }
+    free(workers);
+    free(batch.lines);
+    free(batch.expanded_lines);
+    free(batch.line_workers);
+    arena_free(&line_arena);
+
+    return line_count;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "program_helper.h"
+
+int parse_deltas_parallel(struct program *program, struct line_reader *reader, int thread_count);
+
+struct program *create_worker_program(struct program *program);
+
+void free_worker_program(struct program *worker_program);
@@ -1,230 +1,524 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "parser.h"
+#include "binary_format.h"
 #include "program_helper.h"
+#include "writer.h"
+#include "parallel_expansion.h"
+#include "incremental.h"
+#include "simulator.h"
+
+// Number of deltas which are collected before they are written to the delta sink
+#define STREAM_BATCH_SIZE 4096
+
+/*
+ * Record an error of the compilation at the line which is currently parsed. Only the first error is kept.
+ * position points into the line and gives the column of the error, NULL if the error concerns the whole line.
+ * Returns -1, so a failing function can return the result directly.
+ */
+int set_compile_error(struct program *program, enum compile_error_code code, const char *position, const char *format, ...) {
+    if (program->error.code != COMPILE_OK)
+        return -1;
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(program->error.message, COMPILE_ERROR_SIZE, format, arguments);
+    va_end(arguments);
+    program->error.code = code;
+    program->error.line = program->line_num;
+    program->error.column = position != NULL && program->line_num > 0 ? (int) (position - program->line_start) + 1 : 0;
+    return -1;
+}
+
+/*
+ * Get a short name of an error code.
+ */
+const char *get_compile_error_name(enum compile_error_code code) {
+    static const char *names[] = {"ok", "syntax error", "incomplete program", "undefined symbol", "duplicate definition",
+                                  "macro mismatch", "limit exceeded", "i/o error", "corrupt program", "out of resources",
+                                  "aborted by sink", "nondeterministic program"};
+    if (code < 0 || code >= (int) (sizeof(names) / sizeof(names[0])))
+        return "unknown error";
+    return names[code];
+}
+
+/*
+ * Count a heap allocation of the growing arrays of the program.
+ */
+static void count_heap_allocation(struct program *program, size_t bytes) {
+    ++program->allocations.heap_count;
+    program->allocations.heap_bytes += bytes;
+}
+
+/*
+ * Add the allocations of an arena to the statistics.
+ */
+static void add_arena_allocations(struct allocation_stats *stats, struct arena *arena) {
+    stats->heap_count += arena->block_count;
+    stats->heap_bytes += arena->block_bytes;
+    stats->arena_count += arena->alloc_count;
+    stats->arena_bytes += arena->alloc_bytes;
+}
 
 /*
- * Get the line count of a file.
+ * Add the allocations of an intern table to the statistics.
  */
-int get_file_line_count(FILE *file_ptr) {
-    char *line = NULL;
-    size_t buffer_size = 0;
-    int line_count = 0;
-    //count lines and reset to beginning of file
-    while (getline(&line, &buffer_size, file_ptr) != -1) {
-        ++line_count;
+static void add_intern_allocations(struct allocation_stats *stats, struct intern_table *table) {
+    stats->heap_count += table->allocation_count;
+    stats->heap_bytes += table->allocated_bytes;
+}
+
+/*
+ * Get the allocations of the compilation so far: the arrays of the program, its arenas and intern tables and the
+ * private programs of the expansion workers.
+ */
+void get_allocation_stats(struct program *program, struct allocation_stats *stats) {
+    *stats = program->allocations;
+    add_arena_allocations(stats, &program->arena);
+    add_arena_allocations(stats, &program->scratch);
+    add_intern_allocations(stats, &program->states);
+    add_intern_allocations(stats, &program->alphabet);
+    add_intern_allocations(stats, &program->symbol_set_names);
+}
+
+/*
+ * Add the allocations of the private program of a worker to the program before the worker program is freed.
+ * The alphabet and symbol sets of the worker are shared with the program and not counted twice.
+ */
+void add_worker_allocations(struct program *program, struct program *worker_program) {
+    struct allocation_stats *stats = &program->allocations;
+    stats->heap_count += worker_program->allocations.heap_count;
+    stats->heap_bytes += worker_program->allocations.heap_bytes;
+    add_arena_allocations(stats, &worker_program->arena);
+    add_arena_allocations(stats, &worker_program->scratch);
+    add_intern_allocations(stats, &worker_program->states);
+}
+
+/*
+ * Get the number of deltas generated so far, including the deltas which were written to the delta sink.
+ */
+long get_total_deltas_count(struct program *program) {
+    return program->deltas_count + program->streamed_deltas_count;
+}
+
+/*
+ * Record the expansion of a delta line: the line of its deltas if they are recorded and the line statistics if
+ * they are collected. deltas_before and states_before are the number of deltas and states before the line was
+ * expanded or merged into the program. Returns -1 if the statistics can not grow.
+ */
+int record_line_stats(struct program *program, int line_num, long deltas_before, int states_before) {
+    // the lines are not recorded for streamed deltas, the delta array of a delta sink is not grown by reserve_deltas
+    if (program->delta_lines != NULL) {
+        for (long i = deltas_before; i < program->deltas_count; ++i)
+            program->delta_lines[i] = program->first_delta_line + line_num;
     }
-    fseek(file_ptr, 0, 0);
-    return line_count;
+    if (!program->options.collect_stats)
+        return 0;
+    if (program->line_stats_count == program->line_stats_capacity) {
+        int capacity = program->line_stats_capacity > 0 ? program->line_stats_capacity * 2 : 1024;
+        struct line_stats *line_stats = realloc(program->line_stats, capacity * sizeof(struct line_stats));
+        if (line_stats == NULL) {
+            program->line_num = program->first_delta_line + line_num;
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the statistics of %d lines!", capacity);
+        }
+        program->line_stats = line_stats;
+        program->line_stats_capacity = capacity;
+        count_heap_allocation(program, capacity * sizeof(struct line_stats));
+    }
+    struct line_stats *stats = &program->line_stats[program->line_stats_count++];
+    stats->line = program->first_delta_line + line_num;
+    stats->deltas_count = get_total_deltas_count(program) - deltas_before;
+    stats->new_states_count = program->states.count - states_before;
+    return 0;
 }
 
 /*
- * Parse state names and store it in the struct.
- * Sets start, halt and reject states.
+ * Add a state to the listed states of the compiled program if it is not yet listed.
+ * Returns -1 if the listed states can not grow, then they are unchanged.
  */
-void parse_states(struct program *program, char *line, size_t line_length) {
-    // check that at least one alphabet is present and that a program follows
-    if (line_length < 4 || line[0] != 'S' || line[line_length-1] != '\n'){
-        exit(-1);
+int list_state(struct program *program, int state_index) {
+    if (state_index >= program->listed_capacity) {
+        // a state index is at most INTERN_MAX_COUNT, so the capacity does not overflow
+        int new_capacity = program->listed_capacity > 0 ? program->listed_capacity * 2 : 64;
+        while (new_capacity <= state_index)
+            new_capacity *= 2;
+        int *listed_states = realloc(program->listed_states, new_capacity * sizeof(int));
+        if (listed_states != NULL)
+            program->listed_states = listed_states;
+        char *state_is_listed = realloc(program->state_is_listed, new_capacity * sizeof(char));
+        if (state_is_listed != NULL)
+            program->state_is_listed = state_is_listed;
+        if (listed_states == NULL || state_is_listed == NULL)
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory to list %d states!", new_capacity);
+        count_heap_allocation(program, new_capacity * sizeof(int));
+        count_heap_allocation(program, new_capacity * sizeof(char));
+        memset(program->state_is_listed + program->listed_capacity, 0, new_capacity - program->listed_capacity);
+        program->listed_capacity = new_capacity;
     }
-    // check some formatting
-    if (line_length < 4 || line[0] != 'S') {
-        printf("Wrong format for states!\n");
-        exit(-1);
+    if (!program->state_is_listed[state_index]) {
+        program->state_is_listed[state_index] = 1;
+        program->listed_states[program->listed_state_count++] = state_index;
     }
+    return 0;
+}
 
-    // exclude G: and \n
-    line_length -= 4;
-    // skip "S: "
-    line += 3;
+/*
+ * Intern a state name. Returns the index of the state or -1 if there is not enough memory for it.
+ */
+static int intern_state(struct program *program, const char *state, size_t state_len) {
+    int state_index = intern_string(&program->states, state, state_len);
+    if (state_index == -1)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the state %.*s!", (int) state_len, state);
+    return state_index;
+}
 
-    // count number of states
-    program->state_count = 1;
-    for (int i = 0; i < line_length; ++i) {
-        if (line[i] == ',')
-            ++program->state_count;
+/*
+ * This function checks if a state name is contained in the state name list and adds it if not.
+ * Returns the index of the state in the state name list or -1 if there is not enough memory for it.
+ */
+int add_state_to_program(struct program *program, const char *state, size_t state_len) {
+    int state_index = intern_state(program, state, state_len);
+    if (state_index == -1 || list_state(program, state_index) == -1)
+        return -1;
+    return state_index;
+}
+
+/*
+ * Count all symbols in a line, which are seperated by a seperator char
+ */
+int get_element_count(struct slice line, char seperator) {
+    int count = 1;
+    for (size_t i = 0; i < line.len; ++i) {
+        if (line.ptr[i] == seperator)
+            ++count;
     }
+    return count;
+}
 
-    program->state_names = malloc(program->state_count * sizeof(char*));
+/*
+ * Parse state names and store it in the struct.
+ * Sets start, halt and reject states. Returns -1 if the line is malformed.
+ */
+int parse_states(struct program *program, struct slice line) {
+    // check some formatting and that a program follows
+    if (line.len < 4 || line.ptr[0] != 'S' || line.ptr[line.len-1] != '\n')
+        return set_compile_error(program, COMPILE_ERROR_SYNTAX, line.ptr, "Wrong format for states!");
 
-    // remove newline '\n' at end of line
-    line[line_length] = '\0';
+    // exclude S: and \n
+    line.len -= 4;
+    // skip "S: "
+    line.ptr += 3;
+
+    // count number of states
+    int state_count = get_element_count(line, ',');
 
-    for (int current_state = 0; current_state < program->state_count; ++current_state){
-        program->state_names[current_state] = strdup(strsep(&line, ","));
+    if (intern_table_reset(&program->states, state_count, &program->arena) == -1)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for %d states!", state_count);
+
+    for (int current_state = 0; current_state < state_count; ++current_state){
+        struct slice state = next_field(&line, ',');
+        if (add_state_to_program(program, state.ptr, state.len) == -1)
+            return -1;
     }
+    return 0;
 }
 
 /*
  * Parse alphabet part of the program file. Add its parts to the program struct.
+ * Returns -1 if the line is malformed.
  */
-void parse_alphabet(struct program *program, char *line, size_t line_length) {
+int parse_alphabet(struct program *program, struct slice line) {
     // check that at least one alphabet is present and that a program follows
-    if (line_length < 4 || line[0] != 'G' || line[line_length-1] != '\n'){
-        exit(-1);
-    }
+    if (line.len < 4 || line.ptr[0] != 'G' || line.ptr[line.len-1] != '\n')
+        return set_compile_error(program, COMPILE_ERROR_SYNTAX, line.ptr, "Wrong format for alphabet!");
     // exclude G: and \n
-    line_length -= 4;
+    line.len -= 4;
     // skip "G: "
-    line += 3;
+    line.ptr += 3;
 
     // get the number of alphabet symbols
-    program->alphabet_size = 1;
-    for (int i = 0; i < line_length; ++i) {
-        if (line[i] == ',')
-            ++program->alphabet_size;
-    }
+    int alphabet_size = get_element_count(line, ',');
+
+    if (alphabet_size > MAX_ALPHABET_SIZE)
+        return set_compile_error(program, COMPILE_ERROR_LIMIT, NULL, "Alphabet contains more than %d symbols!", MAX_ALPHABET_SIZE);
 
-    program->alphabet = malloc(program->alphabet_size * sizeof(char*));
-    program->alphabet_indexes = malloc(program->alphabet_size * sizeof(char*));
+    program->alphabet_indexes = arena_alloc(&program->arena, alphabet_size * sizeof(int));
+    if (intern_table_reset(&program->alphabet, alphabet_size, &program->arena) == -1 || program->alphabet_indexes == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for %d alphabet symbols!", alphabet_size);
 
-    // get the length of the individual alphabet symbols and put them then in a list
-    line[line_length] = '\0';
-    for (int current_element = 0; current_element < program->alphabet_size; ++current_element){
+    // get the individual alphabet symbols and put them then in a list
+    for (int current_element = 0; current_element < alphabet_size; ++current_element){
         // add symbol to the list
-        program->alphabet[current_element] = strdup(strsep(&line, ","));
+        struct slice symbol = next_field(&line, ',');
+        // "$name" in a macro is a symbol set, so a symbol must not look like one
+        if (symbol.len > 0 && symbol.ptr[0] == '$')
+            return set_compile_error(program, COMPILE_ERROR_SYNTAX, symbol.ptr, "Alphabet symbol %.*s starts with $, which marks a symbol set!",
+                                     (int) symbol.len, symbol.ptr);
+        if (intern_string(&program->alphabet, symbol.ptr, symbol.len) == -1)
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the alphabet symbol %.*s!", (int) symbol.len, symbol.ptr);
         program->alphabet_indexes[current_element] = current_element;
     }
+
+    if (intern_table_reset(&program->symbol_set_names, 8, &program->arena) == -1)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the symbol sets!");
+    return 0;
 }
 
 /*
- * Get index of matching state name of first substring in the line.
+ * Get index of matching state name of first substring in the line. Returns -1 if the element is not defined.
  */
-int search_matching_element(char **line, char **elements, int element_count) {
-    char *tmp_str = strsep(line, "|");
-    int found_match = -1;
-    int matched_index;
-    // compare substring with the list of elements and get the index if found
-    for (matched_index = 0; matched_index < element_count; ++matched_index) {
-        if(strcmp(tmp_str, elements[matched_index]) == 0) {
-            found_match = 0;
-            break;
-        }
+int search_matching_element(struct program *program, struct slice *line, struct intern_table *elements) {
+    struct slice tmp_str = next_field(line, '|');
+    // look up the substring in the interned elements and get the index if found
+    int matched_index = intern_find(elements, tmp_str.ptr, tmp_str.len);
+    if (matched_index == -1)
+        return set_compile_error(program, COMPILE_ERROR_UNDEFINED, tmp_str.ptr, "Program delta contains state or tape symbol which is not contained in the defined!\nItem is: %.*s", (int) tmp_str.len, tmp_str.ptr);
+    return matched_index;
+}
+
+/*
+ * Get the named symbol set of a "$name" reference. Returns NULL if the set is not defined.
+ */
+struct symbol_set *get_named_symbol_set(struct program *program, struct slice name) {
+    int set_index = intern_find(&program->symbol_set_names, name.ptr, name.len);
+    if (set_index == -1) {
+        set_compile_error(program, COMPILE_ERROR_UNDEFINED, name.ptr - 1, "Symbol set $%.*s is not defined!", (int) name.len, name.ptr);
+        return NULL;
     }
-    if (found_match == -1) {
-        printf("Program delta contains state or tape symbol which is not contained in the defined!\n");
-        printf("Item is: %s\n", tmp_str);
-        exit(-1);
+    return &program->symbol_sets[set_index];
+}
+
+/*
+ * Check if a char is an operator of a symbol set expression: '+' union, '&' intersection, '-' difference.
+ */
+int is_symbol_set_operator(char c) {
+    return c == '+' || c == '&' || c == '-';
+}
+
+/*
+ * Parse one operand of a symbol set expression and move expression behind it.
+ * An operand is '*' for all symbols, '$name' for a named symbol set or a list of symbols and named sets like '(a|b|$name)'.
+ * Returns -1 if the operand is malformed.
+ */
+int parse_symbol_set_operand(struct program *program, struct slice *expression, struct symbol_set *operand) {
+    symbol_set_init(operand, program->alphabet.count, &program->scratch);
+
+    if (expression->len > 0 && expression->ptr[0] == '*') {
+        symbol_set_fill(operand, program->alphabet.count);
+        ++expression->ptr;
+        --expression->len;
+    } else if (expression->len > 0 && expression->ptr[0] == '$') {
+        size_t name_len = 1;
+        while (name_len < expression->len && !is_symbol_set_operator(expression->ptr[name_len]))
+            ++name_len;
+        struct slice name = {expression->ptr + 1, name_len - 1};
+        struct symbol_set *named_set = get_named_symbol_set(program, name);
+        if (named_set == NULL)
+            return -1;
+        symbol_set_copy(operand, named_set);
+        expression->ptr += name_len;
+        expression->len -= name_len;
+    } else if (expression->len > 0 && expression->ptr[0] == '(') {
+        // the list ends at the ')' which is followed by an operator or the end of the expression
+        size_t list_end = 1;
+        while (list_end < expression->len && !(expression->ptr[list_end] == ')' && (list_end + 1 == expression->len || is_symbol_set_operator(expression->ptr[list_end + 1]))))
+            ++list_end;
+        if (list_end == expression->len)
+            return set_compile_error(program, COMPILE_ERROR_SYNTAX, expression->ptr, "Malformed Wildcard!");
+        struct slice list = {expression->ptr + 1, list_end - 1};
+        while (list.ptr != NULL) {
+            if (list.len > 0 && list.ptr[0] == '$') {
+                struct slice name = next_field(&list, '|');
+                ++name.ptr;
+                --name.len;
+                struct symbol_set *named_set = get_named_symbol_set(program, name);
+                if (named_set == NULL)
+                    return -1;
+                symbol_set_union(operand, named_set);
+            } else {
+                int symbol = search_matching_element(program, &list, &program->alphabet);
+                if (symbol == -1)
+                    return -1;
+                symbol_set_add(operand, symbol);
+            }
+        }
+        expression->ptr += list_end + 1;
+        expression->len -= list_end + 1;
+    } else {
+        return set_compile_error(program, COMPILE_ERROR_SYNTAX, expression->ptr, "Malformed Wildcard!");
     }
-    return matched_index;
+    return 0;
 }
 
 /*
- * Count all symbols in a line, which are seperated by a seperator char
+ * Evaluate a symbol set expression like '*-(a|b)', '$digits+$letters' or '$letters&$vowels'.
+ * The operators are applied from left to right. Returns -1 if the expression is malformed.
  */
-int get_element_count(char *line, char seperator) {
-    int count = 1;
-    while (*line != '\0') {
-        if (*line == seperator)
-            ++count;
-        ++line;
+int evaluate_symbol_set(struct program *program, struct slice expression, struct symbol_set *result) {
+    struct symbol_set operand;
+    if (parse_symbol_set_operand(program, &expression, result) == -1)
+        return -1;
+    while (expression.len > 0) {
+        char operator = expression.ptr[0];
+        if (!is_symbol_set_operator(operator))
+            return set_compile_error(program, COMPILE_ERROR_SYNTAX, expression.ptr, "Malformed Wildcard!");
+        ++expression.ptr;
+        --expression.len;
+        if (parse_symbol_set_operand(program, &expression, &operand) == -1)
+            return -1;
+        if (operator == '+')
+            symbol_set_union(result, &operand);
+        else if (operator == '&')
+            symbol_set_intersect(result, &operand);
+        else
+            symbol_set_subtract(result, &operand);
     }
-    return count;
+    return 0;
 }
 
 /*
- * This function handles read and write makros with a '*' Wildcard.
+ * This function handles read and write makros with a '*' Wildcard or named symbol sets.
  * If just '*' is used, insert all alphabet symbols.
  * If *-(...) is used, insert all alphabet symbols minus the listed ones.
+ * Named symbol sets can be combined with '+' (union), '&' (intersection) and '-' (difference), e.g. [$digits+$letters].
+ * The symbols are inserted in the order of the alphabet. Returns -1 if the macro is malformed.
  */
-void handle_wildcard_symbol(struct program *program, struct alphabet_symbols *alphabet_symbols, char *symbols, int symbols_len) {
-    if (symbols_len == 3) {
-        alphabet_symbols->symbol_count = program->alphabet_size;
+int handle_wildcard_symbol(struct program *program, struct alphabet_symbols *alphabet_symbols, struct slice symbols) {
+    if (symbols.len == 3 && symbols.ptr[1] == '*') {
+        alphabet_symbols->symbol_count = program->alphabet.count;
         alphabet_symbols->symbols = program->alphabet_indexes;
-        return;
+        return 0;
     }
 
-    if (strncmp(symbols+1, "*-(", 3) != 0 || symbols[symbols_len - 2] != ')') {
-        printf("Malformed Wildcard!");
-        exit(-1);
-    }
+    // remove the parentheses
+    symbols.ptr += 1;
+    symbols.len -= 2;
 
-    // remove first parenthesis and "*-(", and last 2 parentheses
-    symbols[symbols_len-2] = '\0';
-    symbols += 4;
-    symbols_len -= 6;
-    
-    int excluded_symbols_count = get_element_count(symbols, '|');
-    int *excluded_symbols = malloc(excluded_symbols_count * sizeof(int));
-    alphabet_symbols->symbol_count = program->alphabet_size - excluded_symbols_count;
-    alphabet_symbols->symbols = malloc(alphabet_symbols->symbol_count * sizeof(int));
+    struct symbol_set symbol_set;
+    if (evaluate_symbol_set(program, symbols, &symbol_set) == -1)
+        return -1;
+    alphabet_symbols->symbols = arena_alloc(&program->scratch, symbol_set_count(&symbol_set) * sizeof(int));
+    alphabet_symbols->symbol_count = symbol_set_to_indexes(&symbol_set, alphabet_symbols->symbols);
+    return 0;
+}
 
-    for (int i = 0; i < excluded_symbols_count; ++i) {
-        excluded_symbols[i] = search_matching_element(&symbols, program->alphabet, program->alphabet_size);
-    }
+/*
+ * Parse the definition of a named symbol set in a line like "N: name=a|b|c" or "N: name=$other-(a)".
+ * Returns -1 if the definition is malformed.
+ */
+int parse_symbol_set_definition(struct program *program, struct slice line) {
+    if (line.len < 4 || line.ptr[0] != 'N' || line.ptr[1] != ':')
+        return set_compile_error(program, COMPILE_ERROR_SYNTAX, line.ptr, "Wrong format for symbol set definition!");
+    // skip "N: " and remove '\n'
+    line.ptr += 3;
+    line.len -= 3;
+    if (line.len > 0 && line.ptr[line.len - 1] == '\n')
+        --line.len;
 
-    int is_excluded = 0;
-    int index_counter = 0;
-    for (int i = 0; i < program->alphabet_size; ++i) {
-        // check if current alphabet symbol is in the excluded list and skip it
-        for (int j = 0; j < excluded_symbols_count; ++j) {
-            if (excluded_symbols[j] == i) {
-                is_excluded = 1;
-                break;
-            }
+    struct slice name = next_field(&line, '=');
+    if (line.ptr == NULL || name.len == 0)
+        return set_compile_error(program, COMPILE_ERROR_SYNTAX, name.ptr, "Wrong format for symbol set definition!");
+    if (intern_find(&program->symbol_set_names, name.ptr, name.len) != -1)
+        return set_compile_error(program, COMPILE_ERROR_DUPLICATE, name.ptr, "Symbol set %.*s is defined twice!", (int) name.len, name.ptr);
+
+    // evaluate in the scratch arena and copy the result into the program arena, where it is kept for the whole program
+    struct symbol_set symbol_set;
+    if (line.len > 0 && (line.ptr[0] == '*' || line.ptr[0] == '$' || line.ptr[0] == '(')) {
+        if (evaluate_symbol_set(program, line, &symbol_set) == -1)
+            return -1;
+    } else {
+        symbol_set_init(&symbol_set, program->alphabet.count, &program->scratch);
+        while (line.ptr != NULL) {
+            int symbol = search_matching_element(program, &line, &program->alphabet);
+            if (symbol == -1)
+                return -1;
+            symbol_set_add(&symbol_set, symbol);
         }
-        if (is_excluded == 0)
-            alphabet_symbols->symbols[index_counter++] = i;
-        else
-            is_excluded = 0;
     }
 
-    free(excluded_symbols);
+    // the set is only interned once its array has space, so names and sets stay in step
+    int set_count = program->symbol_set_names.count + 1;
+    struct symbol_set *symbol_sets = realloc(program->symbol_sets, set_count * sizeof(struct symbol_set));
+    if (symbol_sets == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, name.ptr, "Not enough memory for the symbol set %.*s!", (int) name.len, name.ptr);
+    program->symbol_sets = symbol_sets;
+    count_heap_allocation(program, set_count * sizeof(struct symbol_set));
+    int set_index = intern_string(&program->symbol_set_names, name.ptr, name.len);
+    if (set_index == -1)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, name.ptr, "Not enough memory for the symbol set %.*s!", (int) name.len, name.ptr);
+    symbol_set_init(&program->symbol_sets[set_index], program->alphabet.count, &program->arena);
+    symbol_set_copy(&program->symbol_sets[set_index], &symbol_set);
+    arena_clear(&program->scratch);
+    return 0;
+}
+
+/*
+ * Check if a read or write macro is a symbol set expression, which starts with an operand like '*', '$name' or
+ * '(a|b)', instead of a list of symbols.
+ */
+static int is_symbol_set_macro(struct slice symbols) {
+    return symbols.len >= 2 && (symbols.ptr[1] == '*' || symbols.ptr[1] == '$' || symbols.ptr[1] == '(');
 }
 
 /*
  * Create a alphabet symbol helper struct.
  * The symbols contain a read/write symbol or a listing of those.
  * The helper struct contains how many and which symbols are used and if they should be matched 1 to 1 or 1 to n or None
+ * Without resolve, the symbols of a list are only counted and not looked up, symbols is NULL then. Wildcards and
+ * symbol sets are always evaluated, since their count depends on the alphabet.
+ * Returns NULL if the symbols are malformed.
  */
-struct alphabet_symbols *get_alphabet_symbols(struct program *program, char *symbols) {
-    struct alphabet_symbols *alphabet_symbols = malloc(sizeof(struct alphabet_symbols));
-    int symbols_len = strlen(symbols);
+struct alphabet_symbols *get_alphabet_symbols(struct program *program, struct slice symbols, int resolve) {
+    struct alphabet_symbols *alphabet_symbols = arena_alloc(&program->scratch, sizeof(struct alphabet_symbols));
 
-     if (symbols[0] == '[') {
-        if (symbols[symbols_len - 1] != ']') {
-            printf("Malformed delta, ] ist missing!\n");
-            printf("Line: %s\n", symbols);
-            exit(-1);
+     if (symbols.len > 0 && symbols.ptr[0] == '[') {
+        if (symbols.ptr[symbols.len - 1] != ']') {
+            set_compile_error(program, COMPILE_ERROR_SYNTAX, symbols.ptr, "Malformed delta, ] ist missing!\nLine: %.*s", (int) symbols.len, symbols.ptr);
+            return NULL;
         }
 
         alphabet_symbols->type = '1';
 
-        // check if "[*] wildcard is used, then use all alphabet symbols
-        if (strncmp(symbols, "[*", 2) == 0) {
-            handle_wildcard_symbol(program, alphabet_symbols, symbols, symbols_len);
-            return alphabet_symbols;
-        }
+        // check if "[*] wildcard, a named symbol set or a list operand of a symbol set expression is used
+        if (is_symbol_set_macro(symbols))
+            return handle_wildcard_symbol(program, alphabet_symbols, symbols) == -1 ? NULL : alphabet_symbols;
 
-        // remove '[' and ']' from the string to parse the different alphabet symbols later
-        symbols[symbols_len - 1] = '\0';
-        ++symbols;
-    } else if (symbols[0] == '{') {
-        if (symbols[symbols_len - 1] != '}') {
-            printf("Malformed delta, } is missing!");
-            printf("Line: %s\n", symbols);
-            exit(-1);
+        // remove '[' and ']' from the slice to parse the different alphabet symbols later
+        ++symbols.ptr;
+        symbols.len -= 2;
+    } else if (symbols.len > 0 && symbols.ptr[0] == '{') {
+        if (symbols.ptr[symbols.len - 1] != '}') {
+            set_compile_error(program, COMPILE_ERROR_SYNTAX, symbols.ptr, "Malformed delta, } is missing!\nLine: %.*s", (int) symbols.len, symbols.ptr);
+            return NULL;
         }
 
         alphabet_symbols->type = 'n';
 
-        // check if "{*} wildcard is used, then use all alphabet symbols
-         if (strncmp(symbols, "{*", 2) == 0) {
-             handle_wildcard_symbol(program, alphabet_symbols, symbols, symbols_len);
-             return alphabet_symbols;
-         }
+        // check if "{*} wildcard, a named symbol set or a list operand of a symbol set expression is used
+        if (is_symbol_set_macro(symbols))
+            return handle_wildcard_symbol(program, alphabet_symbols, symbols) == -1 ? NULL : alphabet_symbols;
 
-        // remove '{' and '}' from the string to parse later
-        symbols[symbols_len - 1] = '\0';
-        ++symbols;
+        // remove '{' and '}' from the slice to parse later
+        ++symbols.ptr;
+        symbols.len -= 2;
     } else {
         alphabet_symbols->type = '0';
     }
     alphabet_symbols->symbol_count = get_element_count(symbols, '|');
-    alphabet_symbols->symbols = malloc(alphabet_symbols->symbol_count * sizeof(int));
+    if (!resolve) {
+        alphabet_symbols->symbols = NULL;
+        return alphabet_symbols;
+    }
+    alphabet_symbols->symbols = arena_alloc(&program->scratch, alphabet_symbols->symbol_count * sizeof(int));
     for (int i = 0; i < alphabet_symbols->symbol_count; ++i) {
-        alphabet_symbols->symbols[i] = search_matching_element(&symbols, program->alphabet, program->alphabet_size);
+        alphabet_symbols->symbols[i] = search_matching_element(program, &symbols, &program->alphabet);
+        if (alphabet_symbols->symbols[i] == -1)
+            return NULL;
     }
 
     return alphabet_symbols;
@@ -235,15 +529,19 @@ struct alphabet_symbols *get_alphabet_symbols(struct program *program, char *sym
  * Since a state name can have a part substituted by a read or write symbol it needs to be parsed.
  * The Struct contains the prefix, postfix and if a read or write symbol or no symbol should be placed between pre/postfix.
  */
-struct state_helper *get_state_helper(char* state) {
-    struct state_helper *state_helper = malloc(sizeof(struct state_helper));
-    int state_len = strlen(state);
-    for (int i = 0; i < state_len; ++i) {
+struct state_helper *get_state_helper(struct program *program, struct slice state) {
+    struct state_helper *state_helper = arena_alloc(&program->scratch, sizeof(struct state_helper));
+    state_helper->state_index = -1;
+    for (size_t i = 0; i + 2 < state.len; ++i) {
         // check if a read/write symbol should be substituted
-        if (state[i] == '(' && state[i + 1] == '*' && (state[i + 2] == 'r' || state[i + 2] == 'w')) {
-            state_helper->substitution_type = state[i + 2];
-            state_helper->state_prefix = strndup(state, i);
-            state_helper->state_postfix = strndup(state + i + 4, state_len - ( i + 3));
+        if (state.ptr[i] == '(' && state.ptr[i + 1] == '*' && (state.ptr[i + 2] == 'r' || state.ptr[i + 2] == 'w')) {
+            state_helper->substitution_type = state.ptr[i + 2];
+            state_helper->state_prefix.ptr = state.ptr;
+            state_helper->state_prefix.len = i;
+            // skip "(*r)" or "(*w)"
+            size_t postfix_start = i + 4 < state.len ? i + 4 : state.len;
+            state_helper->state_postfix.ptr = state.ptr + postfix_start;
+            state_helper->state_postfix.len = state.len - postfix_start;
             return state_helper;
         }
     }
@@ -254,255 +552,999 @@ struct state_helper *get_state_helper(char* state) {
 }
 
 /*
- * This function checks if a state name is contained in the state name list and adds it if not.
+ * This function creates the state name with a state helper struct and the read/write symbols.
+ * Returns the index of the state name or -1 if there is not enough memory for it.
  */
-void add_state_to_program(struct program *program, char *state) {
-    // check if state is yet contained
-    for (int i = 0; i < program->state_count; ++i) {
-        if (strcmp(program->state_names[i], state) == 0)
-            return;
+int generate_state_str(struct program *program, struct state_helper *state_helper, int read_symbol, int write_symbol){
+    if (state_helper->substitution_type == '0') {
+        // same state for all deltas of the line, look it up only once
+        // unsubstituted states are not added to the listed states, they have to be declared in the state line
+        if (state_helper->state_index == -1)
+            state_helper->state_index = intern_state(program, state_helper->state_prefix.ptr, state_helper->state_prefix.len);
+        return state_helper->state_index;
     }
-    ++program->state_count;
-    program->state_names = realloc(program->state_names, program->state_count * sizeof(struct deltas*));
-    program->state_names[program->state_count - 1] = state;
-}
 
-/*
- * This function creates the state name with a state helper struct and the read/write symbols.
- */
-char *generate_state_str(struct program *program, struct state_helper *state_helper, int read_symbol, int write_symbol){
-    if (state_helper->substitution_type == '0')
-            return state_helper->state_prefix;
-    
-    char *state;
+    int state;
     int symbol;
-    int state_len = strlen(state_helper->state_prefix) + strlen(state_helper->state_postfix);
+    size_t prefix_len = state_helper->state_prefix.len;
+    size_t postfix_len = state_helper->state_postfix.len;
     if (state_helper->substitution_type == 'r')
         symbol = read_symbol;
     else
         symbol = write_symbol;
+    size_t symbol_len = program->alphabet.lengths[symbol];
+    size_t state_len = prefix_len + symbol_len + postfix_len;
 
-    state = calloc( state_len + strlen(program->alphabet[symbol]) + 1, sizeof(char));
-    strcat(state, state_helper->state_prefix);
-    strcat(state, program->alphabet[symbol]);
-    strcat(state, state_helper->state_postfix);
-    add_state_to_program(program, state);
+    // build the name in the scratch arena, only new names get copied into the state table
+    struct arena_mark mark = arena_get_mark(&program->scratch);
+    char *buffer = arena_alloc(&program->scratch, state_len + 1);
+    if (buffer == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for a state name of %zu characters!", state_len);
+    memcpy(buffer, state_helper->state_prefix.ptr, prefix_len);
+    memcpy(buffer + prefix_len, program->alphabet.names[symbol], symbol_len);
+    memcpy(buffer + prefix_len + symbol_len, state_helper->state_postfix.ptr, postfix_len);
+    buffer[state_len] = '\0';
+    state = add_state_to_program(program, buffer, state_len);
+    arena_reset(&program->scratch, mark);
     return state;
 }
 
 /*
- * This function generates deltas which have makros for read and write symbols
- * Example: read symbols: (a|b|c) write symbols: (x|y|) will generate deltas with: (a,x), (b,y), (c,z) as (read, write) symbols
- * number of read and write symbols have to be the same
+ * Make sure the delta array has space for additional deltas. The array grows geometrically.
+ * Returns -1 if there is not enough memory, then the arrays keep their old size and the error names the current line.
  */
-void generate_1t1_deltas(struct program *program, struct state_helper *state, struct state_helper *subsequent_state, struct alphabet_symbols *read_symbols, struct alphabet_symbols *write_symbols, char movement, int line_num) {
-    if (read_symbols->symbol_count != write_symbols->symbol_count) {
-        printf("Number of read symbols of delta number %d are not equal the number of write symbols!\n", line_num + 1);
-        printf("Read symbols: %d, write symbols: %d\n", read_symbols->symbol_count, write_symbols->symbol_count);
-        exit(-1);
+int reserve_deltas(struct program *program, long long additional_deltas) {
+    // when streaming, the array is a batch buffer of fixed size
+    if (program->delta_sink != NULL)
+        return 0;
+
+    long long needed_capacity = program->deltas_count + additional_deltas;
+    if (needed_capacity <= program->deltas_capacity)
+        return 0;
+
+    // the deltas are indexed with int, check_line_deltas makes sure that they fit
+    long long new_capacity = program->deltas_capacity > 0 ? program->deltas_capacity : 64;
+    while (new_capacity < needed_capacity)
+        new_capacity *= 2;
+    if (new_capacity > INT32_MAX)
+        new_capacity = INT32_MAX;
+    if (program->options.record_delta_lines) {
+        int *delta_lines = realloc(program->delta_lines, new_capacity * sizeof(int));
+        if (delta_lines == NULL)
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for %lld deltas!", needed_capacity);
+        program->delta_lines = delta_lines;
+        count_heap_allocation(program, new_capacity * sizeof(int));
     }
+    struct deltas *deltas = realloc(program->deltas, new_capacity * sizeof(struct deltas));
+    if (deltas == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for %lld deltas!", needed_capacity);
+    program->deltas = deltas;
+    program->deltas_capacity = new_capacity;
+    count_heap_allocation(program, new_capacity * sizeof(struct deltas));
+    return 0;
+}
 
-    // If array empty create new one, else reallocate more memory
-    if (program->deltas_count == 0) {
-        program->deltas = malloc(read_symbols->symbol_count * sizeof(struct deltas*));
-    } else {
-        program->deltas = realloc(program->deltas, (program->deltas_count + read_symbols->symbol_count) * sizeof(struct deltas*));
+/*
+ * Write all collected deltas to the delta sink and empty the delta array.
+ */
+void flush_streamed_deltas(struct program *program) {
+    for (int i = 0; i < program->deltas_count; ++i) {
+        writer_write_delta(program->delta_sink, program, &program->deltas[i]);
     }
+    program->streamed_deltas_count += program->deltas_count;
+    program->deltas_count = 0;
+}
 
+/*
+ * Append a new delta to the delta array. The pointer is valid until the next delta is added.
+ * Returns NULL if the array can not grow.
+ */
+struct deltas *add_delta(struct program *program) {
+    if (program->delta_sink != NULL && program->deltas_count == program->deltas_capacity)
+        flush_streamed_deltas(program);
+    if (reserve_deltas(program, 1) == -1)
+        return NULL;
+    return &program->deltas[program->deltas_count++];
+}
+
+/*
+ * Fill a generated delta, the states are created from the state helpers. Returns -1 if there is not enough
+ * memory for a state.
+ */
+static int set_generated_delta(struct program *program, struct deltas *delta, struct state_helper *state, struct state_helper *subsequent_state,
+                               int read_symbol, int write_symbol, char movement) {
+    int state_index = generate_state_str(program, state, read_symbol, write_symbol);
+    int subsequent_state_index = generate_state_str(program, subsequent_state, read_symbol, write_symbol);
+    if (state_index == -1 || subsequent_state_index == -1)
+        return -1;
+    delta->read_symbol = read_symbol;
+    delta->write_symbol = write_symbol;
+    delta->state = state_index;
+    delta->subsequent_state = subsequent_state_index;
+    delta->movement = movement;
+    return 0;
+}
+
+/*
+ * This function generates deltas which have makros for read and write symbols
+ * Example: read symbols: (a|b|c) write symbols: (x|y|) will generate deltas with: (a,x), (b,y), (c,z) as (read, write) symbols
+ * number of read and write symbols have to be the same
+ * Returns -1 if there is not enough memory for the deltas or their states.
+ */
+int generate_1t1_deltas(struct program *program, struct state_helper *state, struct state_helper *subsequent_state, struct alphabet_symbols *read_symbols, struct alphabet_symbols *write_symbols, char movement) {
     // create the different deltas and save them in the program struct
     for (int i = 0; i < read_symbols->symbol_count; ++i) {
-        struct deltas *delta = malloc(sizeof(struct deltas));
-        delta->read_symbol = read_symbols->symbols[i];
-        delta->write_symbol = write_symbols->symbols[i];
-        delta->state = generate_state_str(program, state, delta->read_symbol, delta->write_symbol);
-        delta->subsequent_state = generate_state_str(program, subsequent_state, delta->read_symbol, delta->write_symbol);
-        delta->movement = movement;
-        program->deltas[program->deltas_count + i] = delta;
+        struct deltas *delta = add_delta(program);
+        if (delta == NULL || set_generated_delta(program, delta, state, subsequent_state, read_symbols->symbols[i], write_symbols->symbols[i], movement) == -1)
+            return -1;
     }
-    program->deltas_count += read_symbols->symbol_count;
+    return 0;
 }
 
 /*
  * This function generates deltas which have makros for read and write symbols
  * Example: read symbols: (a|b|c) write symbols: (x|y) will generate deltas with: (a,x) (a,y), (b,x), (b,y), (c,x), (c,y) as (read, write) symbols
+ * Returns -1 if there is not enough memory for the deltas or their states.
  */
-void generate_1tn_deltas(struct program *program, struct state_helper *state, struct state_helper *subsequent_state, struct alphabet_symbols *read_symbols, struct alphabet_symbols *write_symbols, char movement) {
-    int new_deltas = read_symbols->symbol_count * write_symbols->symbol_count;
-
-    // If array empty create new one, else reallocate more memory
-    if (program->deltas_count == 0) {
-        program->deltas = malloc(new_deltas * sizeof(struct deltas*));
-    } else {
-        program->deltas = realloc(program->deltas, (program->deltas_count + new_deltas) * sizeof(struct deltas*));
-    }
-
+int generate_1tn_deltas(struct program *program, struct state_helper *state, struct state_helper *subsequent_state, struct alphabet_symbols *read_symbols, struct alphabet_symbols *write_symbols, char movement) {
     // create the different deltas and save them in the program struct
     for (int i = 0; i < read_symbols->symbol_count; ++i) {
         for (int j = 0; j < write_symbols->symbol_count; ++j) {
-            struct deltas *delta = malloc(sizeof(struct deltas));
-            delta->read_symbol = read_symbols->symbols[i];
-            delta->write_symbol = write_symbols->symbols[j];
-            delta->state = generate_state_str(program, state, delta->read_symbol, delta->write_symbol);
-            delta->subsequent_state = generate_state_str(program, subsequent_state, delta->read_symbol, delta->write_symbol);
-            delta->movement = movement;
-            program->deltas[program->deltas_count + (i * write_symbols->symbol_count) + j] = delta;
+            struct deltas *delta = add_delta(program);
+            if (delta == NULL || set_generated_delta(program, delta, state, subsequent_state, read_symbols->symbols[i], write_symbols->symbols[j], movement) == -1)
+                return -1;
         }
     }
-    program->deltas_count += new_deltas;
+    return 0;
 }
 
 /*
  * This function generates deltas which have no makros for read and write symbols
+ * Returns -1 if there is not enough memory for the delta or its states.
  */
-void generate_1_delta(struct program *program, struct state_helper *state, struct state_helper *subsequent_state, struct alphabet_symbols *read_symbols, struct alphabet_symbols *write_symbols, char movement) {
-    struct deltas *delta = malloc(sizeof(struct deltas));
+int generate_1_delta(struct program *program, struct state_helper *state, struct state_helper *subsequent_state, struct alphabet_symbols *read_symbols, struct alphabet_symbols *write_symbols, char movement) {
+    struct deltas *delta = add_delta(program);
     // create the different delta and save it in the program struct
-    delta->read_symbol = *read_symbols->symbols;
-    delta->write_symbol = *write_symbols->symbols;
-    delta->state = generate_state_str(program, state, delta->read_symbol, delta->write_symbol);
-    delta->subsequent_state = generate_state_str(program, subsequent_state, delta->read_symbol, delta->write_symbol);
-    delta->movement = movement;
+    if (delta == NULL || set_generated_delta(program, delta, state, subsequent_state, *read_symbols->symbols, *write_symbols->symbols, movement) == -1)
+        return -1;
+    return 0;
+}
 
-    if (program->deltas_count == 0) {
-        program->deltas_count = 1;
-        program->deltas = malloc(sizeof(struct deltas*));
-        program->deltas[0] = delta;
-    } else {
-        ++program->deltas_count;
-        program->deltas = realloc(program->deltas, program->deltas_count * sizeof(struct deltas*));
-        program->deltas[program->deltas_count - 1] = delta;
+/*
+ * Parse the fields of a delta line and count the deltas it expands to, without generating them.
+ * The line is tokenized in place, the fields are slices of the line and the helpers live in the scratch arena.
+ * Without resolve the listed symbols are only counted, see get_alphabet_symbols, then undefined symbols are not found.
+ * Returns -1 if the line is malformed, the error is set in the program.
+ */
+int parse_delta_line(struct program *program, struct slice line, int line_num, struct delta_line *delta_line, int resolve) {
+    struct slice state_str;
+    struct slice subsequent_state_str;
+    struct slice read_symbol_str;
+    struct slice write_symbol_str;
+
+    program->line_num = program->first_delta_line + line_num;
+    program->line_start = line.ptr;
+
+    // check formatting and size
+    if (line.len < 12 || line.ptr[0] != 'D')
+        return set_compile_error(program, COMPILE_ERROR_SYNTAX, program->line_start, "Delta number %d has wrong formatting!", line_num + 1);
+
+    // skip "D: "
+    line.ptr += 3;
+    line.len -= 3;
+
+    state_str = next_field(&line, ',');
+    read_symbol_str = next_field(&line, ',');
+    subsequent_state_str = next_field(&line, ',');
+    write_symbol_str = next_field(&line, ',');
+    if (line.ptr == NULL || line.len == 0)
+        return set_compile_error(program, COMPILE_ERROR_SYNTAX, NULL, "Delta number %d has wrong formatting!", line_num + 1);
+    delta_line->movement = *line.ptr;
+
+    struct alphabet_symbols *read_symbols = get_alphabet_symbols(program, read_symbol_str, resolve);
+    if (read_symbols == NULL)
+        return -1;
+    struct alphabet_symbols *write_symbols = get_alphabet_symbols(program, write_symbol_str, resolve);
+    if (write_symbols == NULL)
+        return -1;
+    delta_line->read_symbols = read_symbols;
+    delta_line->write_symbols = write_symbols;
+    delta_line->state = get_state_helper(program, state_str);
+    delta_line->subsequent_state = get_state_helper(program, subsequent_state_str);
+
+    if (read_symbols->type != write_symbols->type)
+        return set_compile_error(program, COMPILE_ERROR_MACRO, write_symbol_str.ptr, "Delta is malformed, read/write symbol makros don't match in delta number %d!", line_num + 1);
+    if (read_symbols->type == '1' && read_symbols->symbol_count != write_symbols->symbol_count)
+        return set_compile_error(program, COMPILE_ERROR_MACRO, write_symbol_str.ptr, "Number of read symbols of delta number %d are not equal the number of write symbols!\nRead symbols: %d, write symbols: %d",
+                                 line_num + 1, read_symbols->symbol_count, write_symbols->symbol_count);
+
+    // 1 to n lines multiply, with the maximum alphabet size this does not fit into an int
+    if (read_symbols->type == 'n')
+        delta_line->deltas_count = (long long) read_symbols->symbol_count * write_symbols->symbol_count;
+    else if (read_symbols->type == '1')
+        delta_line->deltas_count = read_symbols->symbol_count;
+    else
+        delta_line->deltas_count = 1;
+    return 0;
+}
+
+/*
+ * Check that the deltas of a line fit into the delta array and the delta limit before they are generated.
+ * total is the number of deltas of the program including the line. Returns -1 if they do not, the error names the line.
+ */
+static int check_line_deltas(struct program *program, long long line_deltas, long long total) {
+    // streamed deltas are not kept in the array, only the batch is indexed. A dry run reports the count instead.
+    if (program->delta_sink == NULL && !program->options.dry_run && total > INT32_MAX)
+        return set_compile_error(program, COMPILE_ERROR_LIMIT, NULL, "Delta line expands to %lld deltas, the program would have more than %d deltas!",
+                                 line_deltas, INT32_MAX);
+    if (program->options.max_deltas > 0 && total > program->options.max_deltas)
+        return set_compile_error(program, COMPILE_ERROR_LIMIT, NULL, "Delta line expands to %lld deltas, the program would have %lld deltas, more than the limit of %lld!",
+                                 line_deltas, total, program->options.max_deltas);
+    return 0;
+}
+
+/*
+ * Check the deltas of a line which was expanded by a worker or taken from the cache before they are merged into
+ * the program. Returns -1 if they exceed the delta array or the delta limit.
+ */
+int check_merged_deltas(struct program *program, int line_num, long long line_deltas) {
+    program->line_num = program->first_delta_line + line_num;
+    program->line_start = NULL;
+    return check_line_deltas(program, line_deltas, get_total_deltas_count(program) + line_deltas);
+}
+
+/*
+ * Check that the program does not have more states than the state limit after a delta line was expanded or merged.
+ * Returns -1 if it has, the error names the line.
+ */
+int check_state_limit(struct program *program, int line_num, int states_before) {
+    if (program->options.max_states == 0 || program->states.count <= program->options.max_states)
+        return 0;
+    program->line_num = program->first_delta_line + line_num;
+    return set_compile_error(program, COMPILE_ERROR_LIMIT, NULL, "Delta line adds %d states, the program would have %d states, more than the limit of %lld!",
+                             program->states.count - states_before, program->states.count, program->options.max_states);
+}
+
+/*
+ * Expand one delta line and add the generated deltas to the program struct.
+ * If expanded_line is given, it receives the range of the generated deltas and which states are substituted.
+ * Returns -1 if the line is malformed, exceeds the delta limit or there is not enough memory for its deltas,
+ * the error is set in the program.
+ */
+int expand_delta_line(struct program *program, struct slice line, int line_num, struct expanded_line *expanded_line) {
+    struct delta_line delta_line;
+    if (parse_delta_line(program, line, line_num, &delta_line, 1) == -1 || check_line_deltas(program, delta_line.deltas_count, get_total_deltas_count(program) + delta_line.deltas_count) == -1)
+        return -1;
+
+    int first_delta = program->deltas_count;
+    if (reserve_deltas(program, delta_line.deltas_count) == -1)
+        return -1;
+
+    // create the deltas
+    struct state_helper *state = delta_line.state;
+    struct state_helper *subsequent_state = delta_line.subsequent_state;
+    int result = 0;
+    switch (delta_line.read_symbols->type) {
+        case '0':
+            result = generate_1_delta(program, state, subsequent_state, delta_line.read_symbols, delta_line.write_symbols, delta_line.movement);
+            break;
+        case '1':
+            result = generate_1t1_deltas(program, state, subsequent_state, delta_line.read_symbols, delta_line.write_symbols, delta_line.movement);
+            break;
+        case 'n':
+            result = generate_1tn_deltas(program, state, subsequent_state, delta_line.read_symbols, delta_line.write_symbols, delta_line.movement);
+            break;
+    }
+    if (result == -1)
+        return -1;
+
+    if (expanded_line != NULL) {
+        expanded_line->first_delta = first_delta;
+        expanded_line->deltas_count = program->deltas_count - first_delta;
+        expanded_line->state_substituted = state->substitution_type != '0';
+        expanded_line->subsequent_state_substituted = subsequent_state->substitution_type != '0';
+    }
+
+    // all temporaries of the line are not needed anymore, the first block is kept for the next line
+    arena_clear(&program->scratch);
+    return 0;
+}
+
+/*
+ * Get the upper bound of the states a state name of a delta line generates: one per symbol it is substituted with.
+ */
+static int count_line_states(struct state_helper *state, struct delta_line *delta_line) {
+    if (state->substitution_type == 'r')
+        return delta_line->read_symbols->symbol_count;
+    if (state->substitution_type == 'w')
+        return delta_line->write_symbols->symbol_count;
+    return 1;
+}
+
+/*
+ * Pre-pass over the delta lines which counts the deltas they expand to and bounds the states, without generating
+ * anything. Fills the expansion budget of the program and stops at the first line which exceeds the delta limit.
+ * With resolve the listed symbols are looked up, so every error of the lines is found, without they are only
+ * counted, which is enough before the lines are expanded and costs a fraction of the expansion.
+ * Returns the number of delta lines or -1 if a line is malformed or exceeds the limit.
+ */
+int measure_delta_lines(struct program *program, struct line_reader *reader, int resolve) {
+    struct expansion_budget *budget = &program->budget;
+    struct slice line;
+    int line_count;
+
+    memset(budget, 0, sizeof(struct expansion_budget));
+    budget->max_states_count = program->states.count;
+    for (line_count = 0; line_reader_next(reader, &line); ++line_count) {
+        struct delta_line delta_line;
+        if (parse_delta_line(program, line, line_count, &delta_line, resolve) == -1)
+            return -1;
+        if (check_line_deltas(program, delta_line.deltas_count, budget->deltas_count + delta_line.deltas_count) == -1)
+            return -1;
+        budget->deltas_count += delta_line.deltas_count;
+        budget->max_states_count += count_line_states(delta_line.state, &delta_line) + count_line_states(delta_line.subsequent_state, &delta_line);
+        if (delta_line.deltas_count > budget->largest_line_deltas) {
+            budget->largest_line = program->line_num;
+            budget->largest_line_deltas = delta_line.deltas_count;
+        }
+        arena_clear(&program->scratch);
     }
+    budget->delta_lines = line_count;
+    budget->measured = 1;
+    return line_count;
 }
 
 /*
  * Parse delta part of the program file. Add an array of delta structs to the program struct.
+ * With more than one thread the lines are expanded in parallel. With a cache file only the lines which are
+ * not in the cache are expanded, the header hash identifies the headers the cache belongs to.
+ * Returns -1 if a delta line is malformed.
  */
-void parse_deltas(struct program *program, FILE *file_ptr, int line_count) {
-    size_t line_length;
-    size_t buffer_size = 0;
-    char *line;
-    char *tmp_line;
-    char *state_str;
-    char *subsequent_state_str;
-    char *read_symbol_str;
-    char *write_symbol_str;
-    char movement;
+int parse_deltas(struct program *program, struct line_reader *reader, uint64_t header_hash) {
+    struct slice line;
+    // a reused program keeps its delta array
     program->deltas_count = 0;
-    program->deltas = NULL;
+    if (program->delta_sink != NULL && program->deltas_capacity < STREAM_BATCH_SIZE) {
+        struct deltas *deltas = realloc(program->deltas, STREAM_BATCH_SIZE * sizeof(struct deltas));
+        if (deltas == NULL) {
+            program->line_num = 0;
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the delta batch!");
+        }
+        program->deltas = deltas;
+        program->deltas_capacity = STREAM_BATCH_SIZE;
+        count_heap_allocation(program, STREAM_BATCH_SIZE * sizeof(struct deltas));
+    }
 
-    for (int i = 0; i < line_count; ++i) {
-        line_length = getline(&line, &buffer_size, file_ptr);
-        tmp_line = strdup(line);
+    // with a delta limit the lines are measured first if they can be read again: a line which exceeds the limit is
+    // found before anything is expanded and the delta array is allocated once with its final size. Without a limit
+    // the pre-pass costs more than the growing array, every line is still checked before its deltas are generated.
+    if (program->options.max_deltas > 0 && !program->options.dry_run && program->options.cache_path == NULL
+        && line_reader_can_reset(reader)) {
+        struct line_reader_mark mark = line_reader_get_mark(reader);
+        if (measure_delta_lines(program, reader, 0) == -1)
+            return -1;
+        line_reader_reset(reader, mark);
+        program->line_num = 0;
+        if (reserve_deltas(program, program->budget.deltas_count) == -1)
+            return -1;
+    }
 
-        // check formatting and size
-        if (line_length < 12 || tmp_line[0] != 'D'){
-            printf("Delta number %d has wrong formatting!", i + 1);
-            exit(-1);
+    int line_count;
+    if (program->options.dry_run) {
+        line_count = measure_delta_lines(program, reader, 1);
+    } else if (program->options.cache_path != NULL) {
+        line_count = parse_deltas_incremental(program, reader, header_hash);
+    } else if (program->options.thread_count > 1) {
+        line_count = parse_deltas_parallel(program, reader, program->options.thread_count);
+    } else {
+        for (line_count = 0; line_reader_next(reader, &line); ++line_count) {
+            long deltas_before = get_total_deltas_count(program);
+            int states_before = program->states.count;
+            if (expand_delta_line(program, line, line_count, NULL) == -1 || check_state_limit(program, line_count, states_before) == -1
+                || record_line_stats(program, line_count, deltas_before, states_before) == -1)
+                return -1;
         }
+    }
+    if (line_count == -1)
+        return -1;
 
-        // skip "D: "
-        tmp_line += 3;
+    // at least one transition has to be present
+    if (line_count == 0) {
+        program->line_num = 0;
+        return set_compile_error(program, COMPILE_ERROR_INCOMPLETE, NULL, "File does not contain enough lines!");
+    }
 
-        state_str = strsep(&tmp_line, ",");
-        read_symbol_str = strsep(&tmp_line, ",");
-        subsequent_state_str = strsep(&tmp_line, ",");
-        write_symbol_str = strsep(&tmp_line, ",");
-        movement = *tmp_line;
+    if (program->delta_sink != NULL)
+        flush_streamed_deltas(program);
+    return 0;
+}
 
-        struct alphabet_symbols *read_symbols = get_alphabet_symbols(program, read_symbol_str);
-        struct alphabet_symbols *write_symbols = get_alphabet_symbols(program, write_symbol_str);
-        struct state_helper *state = get_state_helper(state_str);
-        struct state_helper *subsequent_state = get_state_helper(subsequent_state_str);
+/*
+ * Allocate an empty program struct. If options is NULL, the default options are used.
+ * Returns NULL if there is not enough memory.
+ */
+struct program *create_program(struct compile_options *options) {
+    struct program *program = calloc(1, sizeof(struct program));
+    if (program == NULL)
+        return NULL;
+    arena_init(&program->arena, 1 << 20);
+    arena_init(&program->scratch, 1 << 16);
+    program->options.thread_count = 1;
+    if (options != NULL)
+        program->options = *options;
+    return program;
+}
 
-        if (read_symbols->type != write_symbols->type) {
-            printf("Delta is malformed, read/write symbol makros don't match in delta number %d!\n", i + 1);
-            exit(-1);
-        }
+/*
+ * Parse the lines of the program file up to the delta lines: the state line, the alphabet and the symbol set definitions.
+ * The hash of the lines is continued in header_hash. Returns -1 if a line is missing or malformed.
+ */
+int parse_program_header(struct program *program, struct line_reader *reader, uint64_t *header_hash) {
+    struct slice line;
+    double start_time = get_seconds();
 
-        // create the deltas
-        switch (read_symbols->type) {
-            case '0':
-                generate_1_delta(program, state, subsequent_state, read_symbols, write_symbols, movement);
-                break;
-            case '1':
-                generate_1t1_deltas(program, state, subsequent_state, read_symbols, write_symbols, movement, i);
-                break;
-            case 'n':
-                generate_1tn_deltas(program, state, subsequent_state, read_symbols, write_symbols, movement);
-                break;
-        }
+    // parse states from first line
+    program->line_num = 1;
+    if (!line_reader_next(reader, &line))
+        return set_compile_error(program, COMPILE_ERROR_INCOMPLETE, NULL, "File does not contain enough lines!");
+    program->line_start = line.ptr;
+    *header_hash = hash_line(*header_hash, line);
+    if (parse_states(program, line) == -1)
+        return -1;
+    double states_time = get_seconds();
+    program->phase_times.states = states_time - start_time;
+
+    // parse alphabet from next line
+    program->line_num = 2;
+    if (!line_reader_next(reader, &line))
+        return set_compile_error(program, COMPILE_ERROR_INCOMPLETE, NULL, "File does not contain enough lines!");
+    program->line_start = line.ptr;
+    *header_hash = hash_line(*header_hash, line);
+    if (parse_alphabet(program, line) == -1)
+        return -1;
+    double alphabet_time = get_seconds();
+    program->phase_times.alphabet = alphabet_time - states_time;
 
+    // parse the definitions of named symbol sets, which can follow the alphabet
+    while (line_reader_next(reader, &line)) {
+        ++program->line_num;
+        program->line_start = line.ptr;
+        if (line.len == 0 || line.ptr[0] != 'N') {
+            line_reader_unread(reader);
+            break;
+        }
+        *header_hash = hash_line(*header_hash, line);
+        if (parse_symbol_set_definition(program, line) == -1)
+            return -1;
     }
+    program->first_delta_line = program->line_num;
+    program->phase_times.symbol_sets = get_seconds() - alphabet_time;
+    return 0;
 }
 
 /*
- * Parse the file containing the TM-Program and produce a struct containing its information.
+ * Parse all lines of the TM-Program into the program struct in a single pass.
+ * Returns -1 if the program contains an error, the error is set in the program.
  */
-struct program *parse_program(char *program_file_path) {
-    FILE *file_ptr = fopen(program_file_path, "r");
-    size_t line_length;
-    char *line = NULL;
-    size_t buffer_size = 0;
-    struct program *program = malloc(sizeof(struct program));
+int parse_program_lines(struct program *program, struct line_reader *reader) {
+    // hash of the state, alphabet and symbol set lines, which key the expansion cache
+    uint64_t header_hash = LINE_HASH_INIT;
+    struct phase_times *times = &program->phase_times;
+
+    // get all deltas/transitions of the program after the header
+    if (parse_program_header(program, reader, &header_hash) == -1)
+        return -1;
+    times->header = times->read + times->states + times->alphabet + times->symbol_sets;
+    double header_time = get_seconds();
+    int result = parse_deltas(program, reader, header_hash);
+    program->phase_times.deltas = get_seconds() - header_time;
+    program->phase_times.expanded_deltas = program->deltas_count + program->streamed_deltas_count;
+    return result;
+}
+
+/*
+ * Parse the file containing the TM-Program into the program struct.
+ * The file is read in a single pass. The path "-" reads the program from stdin.
+ * Returns -1 if the file can not be read or contains an error, the error is set in the program.
+ */
+int parse_program_file(struct program *program, char *program_file_path) {
+    struct line_reader reader;
 
     // check that file is found
-    if(file_ptr == NULL) {
-        printf("File %s not found!", program_file_path);
-        exit(1);
+    double start_time = get_seconds();
+    if (line_reader_open(&reader, program_file_path) == -1)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "File %s not found!", program_file_path);
+    program->phase_times.read = get_seconds() - start_time;
+
+    int result = parse_program_lines(program, &reader);
+    line_reader_close(&reader);
+    return result;
+}
+
+/*
+ * Check if a file is a compiled program in the binary format.
+ */
+int is_binary_program_file(char *program_file_path) {
+    char magic[4];
+    if (strcmp(program_file_path, "-") == 0)
+        return 0;
+    FILE *file_ptr = fopen(program_file_path, "r");
+    if (file_ptr == NULL)
+        return 0;
+    int is_binary = fread(magic, 1, 4, file_ptr) == 4 && memcmp(magic, BINARY_MAGIC, 4) == 0;
+    fclose(file_ptr);
+    return is_binary;
+}
+
+/*
+ * Check that a section of a binary program lies inside the file. Returns -1 if it does not.
+ */
+int check_binary_section(struct program *program, struct binary_header *header, uint64_t offset, uint64_t size) {
+    if (offset > header->file_size || size > header->file_size - offset)
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program is corrupt!");
+    return 0;
+}
+
+/*
+ * Check that a section of a binary program which is read as an array lies inside the file and starts at an
+ * offset aligned to 8 bytes, like every section written by write_binary_program. Returns -1 if it does not.
+ */
+static int check_binary_array(struct program *program, struct binary_header *header, uint64_t offset, uint64_t size) {
+    if (offset % 8 != 0)
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program is corrupt!");
+    return check_binary_section(program, header, offset, size);
+}
+
+/*
+ * Intern the names of a string table section of a binary program in the order of their indexes.
+ * Returns -1 if the section is corrupt.
+ */
+int load_binary_names(struct program *program, char *map, struct binary_header *header, uint64_t offsets_offset, uint64_t names_offset, uint32_t count, struct intern_table *names) {
+    uint32_t *offsets = (uint32_t*) (map + offsets_offset);
+    if (check_binary_array(program, header, offsets_offset, (count + (uint64_t) 1) * sizeof(uint32_t)) == -1
+        || check_binary_section(program, header, names_offset, offsets[count]) == -1)
+        return -1;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (offsets[i] >= offsets[i + 1])
+            return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program is corrupt!");
+        if (intern_string(names, map + names_offset + offsets[i], offsets[i + 1] - offsets[i] - 1) == -1)
+            return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the names of the binary program!");
     }
+    return 0;
+}
 
-    //count lines and reset to beginning of file
-    int line_count = get_file_line_count(file_ptr);
+/*
+ * Load the sections of a mapped binary program into the program struct. Returns -1 if the program is corrupt.
+ */
+int load_binary_sections(struct program *program, char *map, size_t map_size) {
+    struct binary_header *header = (struct binary_header*) map;
+    if (memcmp(header->magic, BINARY_MAGIC, 4) != 0 || header->version != BINARY_VERSION)
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program has unsupported version %u!", header->version);
+    if (header->file_size != (uint64_t) map_size || header->alphabet_size > MAX_ALPHABET_SIZE || header->deltas_count > INT32_MAX
+        || header->state_count > INTERN_MAX_COUNT)
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program is corrupt!");
+    // the counts size the tables, so all arrays have to fit into the file before anything is allocated
+    if (check_binary_array(program, header, header->state_name_offsets, (header->state_count + (uint64_t) 1) * sizeof(uint32_t)) == -1
+        || check_binary_array(program, header, header->alphabet_offsets, (header->alphabet_size + (uint64_t) 1) * sizeof(uint32_t)) == -1
+        || check_binary_array(program, header, header->listed_states, header->listed_state_count * (uint64_t) sizeof(uint32_t)) == -1
+        || check_binary_array(program, header, header->deltas, header->deltas_count * sizeof(struct binary_delta)) == -1)
+        return -1;
 
-    // check if enough lines are contained, line for states, alphabet and at least one transition has to be present
-    if(line_count < 3) {
-        printf("File does not contain enough lines!");
-        exit(1);
+    if (intern_table_reset(&program->states, header->state_count, &program->arena) == -1
+        || intern_table_reset(&program->alphabet, header->alphabet_size, &program->arena) == -1
+        || intern_table_reset(&program->symbol_set_names, 8, &program->arena) == -1)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the names of the binary program!");
+
+    if (load_binary_names(program, map, header, header->state_name_offsets, header->state_names, header->state_count, &program->states) == -1)
+        return -1;
+    uint32_t *listed_states = (uint32_t*) (map + header->listed_states);
+    for (uint32_t i = 0; i < header->listed_state_count; ++i) {
+        if (listed_states[i] >= header->state_count)
+            return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program is corrupt!");
+        if (list_state(program, listed_states[i]) == -1)
+            return -1;
     }
 
-    // parse states from next line
-    line_length = getline(&line, &buffer_size, file_ptr);
-    parse_states(program, line, line_length);
-    --line_count;
+    if (load_binary_names(program, map, header, header->alphabet_offsets, header->alphabet_names, header->alphabet_size, &program->alphabet) == -1)
+        return -1;
+    program->alphabet_indexes = arena_alloc(&program->arena, header->alphabet_size * sizeof(int));
+    if (program->alphabet_indexes == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the names of the binary program!");
+    for (uint32_t i = 0; i < header->alphabet_size; ++i)
+        program->alphabet_indexes[i] = i;
 
-    // parse alphabet from next line
-    line_length = getline(&line, &buffer_size, file_ptr);
-    parse_alphabet(program, line, line_length);
-    --line_count;
+    if (program->states.count != (int) header->state_count || program->alphabet.count != (int) header->alphabet_size)
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program is corrupt!");
 
-    // get all deltas/transitions of the program
-    parse_deltas(program, file_ptr, line_count);
+    struct binary_delta *binary_deltas = (struct binary_delta*) (map + header->deltas);
+    if (reserve_deltas(program, header->deltas_count) == -1)
+        return -1;
+    for (uint64_t i = 0; i < header->deltas_count; ++i) {
+        struct binary_delta *binary_delta = &binary_deltas[i];
+        if (binary_delta->state >= header->state_count || binary_delta->subsequent_state >= header->state_count
+            || binary_delta->read_symbol >= header->alphabet_size || binary_delta->write_symbol >= header->alphabet_size)
+            return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program is corrupt!");
+        struct deltas *delta = add_delta(program);
+        if (delta == NULL)
+            return -1;
+        delta->state = binary_delta->state;
+        delta->subsequent_state = binary_delta->subsequent_state;
+        delta->read_symbol = binary_delta->read_symbol;
+        delta->write_symbol = binary_delta->write_symbol;
+        delta->movement = binary_delta->movement;
+    }
+    return 0;
+}
 
-    if (line)
-        free(line);
-    fclose(file_ptr);
+/*
+ * Load a program file in the binary format into the program struct. Returns -1 if it can not be read or is corrupt.
+ */
+int load_binary_program_file(struct program *program, char *program_file_path) {
+    int fd = open(program_file_path, O_RDONLY);
+    struct stat file_stat;
+    if (fd == -1 || fstat(fd, &file_stat) == -1) {
+        if (fd != -1)
+            close(fd);
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "File %s not found!", program_file_path);
+    }
+    if ((size_t) file_stat.st_size < sizeof(struct binary_header)) {
+        close(fd);
+        return set_compile_error(program, COMPILE_ERROR_CORRUPT, NULL, "Binary program is corrupt!");
+    }
+    char *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not map file %s!", program_file_path);
 
-    return program;
+    int result = load_binary_sections(program, map, file_stat.st_size);
+    munmap(map, file_stat.st_size);
+    return result;
 }
 
 /*
- * Write the compiled program to a file.
+ * Finish a compilation. If it failed, the error of the program is copied to error and the program is freed.
+ * A program which could not be created (NULL) fails with a resource error.
+ * Returns the program or NULL if the compilation failed.
  */
-void write_compiled_program(struct program *program, char *filename) {
-    FILE *file_ptr = fopen(filename, "w");
+struct program *finish_compilation(struct program *program, int result, struct compile_error *error) {
+    if (program == NULL) {
+        if (error != NULL) {
+            *error = (struct compile_error) {.code = COMPILE_ERROR_RESOURCE, .line = 0, .column = 0};
+            snprintf(error->message, COMPILE_ERROR_SIZE, "Not enough memory for the program!");
+        }
+        return NULL;
+    }
+    if (result != -1)
+        return program;
+    if (error != NULL)
+        *error = program->error;
+    free_program(program);
+    return NULL;
+}
 
-    // write states
-    fprintf(file_ptr, "S: ");
-    for (int i = 0; i < program->state_count - 1; ++i) {
-        fprintf(file_ptr, "%s,", program->state_names[i]);
+/*
+ * Load a program which was compiled to the binary format.
+ * The program struct is the same as if the program was parsed, but the deltas are sorted by state and read symbol.
+ * Returns NULL if the program can not be loaded, then error describes why.
+ */
+struct program *load_binary_program(char *program_file_path, struct compile_options *options, struct compile_error *error) {
+    struct program *program = create_program(options);
+    if (program == NULL)
+        return finish_compilation(NULL, -1, error);
+    // the binary format does not contain the lines the deltas were expanded from
+    program->options.record_delta_lines = 0;
+    return finish_compilation(program, load_binary_program_file(program, program_file_path), error);
+}
+
+/*
+ * Empty the program, so it can be used for the next compilation. The allocated tables, the delta array and
+ * the first block of the arenas are kept to be reused.
+ */
+void reset_program(struct program *program) {
+    arena_clear(&program->arena);
+    arena_clear(&program->scratch);
+    // the tables are reset when the next program is parsed, until then they must not point into the cleared arena
+    program->states.count = 0;
+    program->alphabet.count = 0;
+    program->symbol_set_names.count = 0;
+    program->alphabet_indexes = NULL;
+    if (program->listed_capacity > 0)
+        memset(program->state_is_listed, 0, program->listed_capacity);
+    program->listed_state_count = 0;
+    program->deltas_count = 0;
+    program->delta_sink = NULL;
+    program->streamed_deltas_count = 0;
+    program->line_num = 0;
+    program->line_start = NULL;
+    program->first_delta_line = 0;
+    memset(&program->phase_times, 0, sizeof(struct phase_times));
+    memset(&program->budget, 0, sizeof(struct expansion_budget));
+    program->reused_lines = 0;
+    // the arrays, tables and arenas are reused, the allocations are counted from the next compilation on
+    memset(&program->allocations, 0, sizeof(struct allocation_stats));
+    struct arena *arenas[2] = {&program->arena, &program->scratch};
+    for (int i = 0; i < 2; ++i) {
+        arenas[i]->block_count = 0;
+        arenas[i]->block_bytes = 0;
+        arenas[i]->alloc_count = 0;
+        arenas[i]->alloc_bytes = 0;
     }
-    fprintf(file_ptr, "%s\n", program->state_names[program->state_count - 1]);
+    struct intern_table *tables[3] = {&program->states, &program->alphabet, &program->symbol_set_names};
+    for (int i = 0; i < 3; ++i) {
+        tables[i]->allocation_count = 0;
+        tables[i]->allocated_bytes = 0;
+    }
+    program->line_stats_count = 0;
+    memset(&program->error, 0, sizeof(struct compile_error));
+}
+
+/*
+ * Parse the file containing the TM-Program and produce a struct containing its information.
+ * Returns NULL if the program contains an error, then error describes it.
+ */
+struct program *parse_program(char *program_file_path, struct compile_options *options, struct compile_error *error) {
+    if (is_binary_program_file(program_file_path))
+        return load_binary_program(program_file_path, options, error);
+
+    struct program *program = create_program(options);
+    if (program == NULL)
+        return finish_compilation(NULL, -1, error);
+    return finish_compilation(program, parse_program_file(program, program_file_path), error);
+}
+
+/*
+ * Write the state and alphabet lines of the compiled program.
+ */
+void write_program_header(struct output_writer *writer, struct program *program) {
+    // write states
+    writer_write(writer, "S: ", 3);
+    writer_write_names(writer, &program->states, program->listed_states, program->listed_state_count);
 
     //write alphabet
-    fprintf(file_ptr, "G: ");
-    for (int i = 0; i < program->alphabet_size - 1; ++i) {
-        fprintf(file_ptr, "%s,", program->alphabet[i]);
+    writer_write(writer, "G: ", 3);
+    writer_write_names(writer, &program->alphabet, NULL, program->alphabet.count);
+}
+
+/*
+ * Compile the program file without keeping the deltas in memory.
+ * Since the state line has to be written first but is only known after all deltas are generated,
+ * the deltas are streamed into an unlinked temporary file which is appended after the header.
+ * Returns the program struct which contains all states but no deltas, or NULL if the compilation failed,
+ * then error describes why.
+ */
+struct program *compile_program_streaming(char *program_file_path, char *filename, struct compile_options *options, struct compile_error *error) {
+    struct output_writer delta_writer;
+    struct output_writer writer;
+    struct program *program = create_program(options);
+
+    if (program == NULL)
+        return finish_compilation(NULL, -1, error);
+    if (is_binary_program_file(program_file_path))
+        return finish_compilation(program, set_compile_error(program, COMPILE_ERROR_IO, NULL, "Binary programs can not be compiled in streaming mode!"), error);
+
+    // place the temporary file next to the output, it can get as large as the output
+    char *tmp_path;
+    if (strcmp(filename, "-") == 0) {
+        tmp_path = strdup("/tmp/macro_compiler_deltas_XXXXXX");
+    } else {
+        tmp_path = malloc(strlen(filename) + 8);
+        sprintf(tmp_path, "%s.XXXXXX", filename);
     }
-    fprintf(file_ptr, "%s\n", program->alphabet[program->alphabet_size - 1]);
+    int tmp_fd = mkstemp(tmp_path);
+    if (tmp_fd == -1) {
+        set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not create temporary file %s!", tmp_path);
+        free(tmp_path);
+        return finish_compilation(program, -1, error);
+    }
+    unlink(tmp_path);
+    free(tmp_path);
+
+    writer_init_fd(&delta_writer, tmp_fd);
+    program->delta_sink = &delta_writer;
+    int result = parse_program_file(program, program_file_path);
+    writer_flush(&delta_writer);
+
+    if (result == 0 && writer_open(&writer, filename) == -1)
+        result = set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not open output file %s!", filename);
+    if (result == 0) {
+        double start_time = get_seconds();
+        write_program_header(&writer, program);
+        lseek(tmp_fd, 0, SEEK_SET);
+        writer_append_fd(&writer, tmp_fd);
+        if (writer_close(&writer) == -1 || delta_writer.failed)
+            result = set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not write output file %s!", filename);
+        program->phase_times.write = get_seconds() - start_time;
+    }
+    writer_close(&delta_writer);
+    program->delta_sink = NULL;
+
+    return finish_compilation(program, result, error);
+}
+
+/*
+ * Free the program with all its deltas, states and alphabet symbols.
+ */
+void free_program(struct program *program) {
+    intern_table_free(&program->states);
+    intern_table_free(&program->alphabet);
+    intern_table_free(&program->symbol_set_names);
+    free(program->symbol_sets);
+    free(program->deltas);
+    free(program->delta_lines);
+    free(program->listed_states);
+    free(program->state_is_listed);
+    free(program->line_stats);
+    arena_free(&program->scratch);
+    arena_free(&program->arena);
+    free(program);
+}
+
+/*
+ * Write the compiled program in the text format to an opened writer.
+ */
+void write_program_text(struct output_writer *writer, struct program *program) {
+    write_program_header(writer, program);
 
     // write deltas
     for (int i = 0; i < program->deltas_count; ++i) {
-        struct deltas *delta = program->deltas[i];
-        fprintf(file_ptr, "D: %s,%s,%s,%s,%c\n", delta->state, program->alphabet[delta->read_symbol], delta->subsequent_state, program->alphabet[delta->write_symbol], delta->movement);
+        writer_write_delta(writer, program, &program->deltas[i]);
     }
-}
\ No newline at end of file
+}
+
+/*
+ * Write the compiled program to a file. Returns -1 if the file can not be written, the error is set in the program.
+ */
+int write_compiled_program(struct program *program, char *filename) {
+    struct output_writer writer;
+    program->line_num = 0;
+    if (writer_open(&writer, filename) == -1)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not open output file %s!", filename);
+
+    write_program_text(&writer, program);
+
+    if (writer_close(&writer) == -1)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not write output file %s!", filename);
+    return 0;
+}
+
+/*
+ * Round a file offset up to the alignment of the sections of the binary format.
+ */
+uint64_t align_binary_offset(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+/*
+ * Write zeros up to the given file offset.
+ */
+void write_binary_padding(struct output_writer *writer, uint64_t *position, uint64_t offset) {
+    static const char zeros[8] = {0};
+    writer_write(writer, zeros, offset - *position);
+    *position = offset;
+}
+
+/*
+ * Write the offsets and the null terminated names of an intern table as string table sections.
+ */
+void write_binary_names(struct output_writer *writer, uint64_t *position, struct intern_table *names, uint64_t offsets_offset, uint64_t names_offset) {
+    uint32_t offset = 0;
+    write_binary_padding(writer, position, offsets_offset);
+    for (int i = 0; i < names->count; ++i) {
+        writer_write(writer, (char*) &offset, sizeof(uint32_t));
+        offset += names->lengths[i] + 1;
+    }
+    writer_write(writer, (char*) &offset, sizeof(uint32_t));
+    *position += (names->count + 1) * sizeof(uint32_t);
+
+    write_binary_padding(writer, position, names_offset);
+    for (int i = 0; i < names->count; ++i)
+        writer_write(writer, names->names[i], names->lengths[i] + 1);
+    *position += offset;
+}
+
+/*
+ * Get the size of all null terminated names of an intern table.
+ */
+uint64_t get_binary_names_size(struct intern_table *names) {
+    uint64_t size = 0;
+    for (int i = 0; i < names->count; ++i)
+        size += names->lengths[i] + 1;
+    return size;
+}
+
+/*
+ * Write the compiled program in the binary format, see binary_format.h, to an opened writer.
+ * The deltas are sorted by (state, read symbol) with a counting sort, which also produces the transition index.
+ * Returns -1 if there is not enough memory for the index, the error is set in the program.
+ */
+int write_program_binary(struct output_writer *writer, struct program *program) {
+    struct binary_header header;
+    uint64_t position = 0;
+    uint64_t key_count = (uint64_t) program->states.count * program->alphabet.count;
+    program->line_num = 0;
+
+    // layout of the sections
+    memset(&header, 0, sizeof(struct binary_header));
+    memcpy(header.magic, BINARY_MAGIC, 4);
+    header.version = BINARY_VERSION;
+    header.state_count = program->states.count;
+    header.listed_state_count = program->listed_state_count;
+    header.alphabet_size = program->alphabet.count;
+    header.deltas_count = program->deltas_count;
+    header.state_name_offsets = align_binary_offset(sizeof(struct binary_header));
+    header.state_names = align_binary_offset(header.state_name_offsets + (header.state_count + (uint64_t) 1) * sizeof(uint32_t));
+    header.listed_states = align_binary_offset(header.state_names + get_binary_names_size(&program->states));
+    header.alphabet_offsets = align_binary_offset(header.listed_states + header.listed_state_count * (uint64_t) sizeof(uint32_t));
+    header.alphabet_names = align_binary_offset(header.alphabet_offsets + (header.alphabet_size + (uint64_t) 1) * sizeof(uint32_t));
+    header.deltas = align_binary_offset(header.alphabet_names + get_binary_names_size(&program->alphabet));
+    header.index = align_binary_offset(header.deltas + header.deltas_count * sizeof(struct binary_delta));
+    header.file_size = header.index + (key_count + 1) * sizeof(uint32_t);
+
+    // counting sort of the deltas by (state, read symbol), afterwards index[key] is the start of the deltas of key
+    uint32_t *index = calloc(key_count + 1, sizeof(uint32_t));
+    struct binary_delta *sorted_deltas = calloc(program->deltas_count, sizeof(struct binary_delta));
+    if (index == NULL || (sorted_deltas == NULL && program->deltas_count > 0)) {
+        free(index);
+        free(sorted_deltas);
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the transition index!");
+    }
+    for (int i = 0; i < program->deltas_count; ++i)
+        ++index[(uint64_t) program->deltas[i].state * program->alphabet.count + program->deltas[i].read_symbol + 1];
+    for (uint64_t key = 0; key < key_count; ++key)
+        index[key + 1] += index[key];
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas *delta = &program->deltas[i];
+        uint64_t key = (uint64_t) delta->state * program->alphabet.count + delta->read_symbol;
+        struct binary_delta *binary_delta = &sorted_deltas[index[key]++];
+        binary_delta->state = delta->state;
+        binary_delta->subsequent_state = delta->subsequent_state;
+        binary_delta->read_symbol = delta->read_symbol;
+        binary_delta->write_symbol = delta->write_symbol;
+        binary_delta->movement = delta->movement;
+    }
+    // placing moved every start to the start of the next key, shift them back
+    for (uint64_t key = key_count; key > 0; --key)
+        index[key] = index[key - 1];
+    index[0] = 0;
+
+    writer_write(writer, (char*) &header, sizeof(struct binary_header));
+    position = sizeof(struct binary_header);
+    write_binary_names(writer, &position, &program->states, header.state_name_offsets, header.state_names);
+
+    write_binary_padding(writer, &position, header.listed_states);
+    for (int i = 0; i < program->listed_state_count; ++i) {
+        uint32_t state = program->listed_states[i];
+        writer_write(writer, (char*) &state, sizeof(uint32_t));
+    }
+    position += header.listed_state_count * (uint64_t) sizeof(uint32_t);
+
+    write_binary_names(writer, &position, &program->alphabet, header.alphabet_offsets, header.alphabet_names);
+
+    write_binary_padding(writer, &position, header.deltas);
+    writer_write(writer, (char*) sorted_deltas, header.deltas_count * sizeof(struct binary_delta));
+    position += header.deltas_count * sizeof(struct binary_delta);
+
+    write_binary_padding(writer, &position, header.index);
+    writer_write(writer, (char*) index, (key_count + 1) * sizeof(uint32_t));
+
+    free(index);
+    free(sorted_deltas);
+    return 0;
+}
+
+/*
+ * Write the compiled program in the binary format to a file.
+ * Returns -1 if the file can not be written, the error is set in the program.
+ */
+int write_binary_program(struct program *program, char *filename) {
+    struct output_writer writer;
+    program->line_num = 0;
+    if (writer_open(&writer, filename) == -1)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not open output file %s!", filename);
+
+    int result = write_program_binary(&writer, program);
+
+    if (writer_close(&writer) == -1 && result == 0)
+        return set_compile_error(program, COMPILE_ERROR_IO, NULL, "Could not write output file %s!", filename);
+    return result;
+}
@@ -1,5 +1,57 @@
 #pragma once
 
-struct program *parse_program(char *program_file_path);
+#include "program_helper.h"
 
-void write_compiled_program(struct program *program, char *filename);
\ No newline at end of file
+struct program *create_program(struct compile_options *options);
+
+int parse_program_header(struct program *program, struct line_reader *reader, uint64_t *header_hash);
+
+int parse_program_lines(struct program *program, struct line_reader *reader);
+
+struct program *parse_program(char *program_file_path, struct compile_options *options, struct compile_error *error);
+
+struct program *compile_program_streaming(char *program_file_path, char *filename, struct compile_options *options, struct compile_error *error);
+
+void write_program_text(struct output_writer *writer, struct program *program);
+
+int write_program_binary(struct output_writer *writer, struct program *program);
+
+int write_compiled_program(struct program *program, char *filename);
+
+int write_binary_program(struct program *program, char *filename);
+
+int is_binary_program_file(char *program_file_path);
+
+struct program *load_binary_program(char *program_file_path, struct compile_options *options, struct compile_error *error);
+
+void reset_program(struct program *program);
+
+void free_program(struct program *program);
+
+int set_compile_error(struct program *program, enum compile_error_code code, const char *position, const char *format, ...);
+
+const char *get_compile_error_name(enum compile_error_code code);
+
+int list_state(struct program *program, int state_index);
+
+struct deltas *add_delta(struct program *program);
+
+int reserve_deltas(struct program *program, long long additional_deltas);
+
+long get_total_deltas_count(struct program *program);
+
+int record_line_stats(struct program *program, int line_num, long deltas_before, int states_before);
+
+void get_allocation_stats(struct program *program, struct allocation_stats *stats);
+
+void add_worker_allocations(struct program *program, struct program *worker_program);
+
+int check_merged_deltas(struct program *program, int line_num, long long line_deltas);
+
+int check_state_limit(struct program *program, int line_num, int states_before);
+
+int parse_delta_line(struct program *program, struct slice line, int line_num, struct delta_line *delta_line, int resolve);
+
+int measure_delta_lines(struct program *program, struct line_reader *reader, int resolve);
+
+int expand_delta_line(struct program *program, struct slice line, int line_num, struct expanded_line *expanded_line);
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+#include "parser.h"
+
+/*
+ * Transition, state or line with its number of executed steps, for sorting
+ */
+struct profile_entry {
+    long long steps;
+    int index;
+};
+
+/*
+ * Find the delta of every transition of the table, like build_transition_table. The counts start at 0.
+ * Returns -1 if the profile can not be allocated, then the error of the program describes it.
+ */
+int profile_init(struct run_profile *profile, struct transition_table *table, struct program *program) {
+    profile->entry_count = (size_t) table->state_count * table->alphabet_size;
+    profile->counts = calloc(profile->entry_count, sizeof(long long));
+    profile->deltas = malloc(profile->entry_count * sizeof(int));
+    if (profile->counts == NULL || profile->deltas == NULL) {
+        free_profile(profile);
+        program->line_num = 0;
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Could not allocate the profile for %d states and %d symbols!",
+                                 table->state_count, table->alphabet_size);
+    }
+    for (size_t i = 0; i < profile->entry_count; ++i)
+        profile->deltas[i] = -1;
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas *delta = &program->deltas[i];
+        if ((int) delta->state == table->accept_state || (int) delta->state == table->reject_state)
+            continue;
+        profile->deltas[(size_t) delta->state * table->alphabet_size + delta->read_symbol] = i;
+    }
+    return 0;
+}
+
+/*
+ * Run the program like run_program and count every executed transition. Runs are not accelerated, every
+ * step is a transition. Returns -1 if the tape can not grow.
+ */
+int run_program_profiled(struct transition_table *table, struct tape *tape, long long max_steps, struct run_profile *profile,
+                         struct run_result *result) {
+    const struct transition_action *actions = table->actions;
+    long long *counts = profile->counts;
+    long row = (long) table->start_state * table->alphabet_size;
+    long long steps = 0;
+    long long step_limit = max_steps == 0 ? INT64_MAX : max_steps;
+    int halted = 0;
+    int status = 0;
+    double start_time = get_seconds();
+
+    while (steps < step_limit) {
+        long head = tape->head;
+        long index = row + tape->cells[head];
+        const struct transition_action *action = &actions[index];
+        if (action->next_row < 0) {
+            halted = 1;
+            break;
+        }
+        ++counts[index];
+        tape->cells[head] = action->write_symbol;
+        head += action->movement;
+        row = action->next_row;
+        ++steps;
+
+        tape->head = head;
+        if (head < 0 || head >= tape->size) {
+            // the head is at most one cell outside of the tape
+            tape->head = head < 0 ? 0 : tape->size - 1;
+            if (tape_grow(tape) == -1) {
+                status = -1;
+                break;
+            }
+            tape->head += head < 0 ? -1 : 1;
+        }
+    }
+
+    result->state = row / table->alphabet_size;
+    result->steps = steps;
+    result->accelerated_steps = 0;
+    result->step_limit_reached = !halted && status == 0;
+    result->interrupted = 0;
+    result->seconds = get_seconds() - start_time;
+    return status;
+}
+
+/*
+ * Order entries by steps, most steps first, and entries with the same steps by index.
+ */
+static int compare_profile_entries(const void *a, const void *b) {
+    const struct profile_entry *entry = a;
+    const struct profile_entry *other = b;
+    if (entry->steps != other->steps)
+        return entry->steps > other->steps ? -1 : 1;
+    return entry->index - other->index;
+}
+
+/*
+ * Collect the entries with steps and sort them. Returns the number of entries.
+ */
+static int sort_profile_entries(const long long *steps, int count, struct profile_entry *entries) {
+    int entry_count = 0;
+    for (int i = 0; i < count; ++i) {
+        if (steps[i] > 0) {
+            entries[entry_count].steps = steps[i];
+            entries[entry_count++].index = i;
+        }
+    }
+    qsort(entries, entry_count, sizeof(struct profile_entry), compare_profile_entries);
+    return entry_count;
+}
+
+/*
+ * Check if a transition stays in its state, keeps the symbol and moves. Such loops are scanned by --accelerate.
+ */
+static int is_self_loop(struct transition_table *table, size_t index) {
+    struct transition_action *action = &table->actions[index];
+    long row = (long) (index / table->alphabet_size) * table->alphabet_size;
+    return action->next_row == row && action->write_symbol == index % table->alphabet_size && action->movement != 0;
+}
+
+/*
+ * Get the line of the program file of a delta, 0 if the lines were not recorded.
+ */
+static int get_delta_line(struct program *program, int delta) {
+    return program->delta_lines != NULL ? program->delta_lines[delta] : 0;
+}
+
+static double get_percentage(long long steps, long long total) {
+    return total > 0 ? 100.0 * steps / total : 0.0;
+}
+
+/*
+ * Print the transitions, states and delta lines with the most executed steps, top_count of each.
+ */
+void print_profile(FILE *file, struct program *program, struct transition_table *table, struct run_profile *profile, int top_count) {
+    int state_count = table->state_count;
+    long long *state_steps = calloc(state_count + 1, sizeof(long long));
+    long long *loop_steps = calloc(state_count + 1, sizeof(long long));
+    long long total_steps = 0;
+    int transition_count = 0;
+    int executed_count = 0;
+    int max_line = 0;
+
+    for (size_t i = 0; i < profile->entry_count; ++i) {
+        if (profile->deltas[i] == -1)
+            continue;
+        ++transition_count;
+        int line = get_delta_line(program, profile->deltas[i]);
+        max_line = line > max_line ? line : max_line;
+        if (profile->counts[i] == 0)
+            continue;
+        ++executed_count;
+        total_steps += profile->counts[i];
+        state_steps[i / table->alphabet_size] += profile->counts[i];
+        if (is_self_loop(table, i))
+            loop_steps[i / table->alphabet_size] += profile->counts[i];
+    }
+
+    // steps and executed transitions of every line of the program file
+    long long *line_steps = calloc(max_line + 1, sizeof(long long));
+    int *line_transitions = calloc(max_line + 1, sizeof(int));
+    for (size_t i = 0; i < profile->entry_count; ++i) {
+        if (profile->deltas[i] != -1 && profile->counts[i] > 0) {
+            int line = get_delta_line(program, profile->deltas[i]);
+            line_steps[line] += profile->counts[i];
+            ++line_transitions[line];
+        }
+    }
+
+    int entry_capacity = executed_count > state_count ? executed_count : state_count;
+    entry_capacity = entry_capacity > max_line + 1 ? entry_capacity : max_line + 1;
+    struct profile_entry *entries = malloc((entry_capacity + 1) * sizeof(struct profile_entry));
+    int state_entries = 0;
+    for (int state = 0; state < state_count; ++state)
+        state_entries += state_steps[state] > 0;
+    fprintf(file, "Profile: %lld steps, %d of %d transitions and %d of %d states executed\n", total_steps, executed_count,
+            transition_count, state_entries, state_count);
+
+    if (program->delta_lines != NULL) {
+        int line_entries = sort_profile_entries(line_steps, max_line + 1, entries);
+        fprintf(file, "Delta lines by steps:\n");
+        fprintf(file, "  %8s %14s %8s %12s\n", "line", "steps", "%", "transitions");
+        for (int i = 0; i < line_entries && i < top_count; ++i)
+            fprintf(file, "  %8d %14lld %8.2f %12d\n", entries[i].index, entries[i].steps, get_percentage(entries[i].steps, total_steps),
+                    line_transitions[entries[i].index]);
+    } else {
+        fprintf(file, "Delta lines by steps: the lines of the deltas are not known for a binary program\n");
+    }
+
+    sort_profile_entries(state_steps, state_count, entries);
+    fprintf(file, "States by steps:\n");
+    fprintf(file, "  %14s %8s %8s  %s\n", "steps", "%", "loops %", "state");
+    for (int i = 0; i < state_entries && i < top_count; ++i)
+        fprintf(file, "  %14lld %8.2f %8.2f  %s\n", entries[i].steps, get_percentage(entries[i].steps, total_steps),
+                get_percentage(loop_steps[entries[i].index], entries[i].steps), program->states.names[entries[i].index]);
+
+    // the transition entries are collected directly, the table can have more entries than an int array of steps
+    int transition_entries = 0;
+    for (size_t i = 0; i < profile->entry_count; ++i) {
+        if (profile->counts[i] > 0) {
+            entries[transition_entries].steps = profile->counts[i];
+            entries[transition_entries++].index = i;
+        }
+    }
+    qsort(entries, transition_entries, sizeof(struct profile_entry), compare_profile_entries);
+    fprintf(file, "Transitions by steps:\n");
+    fprintf(file, "  %14s %8s %8s  %s\n", "steps", "%", "line", "transition");
+    for (int i = 0; i < transition_entries && i < top_count; ++i) {
+        struct deltas *delta = &program->deltas[profile->deltas[entries[i].index]];
+        int line = get_delta_line(program, profile->deltas[entries[i].index]);
+        fprintf(file, "  %14lld %8.2f ", entries[i].steps, get_percentage(entries[i].steps, total_steps));
+        if (line > 0)
+            fprintf(file, "%8d", line);
+        else
+            fprintf(file, "%8s", "-");
+        fprintf(file, "  D: %s,%s,%s,%s,%c%s\n", program->states.names[delta->state], program->alphabet.names[delta->read_symbol],
+                program->states.names[delta->subsequent_state], program->alphabet.names[delta->write_symbol], delta->movement,
+                is_self_loop(table, entries[i].index) ? " (loop)" : "");
+    }
+
+    free(entries);
+    free(line_steps);
+    free(line_transitions);
+    free(loop_steps);
+    free(state_steps);
+}
+
+/*
+ * Write a name as a frame of a folded stack. ';' separates the frames, it is replaced by ',' which no state or
+ * symbol name contains.
+ */
+static void write_frame(FILE *file, const char *name) {
+    for (const char *c = name; *c != '\0'; ++c)
+        fputc(*c == ';' ? ',' : *c, file);
+}
+
+/*
+ * Write the executed transitions as folded stacks for flame graphs: one line "line N;state;"symbol" steps" for
+ * every executed transition, so the flame graph groups the steps by delta line and state. Without recorded
+ * lines the stacks start with the state.
+ */
+void write_folded_profile(FILE *file, struct program *program, struct transition_table *table, struct run_profile *profile) {
+    for (size_t i = 0; i < profile->entry_count; ++i) {
+        if (profile->counts[i] == 0)
+            continue;
+        int line = get_delta_line(program, profile->deltas[i]);
+        if (line > 0)
+            fprintf(file, "line %d;", line);
+        write_frame(file, program->states.names[i / table->alphabet_size]);
+        fputs(";\"", file);
+        write_frame(file, program->alphabet.names[i % table->alphabet_size]);
+        fprintf(file, "\" %lld\n", profile->counts[i]);
+    }
+}
+
+/*
+ * Free the counts of the profile.
+ */
+void free_profile(struct run_profile *profile) {
+    free(profile->counts);
+    free(profile->deltas);
+}
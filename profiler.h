@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdio.h>
+#include "simulator.h"
+
+/*
+ * Profiled run of a deterministic program: every executed transition is counted, so the hot transitions, states
+ * and delta lines of a slow machine can be found. A transition is mapped back to the line of the program file it
+ * was expanded from if the program was compiled with the record_delta_lines option.
+ */
+
+/*
+ * Execution counts of a profiled run
+ */
+struct run_profile {
+    // executions of every transition, indexed like the actions of the transition table
+    long long *counts;
+    // index of the delta of every transition in the program, -1 if the entry has no transition
+    int *deltas;
+    size_t entry_count;
+};
+
+int profile_init(struct run_profile *profile, struct transition_table *table, struct program *program);
+
+int run_program_profiled(struct transition_table *table, struct tape *tape, long long max_steps, struct run_profile *profile,
+                         struct run_result *result);
+
+void print_profile(FILE *file, struct program *program, struct transition_table *table, struct run_profile *profile, int top_count);
+
+void write_folded_profile(FILE *file, struct program *program, struct transition_table *table, struct run_profile *profile);
+
+void free_profile(struct run_profile *profile);
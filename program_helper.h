@@ -1,40 +1,235 @@
 #pragma once
 
+#include <stdint.h>
+#include "arena.h"
+#include "intern.h"
+#include "line_reader.h"
+#include "symbol_set.h"
+
+struct output_writer;
+
+// Maximum number of alphabet elements, symbols are stored as 16 bit indexes in the deltas
+#define MAX_ALPHABET_SIZE 65535
+
 /*
- * Struct contains one delta/transition of the program
+ * Struct contains one delta/transition of the program.
+ * Only contains indexes, the names are looked up in the program struct when writing the program.
  */
 struct deltas {
-    // index of state name in state_names in program struct
-    char *state;
-    // index of subsequent state name in state_names in program struct
-    char *subsequent_state;
-    // index of read alphabet element in alphabet in program struct
-    int read_symbol;
-    // index of write alphabet element in alphabet in program struct
-    int write_symbol;
+    // index of state name in states.names in program struct
+    uint32_t state;
+    // index of subsequent state name in states.names in program struct
+    uint32_t subsequent_state;
+    // index of read alphabet element in alphabet.names in program struct
+    uint16_t read_symbol;
+    // index of write alphabet element in alphabet.names in program struct
+    uint16_t write_symbol;
     // Move direction of head. Can be '<', '>' and '-'.
     char movement;
 };
 
+/*
+ * Wall clock time of the phases of a compilation in seconds
+ */
+struct phase_times {
+    // reading the state, alphabet and symbol set lines, the sum of the next four phases
+    double header;
+    // opening the program file and mapping or reading it
+    double read;
+    // parsing the state line
+    double states;
+    // parsing the alphabet line
+    double alphabet;
+    // parsing the symbol set definitions
+    double symbol_sets;
+    // expanding the delta lines, including writing them in streaming mode
+    double deltas;
+    // optimizing the compiled program, 0 without optimization
+    double optimize;
+    // writing the compiled program
+    double write;
+    // number of deltas the delta lines expanded to, before an optimization
+    long expanded_deltas;
+};
+
+/*
+ * Number and size of the heap allocations of a compilation and of the allocations handed out by the arenas
+ */
+struct allocation_stats {
+    long heap_count;
+    size_t heap_bytes;
+    long arena_count;
+    size_t arena_bytes;
+};
+
+/*
+ * Expansion of one delta line, collected with the collect_stats option
+ */
+struct line_stats {
+    // line of the program file
+    int line;
+    // number of deltas the line expanded to
+    int deltas_count;
+    // number of states the line added to the program, e.g. the substituted states of generate_state_str
+    int new_states_count;
+};
+
+/*
+ * Size of the compiled program, computed by a pre-pass over the delta lines before they are expanded
+ */
+struct expansion_budget {
+    // flag if the pre-pass was run, it is skipped for streamed input and incremental compilation
+    int measured;
+    int delta_lines;
+    // exact number of deltas the delta lines expand to
+    long long deltas_count;
+    // upper bound of the states: the declared states and the state names of every delta line, substituted names
+    // once per symbol. A name which is used by several lines is counted for each of them.
+    long long max_states_count;
+    // delta line which expands to the most deltas and their number
+    int largest_line;
+    long long largest_line_deltas;
+};
+
+/*
+ * Format the compiled program is written in
+ */
+enum output_format {
+    // "D:" lines like the program file
+    FORMAT_TEXT,
+    // binary format, see binary_format.h
+    FORMAT_BINARY,
+    // C source of a standalone executable which runs the machine, see codegen.h
+    FORMAT_C
+};
+
+/*
+ * Options which control how a program is compiled
+ */
+struct compile_options {
+    // number of threads which expand the delta lines, 1 expands them sequentially
+    int thread_count;
+    // file of the per line expansion cache for incremental compilation, NULL to expand every line
+    char *cache_path;
+    // flag if the expansion of every delta line is recorded in line_stats of the program
+    int collect_stats;
+    // maximum number of deltas and states of the compiled program, 0 for no limit
+    long long max_deltas;
+    long long max_states;
+    // flag if the delta lines are only measured into the expansion budget of the program and not expanded
+    int dry_run;
+    // flag if the program file line of every delta is recorded in delta_lines of the program
+    int record_delta_lines;
+};
+
+// Maximum length of an error message of a compilation
+#define COMPILE_ERROR_SIZE 256
+
+/*
+ * Kind of error which stopped a compilation
+ */
+enum compile_error_code {
+    COMPILE_OK = 0,
+    // a line is malformed
+    COMPILE_ERROR_SYNTAX,
+    // the program ends before the state line, the alphabet or the first delta line
+    COMPILE_ERROR_INCOMPLETE,
+    // a delta uses a symbol or symbol set which is not defined
+    COMPILE_ERROR_UNDEFINED,
+    // a symbol set is defined twice
+    COMPILE_ERROR_DUPLICATE,
+    // the read and write macros of a delta do not match
+    COMPILE_ERROR_MACRO,
+    // the program exceeds a limit like the maximum alphabet size
+    COMPILE_ERROR_LIMIT,
+    // a file can not be read or written
+    COMPILE_ERROR_IO,
+    // a binary program is corrupt
+    COMPILE_ERROR_CORRUPT,
+    // memory or threads could not be allocated
+    COMPILE_ERROR_RESOURCE,
+    // the output sink aborted the compilation
+    COMPILE_ERROR_SINK,
+    // the output format needs a deterministic program, but a (state, symbol) pair has more than one transition
+    COMPILE_ERROR_NONDETERMINISTIC
+};
+
+/*
+ * Error which stopped a compilation
+ */
+struct compile_error {
+    enum compile_error_code code;
+    // line of the program file the error was found in, starting at 1, or 0 if it does not belong to a line
+    int line;
+    // column of the line the error was found at, starting at 1, or 0 if it concerns the whole line
+    int column;
+    // description of the error, empty if there was no error
+    char message[COMPILE_ERROR_SIZE];
+};
+
 /*
  * Struct contains all information of the TM-Program
  */
 struct program {
-    // Array of all state names.
-    char **state_names;
-    // Number of different states.
-    int state_count;
-    // Array of all elements of the alphabet. Elements are strings.
-    char **alphabet;
-    // Array of alphabet indexes (from 0,1,...,alphabet_size)
+    // Interned state names. states.names is the array of all state names, states.count the number of states.
+    struct intern_table states;
+    // Indexes of the states in the order they are listed in the compiled program.
+    // States which are only used unsubstituted in deltas without being declared are not listed.
+    int *listed_states;
+    // Number of listed states
+    int listed_state_count;
+    // Flag for every state index if the state is contained in listed_states
+    char *state_is_listed;
+    // Allocated size of listed_states and state_is_listed
+    int listed_capacity;
+    // Interned alphabet elements. alphabet.names is the array of all elements, alphabet.count the alphabet size.
+    struct intern_table alphabet;
+    // Array of alphabet indexes (from 0,1,...,alphabet.count)
     // Helper for * Wildcards
     int *alphabet_indexes;
-    // Number of different alphabet elements
-    int alphabet_size;
-    // Array of all deltas/transitions of the Program
-    struct deltas **deltas;
+    // Names of the symbol sets defined in "N:" lines, the index of a name is the index in symbol_sets
+    struct intern_table symbol_set_names;
+    // Array of the named symbol sets
+    struct symbol_set *symbol_sets;
+    // Contiguous array of all deltas/transitions of the Program
+    struct deltas *deltas;
     //Number of all deltas/transitions
     int deltas_count;
+    // Allocated size of the deltas array, grows geometrically
+    int deltas_capacity;
+    // Line of the program file every delta was expanded from, parallel to deltas.
+    // Only recorded with the record_delta_lines option, NULL otherwise or for a loaded binary program
+    int *delta_lines;
+    // If set, deltas are written to this sink in batches instead of being kept in the deltas array
+    struct output_writer *delta_sink;
+    // Number of deltas which were written to the delta sink
+    long streamed_deltas_count;
+    // Arena for everything which lives as long as the program: state names and alphabet symbols
+    struct arena arena;
+    // Arena for temporaries while parsing a line, reset after each line
+    struct arena scratch;
+    // Options the program is compiled with
+    struct compile_options options;
+    // Line of the program file which is currently parsed and its start, used for the line and column of errors
+    int line_num;
+    const char *line_start;
+    // Line of the program file which contains the first delta line
+    int first_delta_line;
+    // Time of the compile phases, filled in by the parser and the caller which optimizes and writes
+    struct phase_times phase_times;
+    // Heap allocations of the growing arrays of the program and of the private programs of expansion workers.
+    // The allocations of the arenas and intern tables are counted by them, see get_allocation_stats.
+    struct allocation_stats allocations;
+    // Size of the compiled program computed before the delta lines are expanded
+    struct expansion_budget budget;
+    // Expansion of every delta line in line order, only recorded with the collect_stats option
+    struct line_stats *line_stats;
+    int line_stats_count;
+    int line_stats_capacity;
+    // Number of delta lines whose deltas were taken from the cache of the previous incremental compilation
+    int reused_lines;
+    // First error of the compilation. Functions which fail set it and return an error value instead of exiting.
+    struct compile_error error;
 };
 
 struct alphabet_symbols {
@@ -51,6 +246,35 @@ struct state_helper {
     // this flag shows if and which symbols should be substituted in the state name between prefix and postfix
     // possibilities: r: read symbol, w: write symbol, 0: None (just use the prefix as a standalone state name)
     char substitution_type;
-    char *state_prefix;
-    char *state_postfix;
-};
\ No newline at end of file
+    // prefix and postfix are slices of the delta line
+    struct slice state_prefix;
+    struct slice state_postfix;
+    // index of the state if there is no substitution, -1 until the state is first used
+    int state_index;
+};
+
+/*
+ * Fields of a parsed delta line, the deltas are generated from them
+ */
+struct delta_line {
+    struct state_helper *state;
+    struct state_helper *subsequent_state;
+    struct alphabet_symbols *read_symbols;
+    struct alphabet_symbols *write_symbols;
+    char movement;
+    // number of deltas the line expands to
+    long long deltas_count;
+};
+
+/*
+ * Information about the deltas which were generated from one delta line
+ */
+struct expanded_line {
+    // index of the first generated delta in the deltas array
+    int first_delta;
+    // number of generated deltas
+    int deltas_count;
+    // flags if the state and subsequent state names are substituted, then they are listed in the compiled program
+    char state_substituted;
+    char subsequent_state_substituted;
+};
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include "rle_tape.h"
+#include "checkpoint.h"
+
+// set by the signal handler of a run with checkpoints, the run writes a checkpoint and stops
+static volatile sig_atomic_t interrupt_requested = 0;
+
+static void request_interrupt(int signal_number) {
+    (void) signal_number;
+    interrupt_requested = 1;
+}
+
+/*
+ * Push cells of a symbol onto a stack, they are merged into the run on top if it has the same symbol.
+ * Blank cells on an empty stack are not stored, all cells beyond the stack are blank.
+ * Returns -1 if the stack can not grow, then the tape is not changed.
+ */
+int push_tape_run(struct rle_tape *tape, struct run_stack *stack, uint16_t symbol, uint64_t length) {
+    if (stack->count > 0 && stack->runs[stack->count - 1].symbol == symbol) {
+        stack->runs[stack->count - 1].length += length;
+        return 0;
+    }
+    if (stack->count == 0 && symbol == tape->blank_symbol)
+        return 0;
+    if (stack->count == stack->capacity) {
+        long capacity = stack->capacity > 0 ? stack->capacity * 2 : 1024;
+        struct tape_run *runs = realloc(stack->runs, capacity * sizeof(struct tape_run));
+        if (runs == NULL)
+            return -1;
+        stack->runs = runs;
+        stack->capacity = capacity;
+    }
+    stack->runs[stack->count].symbol = symbol;
+    stack->runs[stack->count].length = length;
+    ++stack->count;
+    long run_count = tape->left.count + tape->right.count;
+    if (run_count > tape->peak_run_count)
+        tape->peak_run_count = run_count;
+    return 0;
+}
+
+/*
+ * Remove cells from the top of a stack, they have to be part of the run on top.
+ */
+static void pop_cells(struct run_stack *stack, uint64_t length) {
+    if (stack->count == 0 || length == 0)
+        return;
+    struct tape_run *run = &stack->runs[stack->count - 1];
+    run->length -= length;
+    if (run->length == 0)
+        --stack->count;
+}
+
+/*
+ * Remove the cell next to the head from a stack and get its symbol.
+ */
+static uint16_t pop_cell(struct rle_tape *tape, struct run_stack *stack) {
+    if (stack->count == 0)
+        return tape->blank_symbol;
+    uint16_t symbol = stack->runs[stack->count - 1].symbol;
+    pop_cells(stack, 1);
+    return symbol;
+}
+
+/*
+ * Create the configuration at the start of a run with the contents and head of an uncompressed tape.
+ * Returns -1 if the runs can not be allocated, then the configuration has no runs.
+ */
+int rle_configuration_init(struct rle_configuration *configuration, struct transition_table *table, struct tape *tape) {
+    struct rle_tape *rle_tape = &configuration->tape;
+    rle_tape->left = (struct run_stack) {NULL, 0, 0};
+    rle_tape->right = (struct run_stack) {NULL, 0, 0};
+    rle_tape->blank_symbol = tape->blank_symbol;
+    rle_tape->symbol = tape->cells[tape->head];
+    rle_tape->position = tape->head - tape->origin;
+    rle_tape->peak_run_count = 0;
+    int result = 0;
+    for (long i = 0; i < tape->head && result == 0; ++i)
+        result = push_tape_run(rle_tape, &rle_tape->left, tape->cells[i], 1);
+    for (long i = tape->size - 1; i > tape->head && result == 0; --i)
+        result = push_tape_run(rle_tape, &rle_tape->right, tape->cells[i], 1);
+    if (result == -1) {
+        free_rle_tape(rle_tape);
+        rle_tape->left = (struct run_stack) {NULL, 0, 0};
+        rle_tape->right = (struct run_stack) {NULL, 0, 0};
+        return -1;
+    }
+
+    configuration->state = table->start_state;
+    configuration->steps = 0;
+    configuration->accelerated_steps = 0;
+    return 0;
+}
+
+/*
+ * Get the number of cells the head crosses with a self loop on the symbol under the head: the cell under the
+ * head and the run next to it if it has the same symbol, at most max_length. Beyond the stack the cells are blank,
+ * a loop on the blank symbol crosses max_length of them.
+ */
+static long long get_loop_length(struct rle_tape *tape, int movement, long long max_length) {
+    struct run_stack *stack = movement > 0 ? &tape->right : &tape->left;
+    long long length = 1;
+    if (stack->count > 0 && stack->runs[stack->count - 1].symbol == tape->symbol)
+        length += stack->runs[stack->count - 1].length;
+    else if (stack->count == 0 && tape->symbol == tape->blank_symbol)
+        length = max_length;
+    return length < max_length ? length : max_length;
+}
+
+/*
+ * Move the head length cells, all crossed cells have the symbol under the head. Returns -1 if the tape can not
+ * grow, then the head is not moved.
+ */
+static int move_head(struct rle_tape *tape, int movement, long long length) {
+    if (movement == 0)
+        return 0;
+    struct run_stack *from = movement > 0 ? &tape->right : &tape->left;
+    struct run_stack *to = movement > 0 ? &tape->left : &tape->right;
+    if (push_tape_run(tape, to, tape->symbol, length) == -1)
+        return -1;
+    pop_cells(from, length - 1);
+    tape->symbol = pop_cell(tape, from);
+    tape->position += movement * length;
+    return 0;
+}
+
+/*
+ * Run the program on the run length compressed tape from the state and step count of the configuration.
+ * max_steps limits the total number of steps including the steps before a resume, 0 for no limit.
+ * With a checkpoint file the configuration is written every checkpoint interval and when the run stops,
+ * SIGINT and SIGTERM stop the run after a checkpoint was written. Returns -1 if the tape can not grow, then the
+ * configuration is the one before the step which needed the memory.
+ */
+int run_program_rle(struct transition_table *table, struct rle_configuration *configuration, long long max_steps,
+                    struct checkpoint_options *checkpoint, struct run_result *result) {
+    const struct transition_action *actions = table->actions;
+    struct rle_tape *tape = &configuration->tape;
+    long row = (long) configuration->state * table->alphabet_size;
+    long long steps = configuration->steps;
+    long long accelerated_steps = configuration->accelerated_steps;
+    long long step_limit = max_steps == 0 ? INT64_MAX : max_steps;
+    int halted = 0;
+    int interrupted = 0;
+    int status = 0;
+    double start_time = get_seconds();
+    double checkpoint_time = start_time;
+    struct sigaction action, old_int_action, old_term_action;
+
+    if (checkpoint->path != NULL) {
+        interrupt_requested = 0;
+        action.sa_handler = request_interrupt;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = 0;
+        sigaction(SIGINT, &action, &old_int_action);
+        sigaction(SIGTERM, &action, &old_term_action);
+    }
+
+    while (!halted && !interrupted && status == 0 && steps < step_limit) {
+        // the steps are executed in chunks, between two chunks a checkpoint is written if it is due
+        long long chunk_end = step_limit - steps > RLE_CHECK_STEPS ? steps + RLE_CHECK_STEPS : step_limit;
+        while (steps < chunk_end) {
+            const struct transition_action *transition = &actions[row + tape->symbol];
+            if (transition->next_row < 0) {
+                halted = 1;
+                break;
+            }
+            long long length = 1;
+            uint16_t read_symbol = tape->symbol;
+            if (transition->next_row == row && transition->write_symbol == tape->symbol && transition->movement != 0)
+                length = get_loop_length(tape, transition->movement, chunk_end - steps);
+            else
+                tape->symbol = transition->write_symbol;
+            if (move_head(tape, transition->movement, length) == -1) {
+                tape->symbol = read_symbol;
+                status = -1;
+                break;
+            }
+            if (length > 1)
+                accelerated_steps += length;
+            row = transition->next_row;
+            steps += length;
+        }
+
+        configuration->state = row / table->alphabet_size;
+        configuration->steps = steps;
+        configuration->accelerated_steps = accelerated_steps;
+        if (checkpoint->path == NULL)
+            continue;
+        interrupted = interrupt_requested;
+        double now = get_seconds();
+        if (interrupted || now - checkpoint_time >= checkpoint->interval) {
+            // a failed checkpoint does not stop the run, the next one is tried after the interval
+            if (write_checkpoint(checkpoint->path, table, configuration) == -1)
+                fprintf(stderr, "Could not write checkpoint file %s!\n", checkpoint->path);
+            checkpoint_time = now;
+        }
+    }
+
+    if (checkpoint->path != NULL) {
+        if (!interrupted && write_checkpoint(checkpoint->path, table, configuration) == -1)
+            fprintf(stderr, "Could not write checkpoint file %s!\n", checkpoint->path);
+        sigaction(SIGINT, &old_int_action, NULL);
+        sigaction(SIGTERM, &old_term_action, NULL);
+    }
+
+    result->state = configuration->state;
+    result->steps = steps;
+    result->accelerated_steps = accelerated_steps;
+    result->step_limit_reached = !halted && !interrupted && status == 0;
+    result->interrupted = interrupted;
+    result->seconds = get_seconds() - start_time;
+    return status;
+}
+
+/*
+ * Get the symbol and length of a run of the tape from left to right: the left stack from the bottom, the cell
+ * under the head and the right stack from the top.
+ */
+static struct tape_run get_run(struct rle_tape *tape, long index) {
+    if (index < tape->left.count)
+        return tape->left.runs[index];
+    if (index == tape->left.count)
+        return (struct tape_run) {1, tape->symbol};
+    return tape->right.runs[tape->right.count - 1 - (index - tape->left.count - 1)];
+}
+
+/*
+ * Print the symbols between the leftmost and rightmost non blank cell of the tape like print_tape.
+ */
+void print_rle_tape(struct program *program, struct rle_tape *tape) {
+    long first = 0;
+    long last = tape->left.count + tape->right.count;
+    while (first <= last && get_run(tape, first).symbol == tape->blank_symbol)
+        ++first;
+    while (last >= first && get_run(tape, last).symbol == tape->blank_symbol)
+        --last;
+
+    printf("Tape: ");
+    int is_first = 1;
+    for (long i = first; i <= last; ++i) {
+        struct tape_run run = get_run(tape, i);
+        for (uint64_t j = 0; j < run.length; ++j) {
+            printf(is_first ? "%s" : ",%s", program->alphabet.names[run.symbol]);
+            is_first = 0;
+        }
+    }
+    printf("\n");
+    printf("Head position: %lld\n", tape->position);
+}
+
+/*
+ * Print the steps over runs and the number and memory of the runs of the tape.
+ */
+void print_rle_stats(struct rle_configuration *configuration) {
+    struct rle_tape *tape = &configuration->tape;
+    printf("Steps over runs: %lld (%.1f %%)\n", configuration->accelerated_steps,
+           configuration->steps > 0 ? 100.0 * configuration->accelerated_steps / configuration->steps : 0.0);
+    printf("Tape runs: %ld, at most %ld, %.1f MB\n", tape->left.count + tape->right.count, tape->peak_run_count,
+           (tape->left.capacity + tape->right.capacity) * sizeof(struct tape_run) / (1024.0 * 1024.0));
+}
+
+/*
+ * Free the runs of the tape.
+ */
+void free_rle_tape(struct rle_tape *tape) {
+    free(tape->left.runs);
+    free(tape->right.runs);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include "simulator.h"
+
+/*
+ * Run length compressed tape for long simulations. The tape is stored as runs of equal symbols in two stacks,
+ * one for each side of the head, with the run next to the head on top. A step pushes the cell under the head
+ * onto one stack and takes the next cell from the other, so it is O(1) and the memory grows with the number of
+ * runs instead of the length of the tape. The blank cells beyond both stacks are not stored.
+ *
+ * When the transition of the cell under the head stays in the state, keeps the symbol and moves, it is the
+ * transition of every cell of the run next to the head, so the head crosses the whole run in one move.
+ */
+
+// Number of steps between two checks for a checkpoint
+#define RLE_CHECK_STEPS (1 << 22)
+
+/*
+ * Run of cells with the same symbol
+ */
+struct tape_run {
+    // number of cells, at most 2^48 - 1
+    uint64_t length : 48;
+    uint64_t symbol : 16;
+};
+
+/*
+ * Runs on one side of the head, runs[count - 1] is next to the head
+ */
+struct run_stack {
+    struct tape_run *runs;
+    long count;
+    long capacity;
+};
+
+struct rle_tape {
+    struct run_stack left;
+    struct run_stack right;
+    // symbol of the cell under the head
+    uint16_t symbol;
+    // alphabet index of the blank symbol, see struct tape
+    uint16_t blank_symbol;
+    // position of the head relative to the first input cell
+    long long position;
+    // highest number of runs of the tape
+    long peak_run_count;
+};
+
+/*
+ * Configuration of a machine on a run length compressed tape, which is written to a checkpoint and resumed from it
+ */
+struct rle_configuration {
+    struct rle_tape tape;
+    int state;
+    long long steps;
+    // number of steps which were executed by crossing runs, included in steps
+    long long accelerated_steps;
+};
+
+/*
+ * Checkpoints which are written during a run
+ */
+struct checkpoint_options {
+    // file the configuration is written to, NULL for no checkpoints
+    const char *path;
+    // seconds between two checkpoints
+    double interval;
+};
+
+int rle_configuration_init(struct rle_configuration *configuration, struct transition_table *table, struct tape *tape);
+
+int push_tape_run(struct rle_tape *tape, struct run_stack *stack, uint16_t symbol, uint64_t length);
+
+int run_program_rle(struct transition_table *table, struct rle_configuration *configuration, long long max_steps,
+                    struct checkpoint_options *checkpoint, struct run_result *result);
+
+void print_rle_tape(struct program *program, struct rle_tape *tape);
+
+void print_rle_stats(struct rle_configuration *configuration);
+
+void free_rle_tape(struct rle_tape *tape);
@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "simulator.h"
+#include "parser.h"
+
+// Number of cells of a new tape, besides the input
+#define INITIAL_TAPE_SIZE 4096
+
+/*
+ * Build the dense transition table of a deterministic program. The rows of the accept and reject state stay empty,
+ * so the machine halts when it enters them. Returns -1 if the program has no start state, the table is too large
+ * or a (state, symbol) pair has more than one transition, then the error of the program describes it.
+ */
+int build_transition_table(struct transition_table *table, struct program *program) {
+    table->state_count = program->states.count;
+    table->alphabet_size = program->alphabet.count;
+    table->start_state = program->listed_state_count > 0 ? program->listed_states[0] : -1;
+    table->accept_state = program->listed_state_count > 1 ? program->listed_states[1] : -1;
+    table->reject_state = program->listed_state_count > 2 ? program->listed_states[2] : -1;
+    table->actions = NULL;
+    table->runs = NULL;
+    // the errors are not caused by a line of the program file
+    program->line_num = 0;
+
+    if (table->start_state == -1)
+        return set_compile_error(program, COMPILE_ERROR_INCOMPLETE, NULL, "The program has no start state!");
+
+    size_t entry_count = (size_t) table->state_count * table->alphabet_size;
+    if (entry_count > INT32_MAX)
+        return set_compile_error(program, COMPILE_ERROR_LIMIT, NULL, "The transition table for %d states and %d symbols is too large!",
+                                 table->state_count, table->alphabet_size);
+    table->actions = malloc(entry_count * sizeof(struct transition_action));
+    if (table->actions == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Could not allocate the transition table for %d states and %d symbols!",
+                                 table->state_count, table->alphabet_size);
+    for (size_t i = 0; i < entry_count; ++i)
+        table->actions[i].next_row = -1;
+
+    for (int i = 0; i < program->deltas_count; ++i) {
+        struct deltas *delta = &program->deltas[i];
+        if ((int) delta->state == table->accept_state || (int) delta->state == table->reject_state)
+            continue;
+
+        struct transition_action *action = &table->actions[(size_t) delta->state * table->alphabet_size + delta->read_symbol];
+        if (action->next_row != -1) {
+            free(table->actions);
+            table->actions = NULL;
+            return set_compile_error(program, COMPILE_ERROR_NONDETERMINISTIC, NULL,
+                                     "The program is nondeterministic, state %s has more than one transition for symbol \"%s\"!",
+                                     program->states.names[delta->state], program->alphabet.names[delta->read_symbol]);
+        }
+        action->next_row = delta->subsequent_state * table->alphabet_size;
+        action->write_symbol = delta->write_symbol;
+        action->movement = delta->movement == '<' ? -1 : (delta->movement == '>' ? 1 : 0);
+    }
+    return 0;
+}
+
+/*
+ * Free the runs of the transition table.
+ */
+static void free_transition_runs(struct transition_table *table) {
+    if (table->runs != NULL) {
+        for (int state = 0; state < table->state_count; ++state)
+            free(table->runs[state].loop_bits);
+        free(table->runs);
+        table->runs = NULL;
+    }
+}
+
+/*
+ * Find the run of every state, so run_program scans over runs instead of executing them step by step.
+ * A state has a run if it has transitions which stay in the state, write the read symbol and move. If it has
+ * such transitions in both directions, the direction with more symbols is used and the others are executed
+ * as usual steps. Returns -1 if there is not enough memory, then the table has no runs and the error of the
+ * program describes it.
+ */
+int find_state_runs(struct transition_table *table, struct program *program) {
+    int alphabet_size = table->alphabet_size;
+    table->runs = calloc(table->state_count, sizeof(struct state_run));
+    if (table->runs == NULL) {
+        program->line_num = 0;
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the runs of %d states!", table->state_count);
+    }
+
+    for (int state = 0; state < table->state_count; ++state) {
+        struct state_run *run = &table->runs[state];
+        long row = (long) state * alphabet_size;
+        int right_count = 0, left_count = 0;
+        for (int symbol = 0; symbol < alphabet_size; ++symbol) {
+            struct transition_action *action = &table->actions[row + symbol];
+            if (action->next_row == row && action->write_symbol == symbol) {
+                right_count += action->movement > 0;
+                left_count += action->movement < 0;
+            }
+        }
+        if (right_count == 0 && left_count == 0)
+            continue;
+
+        run->movement = right_count >= left_count ? 1 : -1;
+        int loop_count = run->movement > 0 ? right_count : left_count;
+        // scan for whichever of the loop symbols and the other symbols are fewer, a run without end symbols
+        // (every symbol loops) needs the loop symbols
+        if (loop_count < alphabet_size && alphabet_size - loop_count <= RUN_SCAN_SYMBOLS)
+            run->kind = RUN_UNTIL_SYMBOLS;
+        else if (loop_count <= RUN_SCAN_SYMBOLS)
+            run->kind = RUN_WHILE_SYMBOLS;
+        else {
+            run->kind = RUN_WHILE_BITS;
+            run->loop_bits = calloc((alphabet_size + 63) / 64, sizeof(uint64_t));
+            if (run->loop_bits == NULL) {
+                free_transition_runs(table);
+                program->line_num = 0;
+                return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Not enough memory for the runs of %d states!", table->state_count);
+            }
+        }
+        for (int symbol = 0; symbol < alphabet_size; ++symbol) {
+            struct transition_action *action = &table->actions[row + symbol];
+            int is_loop = action->next_row == row && action->write_symbol == symbol && action->movement == run->movement;
+            if (run->kind == RUN_WHILE_BITS && is_loop)
+                run->loop_bits[symbol / 64] |= (uint64_t) 1 << (symbol % 64);
+            else if ((run->kind == RUN_UNTIL_SYMBOLS && !is_loop) || (run->kind == RUN_WHILE_SYMBOLS && is_loop))
+                run->symbols[run->symbol_count++] = symbol;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Free the transition table.
+ */
+void free_transition_table(struct transition_table *table) {
+    free_transition_runs(table);
+    free(table->actions);
+}
+
+/*
+ * Look up an input symbol in the alphabet and write it to a cell. Returns -1 if the symbol is not part of the
+ * alphabet.
+ */
+static int set_input_symbol(struct program *program, uint16_t *cell, const char *symbol, size_t len) {
+    int index = intern_find(&program->alphabet, symbol, len);
+    if (index == -1)
+        return set_compile_error(program, COMPILE_ERROR_UNDEFINED, NULL, "Input symbol \"%.*s\" is not part of the alphabet!", (int) len, symbol);
+    *cell = index;
+    return 0;
+}
+
+/*
+ * Create a tape with the input and the head on the first input symbol.
+ * The input symbols are separated by ',', if the input contains no ',' every character is one symbol.
+ * Returns -1 if an input symbol is not part of the alphabet or the tape can not be allocated, then the error of
+ * the program describes it and the tape has no cells.
+ */
+int tape_init(struct tape *tape, struct program *program, const char *input) {
+    int blank = intern_find(&program->alphabet, " ", 1);
+    tape->blank_symbol = blank != -1 ? blank : 0;
+    program->line_num = 0;
+
+    size_t input_len = strlen(input);
+    tape->size = input_len + 2 * INITIAL_TAPE_SIZE;
+    tape->cells = malloc(tape->size * sizeof(uint16_t));
+    if (tape->cells == NULL)
+        return set_compile_error(program, COMPILE_ERROR_RESOURCE, NULL, "Could not allocate the tape for %zu input symbols!", input_len);
+    for (long i = 0; i < tape->size; ++i)
+        tape->cells[i] = tape->blank_symbol;
+    tape->origin = INITIAL_TAPE_SIZE;
+    tape->head = tape->origin;
+
+    long position = tape->origin;
+    int result = 0;
+    if (strchr(input, ',') != NULL) {
+        const char *symbol = input;
+        for (;;) {
+            const char *separator = strchr(symbol, ',');
+            size_t len = separator != NULL ? (size_t) (separator - symbol) : strlen(symbol);
+            result = set_input_symbol(program, &tape->cells[position++], symbol, len);
+            if (result == -1 || separator == NULL)
+                break;
+            symbol = separator + 1;
+        }
+    } else {
+        for (size_t i = 0; i < input_len && result == 0; ++i)
+            result = set_input_symbol(program, &tape->cells[position++], input + i, 1);
+    }
+    if (result == -1) {
+        free(tape->cells);
+        tape->cells = NULL;
+    }
+    return result;
+}
+
+/*
+ * Double the size of the tape. The old cells are moved to the middle, so there is room in both directions.
+ * Returns -1 if the cells can not be allocated, then the tape is not changed.
+ */
+int tape_grow(struct tape *tape) {
+    long offset = tape->size / 2;
+    long new_size = tape->size * 2;
+    uint16_t *cells = malloc(new_size * sizeof(uint16_t));
+    if (cells == NULL)
+        return -1;
+    for (long i = 0; i < offset; ++i)
+        cells[i] = tape->blank_symbol;
+    memcpy(cells + offset, tape->cells, tape->size * sizeof(uint16_t));
+    for (long i = offset + tape->size; i < new_size; ++i)
+        cells[i] = tape->blank_symbol;
+
+    free(tape->cells);
+    tape->cells = cells;
+    tape->size = new_size;
+    tape->head += offset;
+    tape->origin += offset;
+    return 0;
+}
+
+/*
+ * Free the cells of the tape.
+ */
+void free_tape(struct tape *tape) {
+    free(tape->cells);
+}
+
+/*
+ * Get the current time in seconds.
+ */
+double get_seconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/*
+ * Check if a cell ends a run.
+ */
+static inline int is_run_end(const struct state_run *run, uint16_t symbol) {
+    if (run->kind == RUN_WHILE_BITS)
+        return !(run->loop_bits[symbol / 64] >> (symbol % 64) & 1);
+    int found = 0;
+    for (int i = 0; i < run->symbol_count; ++i)
+        found |= symbol == run->symbols[i];
+    return run->kind == RUN_UNTIL_SYMBOLS ? found : !found;
+}
+
+#ifdef __SSE2__
+/*
+ * Compare 8 cells with the symbols of the run. Returns a mask with 2 bits per cell which are set if the cell
+ * ends the run.
+ */
+static inline int get_run_end_mask(const struct state_run *run, const __m128i *symbols, const uint16_t *cells) {
+    __m128i block = _mm_loadu_si128((const __m128i*) cells);
+    __m128i equal = _mm_cmpeq_epi16(block, symbols[0]);
+    for (int i = 1; i < run->symbol_count; ++i)
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi16(block, symbols[i]));
+    int mask = _mm_movemask_epi8(equal);
+    return run->kind == RUN_UNTIL_SYMBOLS ? mask : mask ^ 0xFFFF;
+}
+#endif
+
+/*
+ * Get the length of the run which starts at the head: the number of cells from the head in the direction of the
+ * run until the first cell which ends it, at most max_length and at most up to the end of the tape. The cell
+ * under the head is part of the run. With SSE2 the symbol runs compare 8 cells at once.
+ */
+static long scan_run(const struct state_run *run, const uint16_t *cells, long head, long size, long long max_length) {
+    long available = run->movement > 0 ? size - head : head + 1;
+    long limit = max_length < available ? (long) max_length : available;
+    long length = 1;
+
+#ifdef __SSE2__
+    if (run->kind != RUN_WHILE_BITS) {
+        __m128i symbols[RUN_SCAN_SYMBOLS];
+        for (int i = 0; i < run->symbol_count; ++i)
+            symbols[i] = _mm_set1_epi16(run->symbols[i]);
+        if (run->movement > 0) {
+            for (; length + 8 <= limit; length += 8) {
+                int mask = get_run_end_mask(run, symbols, cells + head + length);
+                if (mask != 0)
+                    return length + __builtin_ctz(mask) / 2;
+            }
+        } else {
+            // the block ends at the next cell left of the run, the highest cell which ends the run is the nearest
+            for (; length + 8 <= limit; length += 8) {
+                int mask = get_run_end_mask(run, symbols, cells + head - length - 7);
+                if (mask != 0)
+                    return length + 7 - (31 - __builtin_clz(mask)) / 2;
+            }
+        }
+    }
+#endif
+
+    for (; length < limit; ++length) {
+        if (is_run_end(run, cells[head + length * run->movement]))
+            return length;
+    }
+    return limit;
+}
+
+/*
+ * Run the program from the start state until it halts or max_steps transitions are executed (0 for no limit).
+ * The machine halts in the accept and reject state and when there is no transition for the read symbol.
+ * If the table has runs (see find_state_runs), a transition which starts a run moves the head over the whole
+ * run at once and counts one step per cell. Returns -1 if the tape can not grow, then the result contains the
+ * configuration where the run stopped.
+ */
+int run_program(struct transition_table *table, struct tape *tape, long long max_steps, struct run_result *result) {
+    const struct transition_action *actions = table->actions;
+    const struct state_run *runs = table->runs;
+    long long accelerated_steps = 0;
+    // the current state is kept as the offset of its row, so no multiplication is needed per step
+    long row = (long) table->start_state * table->alphabet_size;
+    long long steps = 0;
+    int halted = 0;
+    int status = 0;
+    double start_time = get_seconds();
+
+    while (!halted && (max_steps == 0 || steps < max_steps)) {
+        uint16_t *cells = tape->cells;
+        long head = tape->head;
+        long size = tape->size;
+        // the inner loop only checks the tape bounds, the step limit is folded into its iteration count
+        long long remaining = max_steps == 0 ? INT64_MAX : max_steps - steps;
+        long long executed = 0;
+
+        while (executed < remaining) {
+            const struct transition_action *action = &actions[row + cells[head]];
+            if (action->next_row < 0) {
+                halted = 1;
+                break;
+            }
+            if (action->next_row == row && runs != NULL) {
+                const struct state_run *run = &runs[row / table->alphabet_size];
+                if (run->kind != RUN_NONE && action->movement == run->movement && action->write_symbol == cells[head]) {
+                    long length = scan_run(run, cells, head, size, remaining - executed);
+                    head += length * run->movement;
+                    executed += length;
+                    accelerated_steps += length;
+                    if ((unsigned long) head >= (unsigned long) size)
+                        break;
+                    continue;
+                }
+            }
+            cells[head] = action->write_symbol;
+            head += action->movement;
+            row = action->next_row;
+            ++executed;
+            if ((unsigned long) head >= (unsigned long) size)
+                break;
+        }
+
+        steps += executed;
+        tape->head = head;
+        if (head < 0 || head >= tape->size) {
+            // the head is at most one cell outside of the tape
+            tape->head = head < 0 ? 0 : tape->size - 1;
+            if (tape_grow(tape) == -1) {
+                status = -1;
+                break;
+            }
+            tape->head += head < 0 ? -1 : 1;
+        }
+    }
+
+    result->state = row / table->alphabet_size;
+    result->steps = steps;
+    result->accelerated_steps = accelerated_steps;
+    result->step_limit_reached = !halted && status == 0;
+    result->interrupted = 0;
+    result->seconds = get_seconds() - start_time;
+    return status;
+}
+
+/*
+ * Print the symbols between the leftmost and rightmost non blank cell of the tape, separated by ','.
+ */
+void print_tape(struct program *program, struct tape *tape) {
+    long first = 0;
+    long last = tape->size - 1;
+    while (first <= last && tape->cells[first] == tape->blank_symbol)
+        ++first;
+    while (last >= first && tape->cells[last] == tape->blank_symbol)
+        --last;
+
+    printf("Tape: ");
+    for (long i = first; i <= last; ++i)
+        printf(i == first ? "%s" : ",%s", program->alphabet.names[tape->cells[i]]);
+    printf("\n");
+    printf("Head position: %ld\n", tape->head - tape->origin);
+}
+
+/*
+ * Print the halt state, the number of steps and the speed of a run.
+ */
+void print_run_result(struct program *program, struct transition_table *table, struct tape *tape, struct run_result *result, int print_tape_content) {
+    const char *reason;
+    if (result->interrupted)
+        reason = "interrupted";
+    else if (result->step_limit_reached)
+        reason = "step limit reached";
+    else if (result->state == table->accept_state)
+        reason = "accepted";
+    else if (result->state == table->reject_state)
+        reason = "rejected";
+    else
+        reason = "no transition";
+
+    printf("Halt state: %s (%s)\n", program->states.names[result->state], reason);
+    printf("Steps: %lld\n", result->steps);
+    printf("Time: %.3f s\n", result->seconds);
+    if (result->seconds > 0)
+        printf("Steps per second: %.0f\n", result->steps / result->seconds);
+    if (table->runs != NULL)
+        printf("Accelerated steps: %lld (%.1f %%)\n", result->accelerated_steps,
+               result->steps > 0 ? 100.0 * result->accelerated_steps / result->steps : 0.0);
+    if (print_tape_content)
+        print_tape(program, tape);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include "program_helper.h"
+
+/*
+ * Action of a deterministic transition in the dense transition table
+ */
+struct transition_action {
+    // offset of the row of the subsequent state (subsequent state * alphabet_size),
+    // -1 if there is no transition and the machine halts
+    int32_t next_row;
+    // index of the symbol which is written
+    uint16_t write_symbol;
+    // head movement: -1 left, 0 none, 1 right
+    int16_t movement;
+};
+
+// Maximum number of symbols a run is scanned for with vector compares, runs with more use a bitmap
+#define RUN_SCAN_SYMBOLS 4
+
+/*
+ * How the end of a run is found
+ */
+enum run_kind {
+    // the state has no run
+    RUN_NONE,
+    // the run ends at the first of the symbols (the symbols without a self loop)
+    RUN_UNTIL_SYMBOLS,
+    // the run continues while the cells are one of the symbols (the symbols with a self loop)
+    RUN_WHILE_SYMBOLS,
+    // the run continues while the cells are in loop_bits
+    RUN_WHILE_BITS
+};
+
+/*
+ * Run of a state: the symbols on which it stays in the state, keeps the symbol and moves in one direction.
+ * The head moves over such a run in one scan of the tape instead of one transition per cell.
+ */
+struct state_run {
+    enum run_kind kind;
+    // head movement of the run: -1 left, 1 right
+    int movement;
+    int symbol_count;
+    uint16_t symbols[RUN_SCAN_SYMBOLS];
+    // one bit per alphabet symbol for RUN_WHILE_BITS, NULL otherwise
+    uint64_t *loop_bits;
+};
+
+/*
+ * Dense state x symbol table of the deterministic transitions of a program.
+ * The action for state s and read symbol a is actions[s * alphabet_size + a].
+ */
+struct transition_table {
+    struct transition_action *actions;
+    int state_count;
+    int alphabet_size;
+    // start, accept and reject state are the first three states of the state line, -1 if not declared
+    int start_state;
+    int accept_state;
+    int reject_state;
+    // run of every state, NULL if runs are not accelerated
+    struct state_run *runs;
+};
+
+/*
+ * Tape which grows in both directions. Cells contain alphabet indexes.
+ */
+struct tape {
+    uint16_t *cells;
+    // alphabet index of the blank symbol " ", the first alphabet symbol if there is no " "
+    uint16_t blank_symbol;
+    // number of allocated cells
+    long size;
+    // index of the cell under the head
+    long head;
+    // index of the cell where the input started, to report the head position relative to the input
+    long origin;
+};
+
+/*
+ * Result of running a program
+ */
+struct run_result {
+    // state in which the machine stopped
+    int state;
+    // number of executed transitions
+    long long steps;
+    // number of steps which were executed by scanning runs, included in steps
+    long long accelerated_steps;
+    // set if the machine stopped because of the step limit
+    int step_limit_reached;
+    // set if the run was stopped by a signal after its configuration was written to a checkpoint
+    int interrupted;
+    // run time in seconds
+    double seconds;
+};
+
+int build_transition_table(struct transition_table *table, struct program *program);
+
+int find_state_runs(struct transition_table *table, struct program *program);
+
+void free_transition_table(struct transition_table *table);
+
+int tape_init(struct tape *tape, struct program *program, const char *input);
+
+int tape_grow(struct tape *tape);
+
+void free_tape(struct tape *tape);
+
+double get_seconds(void);
+
+int run_program(struct transition_table *table, struct tape *tape, long long max_steps, struct run_result *result);
+
+void print_tape(struct program *program, struct tape *tape);
+
+void print_run_result(struct program *program, struct transition_table *table, struct tape *tape, struct run_result *result, int print_tape_content);
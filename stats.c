@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "stats.h"
+#include "parser.h"
+
+// Number of buckets of the histogram of the deltas per line: 0-1, 2-10, 11-100, 101-1000 and more
+#define EXPANSION_BUCKET_COUNT 5
+
+/*
+ * Summary of the expansion of all delta lines
+ */
+struct expansion_summary {
+    int delta_lines;
+    long deltas_count;
+    long new_states_count;
+    // index into line_stats of the line with the most deltas and of the line which added the most states,
+    // -1 if there are no line statistics
+    int max_deltas_index;
+    int max_new_states_index;
+    // number of lines per bucket of deltas
+    int histogram[EXPANSION_BUCKET_COUNT];
+    // indexes into line_stats of the lines with the most deltas, most deltas first
+    int *top_lines;
+    int top_count;
+};
+
+static const char *bucket_names[EXPANSION_BUCKET_COUNT] = {"0-1", "2-10", "11-100", "101-1000", ">1000"};
+
+/*
+ * Get the histogram bucket of a number of deltas.
+ */
+static int get_bucket(int deltas_count) {
+    int bucket = 0;
+    for (int limit = 1; bucket < EXPANSION_BUCKET_COUNT - 1 && deltas_count > limit; limit *= 10)
+        ++bucket;
+    return bucket;
+}
+
+/*
+ * Summarize the line statistics of the program. The top lines are kept sorted by insertion, top_count is small.
+ */
+static void summarize_expansion(struct program *program, int top_count, struct expansion_summary *summary) {
+    struct line_stats *lines = program->line_stats;
+    summary->delta_lines = program->line_stats_count;
+    summary->deltas_count = 0;
+    summary->new_states_count = 0;
+    summary->max_deltas_index = -1;
+    summary->max_new_states_index = -1;
+    for (int i = 0; i < EXPANSION_BUCKET_COUNT; ++i)
+        summary->histogram[i] = 0;
+    summary->top_lines = malloc((top_count + 1) * sizeof(int));
+    summary->top_count = 0;
+
+    for (int i = 0; i < program->line_stats_count; ++i) {
+        summary->deltas_count += lines[i].deltas_count;
+        summary->new_states_count += lines[i].new_states_count;
+        ++summary->histogram[get_bucket(lines[i].deltas_count)];
+        if (summary->max_deltas_index == -1 || lines[i].deltas_count > lines[summary->max_deltas_index].deltas_count)
+            summary->max_deltas_index = i;
+        if (summary->max_new_states_index == -1 || lines[i].new_states_count > lines[summary->max_new_states_index].new_states_count)
+            summary->max_new_states_index = i;
+
+        // insert the line behind all lines with at least as many deltas, so equal lines stay in line order
+        int position = summary->top_count;
+        while (position > 0 && lines[summary->top_lines[position - 1]].deltas_count < lines[i].deltas_count)
+            --position;
+        if (position >= top_count)
+            continue;
+        int last = summary->top_count < top_count ? summary->top_count++ : top_count - 1;
+        for (int j = last; j > position; --j)
+            summary->top_lines[j] = summary->top_lines[j - 1];
+        summary->top_lines[position] = i;
+    }
+}
+
+/*
+ * Get the peak resident memory of the process in megabytes.
+ */
+static double get_peak_rss(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in kilobytes on Linux
+    return usage.ru_maxrss / 1024.0;
+}
+
+static double get_total_time(struct phase_times *times) {
+    return times->header + times->deltas + times->optimize + times->write;
+}
+
+/*
+ * Get the number of lines before the first delta line, 0 for a program which was not parsed from lines.
+ */
+static int get_header_lines(struct program *program) {
+    return program->first_delta_line > 0 ? program->first_delta_line - 1 : 0;
+}
+
+/*
+ * Print the statistics of the compilation in a human readable form.
+ */
+void print_compile_stats(FILE *file, struct program *program, int top_count) {
+    struct phase_times *times = &program->phase_times;
+    struct allocation_stats allocations;
+    struct expansion_summary summary;
+    get_allocation_stats(program, &allocations);
+    summarize_expansion(program, top_count, &summary);
+    struct line_stats *lines = program->line_stats;
+
+    fprintf(file, "Compile statistics:\n");
+    fprintf(file, "  lines:                %d (%d header, %d delta lines)\n", get_header_lines(program) + summary.delta_lines,
+            get_header_lines(program), summary.delta_lines);
+    fprintf(file, "  states:               %d (%d listed)\n", program->states.count, program->listed_state_count);
+    fprintf(file, "  alphabet:             %d symbols, %d symbol sets\n", program->alphabet.count, program->symbol_set_names.count);
+    fprintf(file, "  deltas:               %ld expanded, %ld written\n", times->expanded_deltas, get_total_deltas_count(program));
+    if (program->options.cache_path != NULL)
+        fprintf(file, "  incremental cache:    %d of %d delta lines reused\n", program->reused_lines, summary.delta_lines);
+    fprintf(file, "Phases:\n");
+    fprintf(file, "  read:                 %.4f s\n", times->read);
+    fprintf(file, "  states:               %.4f s\n", times->states);
+    fprintf(file, "  alphabet:             %.4f s\n", times->alphabet);
+    fprintf(file, "  symbol sets:          %.4f s\n", times->symbol_sets);
+    fprintf(file, "  delta expansion:      %.4f s\n", times->deltas);
+    fprintf(file, "  optimization:         %.4f s\n", times->optimize);
+    fprintf(file, "  writing:              %.4f s\n", times->write);
+    fprintf(file, "  total:                %.4f s\n", get_total_time(times));
+    fprintf(file, "Memory:\n");
+    fprintf(file, "  heap allocations:     %ld, %.1f MB\n", allocations.heap_count, allocations.heap_bytes / (1024.0 * 1024.0));
+    fprintf(file, "  arena allocations:    %ld, %.1f MB\n", allocations.arena_count, allocations.arena_bytes / (1024.0 * 1024.0));
+    fprintf(file, "  peak RSS:             %.1f MB\n", get_peak_rss());
+
+    if (summary.delta_lines > 0) {
+        fprintf(file, "Expansion:\n");
+        fprintf(file, "  deltas per line:      %.2f average, %d maximum in line %d\n", (double) summary.deltas_count / summary.delta_lines,
+                lines[summary.max_deltas_index].deltas_count, lines[summary.max_deltas_index].line);
+        fprintf(file, "  new states:           %ld, %d maximum in line %d\n", summary.new_states_count,
+                lines[summary.max_new_states_index].new_states_count, lines[summary.max_new_states_index].line);
+        fprintf(file, "  lines by deltas:     ");
+        for (int i = 0; i < EXPANSION_BUCKET_COUNT; ++i)
+            fprintf(file, " %s: %d%s", bucket_names[i], summary.histogram[i], i + 1 < EXPANSION_BUCKET_COUNT ? "," : "\n");
+        fprintf(file, "  lines with the most deltas:\n");
+        for (int i = 0; i < summary.top_count; ++i) {
+            struct line_stats *line = &lines[summary.top_lines[i]];
+            fprintf(file, "    line %-10d %10d deltas %10d new states\n", line->line, line->deltas_count, line->new_states_count);
+        }
+    }
+    free(summary.top_lines);
+}
+
+/*
+ * Print the statistics of the compilation as a JSON object.
+ */
+void print_compile_stats_json(FILE *file, struct program *program, int top_count) {
+    struct phase_times *times = &program->phase_times;
+    struct allocation_stats allocations;
+    struct expansion_summary summary;
+    get_allocation_stats(program, &allocations);
+    summarize_expansion(program, top_count, &summary);
+    struct line_stats *lines = program->line_stats;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"lines\": %d,\n", get_header_lines(program) + summary.delta_lines);
+    fprintf(file, "  \"delta_lines\": %d,\n", summary.delta_lines);
+    fprintf(file, "  \"states\": %d,\n", program->states.count);
+    fprintf(file, "  \"listed_states\": %d,\n", program->listed_state_count);
+    fprintf(file, "  \"alphabet_size\": %d,\n", program->alphabet.count);
+    fprintf(file, "  \"symbol_sets\": %d,\n", program->symbol_set_names.count);
+    fprintf(file, "  \"expanded_deltas\": %ld,\n", times->expanded_deltas);
+    fprintf(file, "  \"written_deltas\": %ld,\n", get_total_deltas_count(program));
+    fprintf(file, "  \"reused_delta_lines\": %d,\n", program->reused_lines);
+    fprintf(file, "  \"phases\": {\"read\": %.6f, \"states\": %.6f, \"alphabet\": %.6f, \"symbol_sets\": %.6f, "
+            "\"delta_expansion\": %.6f, \"optimization\": %.6f, \"writing\": %.6f, \"total\": %.6f},\n",
+            times->read, times->states, times->alphabet, times->symbol_sets, times->deltas, times->optimize, times->write,
+            get_total_time(times));
+    fprintf(file, "  \"allocations\": {\"heap_count\": %ld, \"heap_bytes\": %zu, \"arena_count\": %ld, \"arena_bytes\": %zu, "
+            "\"peak_rss_mb\": %.1f},\n", allocations.heap_count, allocations.heap_bytes, allocations.arena_count,
+            allocations.arena_bytes, get_peak_rss());
+    fprintf(file, "  \"expansion\": {\n");
+    fprintf(file, "    \"average_deltas_per_line\": %.4f,\n", summary.delta_lines > 0 ? (double) summary.deltas_count / summary.delta_lines : 0.0);
+    fprintf(file, "    \"max_deltas\": %d,\n", summary.delta_lines > 0 ? lines[summary.max_deltas_index].deltas_count : 0);
+    fprintf(file, "    \"max_deltas_line\": %d,\n", summary.delta_lines > 0 ? lines[summary.max_deltas_index].line : 0);
+    fprintf(file, "    \"new_states\": %ld,\n", summary.new_states_count);
+    fprintf(file, "    \"max_new_states\": %d,\n", summary.delta_lines > 0 ? lines[summary.max_new_states_index].new_states_count : 0);
+    fprintf(file, "    \"max_new_states_line\": %d,\n", summary.delta_lines > 0 ? lines[summary.max_new_states_index].line : 0);
+    fprintf(file, "    \"lines_by_deltas\": {");
+    for (int i = 0; i < EXPANSION_BUCKET_COUNT; ++i)
+        fprintf(file, "\"%s\": %d%s", bucket_names[i], summary.histogram[i], i + 1 < EXPANSION_BUCKET_COUNT ? ", " : "},\n");
+    fprintf(file, "    \"top_lines\": [");
+    for (int i = 0; i < summary.top_count; ++i) {
+        struct line_stats *line = &lines[summary.top_lines[i]];
+        fprintf(file, "%s\n      {\"line\": %d, \"deltas\": %d, \"new_states\": %d}", i > 0 ? "," : "", line->line,
+                line->deltas_count, line->new_states_count);
+    }
+    fprintf(file, "%s]\n", summary.top_count > 0 ? "\n    " : "");
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+    free(summary.top_lines);
+}
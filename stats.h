@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdio.h>
+#include "program_helper.h"
+
+/*
+ * Report of a compilation: the time of every phase, the heap and arena allocations and how the delta lines
+ * expanded. The per line figures are only available if the program was compiled with the collect_stats option.
+ * top_count is the number of lines with the most deltas which are listed.
+ */
+
+void print_compile_stats(FILE *file, struct program *program, int top_count);
+
+void print_compile_stats_json(FILE *file, struct program *program, int top_count);
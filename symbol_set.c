@@ -0,0 +1,92 @@
+#include <string.h>
+#include "symbol_set.h"
+
+/*
+ * Initialize an empty set for an alphabet of the given size. The words are allocated in the arena.
+ */
+void symbol_set_init(struct symbol_set *set, int alphabet_size, struct arena *arena) {
+    set->word_count = (alphabet_size + 63) / 64;
+    set->words = arena_alloc(arena, set->word_count * sizeof(uint64_t));
+    memset(set->words, 0, set->word_count * sizeof(uint64_t));
+}
+
+/*
+ * Add all symbols of the alphabet to the set.
+ */
+void symbol_set_fill(struct symbol_set *set, int alphabet_size) {
+    memset(set->words, 0xff, set->word_count * sizeof(uint64_t));
+    // clear the bits behind the last alphabet symbol
+    if (alphabet_size % 64 != 0)
+        set->words[set->word_count - 1] = (UINT64_C(1) << (alphabet_size % 64)) - 1;
+}
+
+/*
+ * Add one symbol to the set.
+ */
+void symbol_set_add(struct symbol_set *set, int symbol) {
+    set->words[symbol / 64] |= UINT64_C(1) << (symbol % 64);
+}
+
+/*
+ * Check if a symbol is contained in the set.
+ */
+int symbol_set_contains(struct symbol_set *set, int symbol) {
+    return (set->words[symbol / 64] >> (symbol % 64)) & 1;
+}
+
+/*
+ * Add all symbols of the other set to the set.
+ */
+void symbol_set_union(struct symbol_set *set, struct symbol_set *other) {
+    for (int i = 0; i < set->word_count; ++i)
+        set->words[i] |= other->words[i];
+}
+
+/*
+ * Remove all symbols from the set which are not contained in the other set.
+ */
+void symbol_set_intersect(struct symbol_set *set, struct symbol_set *other) {
+    for (int i = 0; i < set->word_count; ++i)
+        set->words[i] &= other->words[i];
+}
+
+/*
+ * Remove all symbols of the other set from the set.
+ */
+void symbol_set_subtract(struct symbol_set *set, struct symbol_set *other) {
+    for (int i = 0; i < set->word_count; ++i)
+        set->words[i] &= ~other->words[i];
+}
+
+/*
+ * Replace the content of the set with the content of the other set.
+ */
+void symbol_set_copy(struct symbol_set *set, struct symbol_set *other) {
+    memcpy(set->words, other->words, set->word_count * sizeof(uint64_t));
+}
+
+/*
+ * Get the number of symbols in the set.
+ */
+int symbol_set_count(struct symbol_set *set) {
+    int count = 0;
+    for (int i = 0; i < set->word_count; ++i)
+        count += __builtin_popcountll(set->words[i]);
+    return count;
+}
+
+/*
+ * Write the alphabet indexes of all symbols in the set in ascending order. Returns the number of symbols.
+ */
+int symbol_set_to_indexes(struct symbol_set *set, int *indexes) {
+    int count = 0;
+    for (int i = 0; i < set->word_count; ++i) {
+        uint64_t word = set->words[i];
+        while (word != 0) {
+            indexes[count++] = i * 64 + __builtin_ctzll(word);
+            // clear lowest set bit
+            word &= word - 1;
+        }
+    }
+    return count;
+}
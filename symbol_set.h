@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "arena.h"
+
+/*
+ * Set of alphabet symbols as a bitset over the alphabet indexes.
+ * Set operations work on 64 symbols at once.
+ */
+struct symbol_set {
+    // one bit for every alphabet index
+    uint64_t *words;
+    // number of 64 bit words
+    int word_count;
+};
+
+void symbol_set_init(struct symbol_set *set, int alphabet_size, struct arena *arena);
+
+void symbol_set_fill(struct symbol_set *set, int alphabet_size);
+
+void symbol_set_add(struct symbol_set *set, int symbol);
+
+int symbol_set_contains(struct symbol_set *set, int symbol);
+
+void symbol_set_union(struct symbol_set *set, struct symbol_set *other);
+
+void symbol_set_intersect(struct symbol_set *set, struct symbol_set *other);
+
+void symbol_set_subtract(struct symbol_set *set, struct symbol_set *other);
+
+void symbol_set_copy(struct symbol_set *set, struct symbol_set *other);
+
+int symbol_set_count(struct symbol_set *set);
+
+int symbol_set_to_indexes(struct symbol_set *set, int *indexes);
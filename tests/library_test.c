@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+#include "compiler.h"
+
+/*
+ * Test of the library interface in compiler.h, run by "make test" against libmacro_compiler.a.
+ * One context compiles a valid and an invalid source twice, so the test also checks that a failed
+ * compilation does not leave state behind which changes the next one.
+ */
+
+static const char valid_source[] =
+    "S: start,accept,reject\n"
+    "G:  ,a,b\n"
+    "D: start,[a|b],start,[a|b],>\n"
+    "D: start, ,accept, ,-\n";
+
+static const char valid_output[] =
+    "S: start,accept,reject\n"
+    "G:  ,a,b\n"
+    "D: start,a,start,a,>\n"
+    "D: start,b,start,b,>\n"
+    "D: start, ,accept, ,-\n";
+
+// the symbol c in line 3, column 10 is not part of the alphabet
+static const char invalid_source[] =
+    "S: start,accept,reject\n"
+    "G:  ,a,b\n"
+    "D: start,c,start,a,>\n";
+
+static int failures = 0;
+
+/*
+ * Count and print a failed check.
+ */
+static void fail(int round, const char *message) {
+    printf("FAIL: round %d: %s\n", round, message);
+    ++failures;
+}
+
+/*
+ * Compile the valid source and compare the output with the expected bytes.
+ */
+static void check_valid(struct compiler_context *context, int round) {
+    size_t output_size;
+    const char *output = compile_to_buffer(context, valid_source, sizeof(valid_source) - 1, NULL, &output_size);
+    if (output == NULL) {
+        fail(round, get_compiler_error(context)->message);
+        return;
+    }
+    if (output_size != sizeof(valid_output) - 1 || memcmp(output, valid_output, output_size) != 0)
+        fail(round, "the valid source is not compiled to the expected output");
+    if (get_compiler_error(context)->code != COMPILE_OK)
+        fail(round, "the valid source leaves an error in the context");
+    if (get_compiled_program(context) == NULL)
+        fail(round, "the valid source has no compiled program");
+}
+
+/*
+ * Compile the invalid source and check the code, line and column of the error.
+ */
+static void check_invalid(struct compiler_context *context, int round) {
+    size_t output_size;
+    if (compile_to_buffer(context, invalid_source, sizeof(invalid_source) - 1, NULL, &output_size) != NULL) {
+        fail(round, "the invalid source is compiled");
+        return;
+    }
+    struct compile_error *error = get_compiler_error(context);
+    if (error->code != COMPILE_ERROR_UNDEFINED)
+        fail(round, "the invalid source fails with the wrong error code");
+    if (error->line != 3 || error->column != 10)
+        fail(round, "the invalid source fails at the wrong line or column");
+    if (get_compiled_program(context) != NULL)
+        fail(round, "the invalid source has a compiled program");
+}
+
+int main(void) {
+    struct compiler_context *context = create_compiler_context();
+    if (context == NULL) {
+        printf("FAIL: the compiler context can not be created\n");
+        return 1;
+    }
+    for (int round = 1; round <= 2; ++round) {
+        check_valid(context, round);
+        check_invalid(context, round);
+    }
+    free_compiler_context(context);
+
+    if (failures > 0) {
+        printf("%d library checks failed\n", failures);
+        return 1;
+    }
+    printf("All library checks passed\n");
+    return 0;
+}
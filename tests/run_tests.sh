@@ -0,0 +1,118 @@
+#!/bin/sh
+# Tests of the compiler on the programs of the examples folder. Every example is compiled and compared with its
+# expected output in tests/expected, further checks are described where they are done.
+#
+# Usage: tests/run_tests.sh [compiler binary]
+
+COMPILER=${1:-./macro_compiler}
+# C compiler for the programs generated with --format=c
+CC=${CC:-cc}
+TESTS_DIR=$(dirname "$0")
+EXAMPLES_DIR="$TESTS_DIR/../examples"
+EXPECTED_DIR="$TESTS_DIR/expected"
+TMP_DIR=$(mktemp -d)
+trap 'rm -rf "$TMP_DIR"' EXIT
+FAILED=0
+
+fail() {
+    echo "FAIL: $1"
+    FAILED=$((FAILED + 1))
+}
+
+# same_file <expected> <actual> <description>
+same_file() {
+    cmp -s "$1" "$2" || fail "$3"
+}
+
+for PROGRAM in "$EXAMPLES_DIR"/*; do
+    NAME=$(basename "$PROGRAM")
+    OUT="$TMP_DIR/$NAME"
+    if ! "$COMPILER" "$PROGRAM" "$OUT.sequential" > /dev/null; then
+        fail "$NAME does not compile"
+        continue
+    fi
+    # the states are numbered in the order of their first use, so the output does not depend on the hash tables
+    same_file "$EXPECTED_DIR/$NAME.out" "$OUT.sequential" "$NAME differs from its expected output"
+    "$COMPILER" - "$OUT.stdin" < "$PROGRAM" > /dev/null
+    same_file "$OUT.sequential" "$OUT.stdin" "$NAME compiled from stdin differs"
+    "$COMPILER" --stream "$PROGRAM" "$OUT.stream" > /dev/null
+    same_file "$OUT.sequential" "$OUT.stream" "$NAME compiled with --stream differs"
+    "$COMPILER" -j 4 "$PROGRAM" "$OUT.threads" > /dev/null
+    same_file "$OUT.sequential" "$OUT.threads" "$NAME compiled with -j 4 differs"
+
+    # the binary format sorts the deltas by state and read symbol, so the deltas are compared in sorted order
+    "$COMPILER" --format=bin "$PROGRAM" "$OUT.bin" > /dev/null
+    "$COMPILER" "$OUT.bin" "$OUT.text" > /dev/null
+    sort "$OUT.sequential" > "$OUT.sequential.sorted"
+    sort "$OUT.text" > "$OUT.text.sorted"
+    same_file "$OUT.sequential.sorted" "$OUT.text.sorted" "$NAME converted to the binary format and back differs"
+done
+
+# binary programs with a state count which does not fit into the file and with a misaligned section are rejected,
+# the patches are offset:bytes of the header
+for PATCH in '8:\377\377\377\177' '32:\004'; do
+    cp "$TMP_DIR/prog1.txt.bin" "$TMP_DIR/corrupt.bin"
+    # shellcheck disable=SC2059
+    printf "${PATCH#*:}" | dd of="$TMP_DIR/corrupt.bin" bs=1 seek="${PATCH%%:*}" conv=notrunc 2> /dev/null
+    timeout 10 "$COMPILER" "$TMP_DIR/corrupt.bin" "$TMP_DIR/corrupt.out" | grep -q "corrupt" \
+        || fail "the binary program patched at ${PATCH%%:*} is not rejected as corrupt"
+done
+
+# example:input pairs which are run, the examples have to be deterministic
+RUN_CASES="binary_counter.mdelta:1,0,1 binary_counter.mdelta:1,1,1,1,1,1,1"
+RUN_STEPS="1 1000 1000000"
+# options of the execution engines, which have to stop in the same state after the same steps as the simulator
+ENGINES="--accelerate --block-size=4 --lazy --profile --rle-tape"
+
+# Run the cases with the given engine options for every step limit and print the state, steps and tape.
+run_cases() {
+    for CASE in $RUN_CASES; do
+        NAME=${CASE%%:*}
+        INPUT=${CASE#*:}
+        for STEPS in $RUN_STEPS; do
+            # shellcheck disable=SC2086
+            "$COMPILER" $1 --max-steps="$STEPS" --print-tape --run="$INPUT" "$EXAMPLES_DIR/$NAME" 2>&1 \
+                | grep -E '^(Halt state|Steps|Tape|Head position):'
+        done
+    done
+}
+
+run_cases "" > "$TMP_DIR/simulator.runs"
+same_file "$EXPECTED_DIR/runs.txt" "$TMP_DIR/simulator.runs" "the runs of the simulator differ from $EXPECTED_DIR/runs.txt"
+for ENGINE in $ENGINES; do
+    run_cases "$ENGINE" > "$TMP_DIR/engine.runs"
+    same_file "$TMP_DIR/simulator.runs" "$TMP_DIR/engine.runs" "the runs with $ENGINE differ from the simulator"
+done
+
+# The program generated with --format=c is an engine as well, it takes the step limit and the input itself.
+run_generated_cases() {
+    for CASE in $RUN_CASES; do
+        NAME=${CASE%%:*}
+        INPUT=${CASE#*:}
+        for STEPS in $RUN_STEPS; do
+            "$TMP_DIR/$NAME.generated" --max-steps="$STEPS" --print-tape "$INPUT" 2>&1 \
+                | grep -E '^(Halt state|Steps|Tape|Head position):'
+        done
+    done
+}
+
+GENERATED=1
+for CASE in $RUN_CASES; do
+    NAME=${CASE%%:*}
+    [ -x "$TMP_DIR/$NAME.generated" ] && continue
+    if ! "$COMPILER" --format=c "$EXAMPLES_DIR/$NAME" "$TMP_DIR/$NAME.c" > /dev/null \
+        || ! "$CC" -O1 -o "$TMP_DIR/$NAME.generated" "$TMP_DIR/$NAME.c"; then
+        fail "the C program generated from $NAME does not build with $CC"
+        GENERATED=0
+    fi
+done
+if [ "$GENERATED" -eq 1 ]; then
+    run_generated_cases > "$TMP_DIR/generated.runs"
+    same_file "$TMP_DIR/simulator.runs" "$TMP_DIR/generated.runs" "the runs of the generated C program differ from the simulator"
+fi
+
+if [ "$FAILED" -gt 0 ]; then
+    echo "$FAILED tests failed"
+    exit 1
+fi
+echo "All tests passed"
@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "writer.h"
+
+/*
+ * Initialize a writer for an already opened file descriptor.
+ */
+void writer_init_fd(struct output_writer *writer, int fd) {
+    writer->fd = fd;
+    writer->sink = NULL;
+    writer->sink_data = NULL;
+    writer->buffer = malloc(WRITER_BUFFER_SIZE);
+    writer->owns_buffer = 1;
+    writer->used = 0;
+    writer->failed = 0;
+}
+
+/*
+ * Initialize a writer which passes its output to a sink function. If buffer is not NULL, the writer uses it
+ * instead of allocating its own, it has to hold WRITER_BUFFER_SIZE bytes and is not freed by the writer.
+ */
+void writer_init_sink(struct output_writer *writer, output_sink sink, void *sink_data, char *buffer) {
+    writer->fd = -1;
+    writer->sink = sink;
+    writer->sink_data = sink_data;
+    writer->buffer = buffer != NULL ? buffer : malloc(WRITER_BUFFER_SIZE);
+    writer->owns_buffer = buffer == NULL;
+    writer->used = 0;
+    writer->failed = 0;
+}
+
+/*
+ * Create or truncate the output file and initialize the writer for it. The path "-" writes to stdout.
+ * Returns 0 on success and -1 if the file can not be opened.
+ */
+int writer_open(struct output_writer *writer, const char *path) {
+    int fd;
+    if (strcmp(path, "-") == 0)
+        fd = STDOUT_FILENO;
+    else
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return -1;
+    writer_init_fd(writer, fd);
+    return 0;
+}
+
+/*
+ * Write data directly to the file descriptor or the sink, retrying on partial writes.
+ */
+static void write_all(struct output_writer *writer, const char *data, size_t len) {
+    if (writer->sink != NULL) {
+        if (len > 0 && !writer->failed && writer->sink(writer->sink_data, data, len) != 0)
+            writer->failed = 1;
+        return;
+    }
+    while (len > 0 && !writer->failed) {
+        ssize_t written = write(writer->fd, data, len);
+        if (written <= 0) {
+            writer->failed = 1;
+            return;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+/*
+ * Write the buffered output to the file descriptor.
+ */
+void writer_flush(struct output_writer *writer) {
+    write_all(writer, writer->buffer, writer->used);
+    writer->used = 0;
+}
+
+/*
+ * Append data to the output. Data larger than the buffer is written directly, all data is written directly
+ * if the buffer could not be allocated.
+ */
+void writer_write(struct output_writer *writer, const char *data, size_t len) {
+    if (writer->buffer == NULL) {
+        write_all(writer, data, len);
+        return;
+    }
+    if (WRITER_BUFFER_SIZE - writer->used < len) {
+        writer_flush(writer);
+        if (len > WRITER_BUFFER_SIZE) {
+            write_all(writer, data, len);
+            return;
+        }
+    }
+    memcpy(writer->buffer + writer->used, data, len);
+    writer->used += len;
+}
+
+/*
+ * Write a comma separated list of the names with the given indexes, followed by a newline.
+ * If indexes is NULL, the names are written in the order of the table.
+ */
+void writer_write_names(struct output_writer *writer, struct intern_table *names, const int *indexes, int count) {
+    for (int i = 0; i < count; ++i) {
+        int index = indexes != NULL ? indexes[i] : i;
+        writer_write(writer, names->names[index], names->lengths[index]);
+        writer_write(writer, i < count - 1 ? "," : "\n", 1);
+    }
+}
+
+/*
+ * Write one delta as "D: state,read symbol,subsequent state,write symbol,movement" line.
+ * The names are copied with their precomputed lengths, no formatting is needed.
+ */
+void writer_write_delta(struct output_writer *writer, struct program *program, struct deltas *delta) {
+    const char *fields[4] = {
+        program->states.names[delta->state],
+        program->alphabet.names[delta->read_symbol],
+        program->states.names[delta->subsequent_state],
+        program->alphabet.names[delta->write_symbol]
+    };
+    size_t lengths[4] = {
+        program->states.lengths[delta->state],
+        program->alphabet.lengths[delta->read_symbol],
+        program->states.lengths[delta->subsequent_state],
+        program->alphabet.lengths[delta->write_symbol]
+    };
+    // "D: " + 4 fields with a comma each + movement + newline
+    size_t line_len = 3 + lengths[0] + lengths[1] + lengths[2] + lengths[3] + 4 + 2;
+
+    if (writer->buffer == NULL || WRITER_BUFFER_SIZE - writer->used < line_len) {
+        writer_flush(writer);
+        // very long names or no buffer, fall back to writing the parts separately
+        if (writer->buffer == NULL || line_len > WRITER_BUFFER_SIZE) {
+            writer_write(writer, "D: ", 3);
+            for (int i = 0; i < 4; ++i) {
+                writer_write(writer, fields[i], lengths[i]);
+                writer_write(writer, ",", 1);
+            }
+            writer_write(writer, &delta->movement, 1);
+            writer_write(writer, "\n", 1);
+            return;
+        }
+    }
+
+    char *out = writer->buffer + writer->used;
+    memcpy(out, "D: ", 3);
+    out += 3;
+    for (int i = 0; i < 4; ++i) {
+        memcpy(out, fields[i], lengths[i]);
+        out += lengths[i];
+        *out++ = ',';
+    }
+    *out++ = delta->movement;
+    *out++ = '\n';
+    writer->used += line_len;
+}
+
+/*
+ * Append the whole content of a file descriptor from its current offset, using the buffer for the copy.
+ * Without a buffer the writer fails.
+ */
+void writer_append_fd(struct output_writer *writer, int fd) {
+    writer_flush(writer);
+    if (writer->buffer == NULL) {
+        writer->failed = 1;
+        return;
+    }
+    ssize_t read_bytes;
+    while ((read_bytes = read(fd, writer->buffer, WRITER_BUFFER_SIZE)) > 0) {
+        write_all(writer, writer->buffer, read_bytes);
+    }
+    if (read_bytes == -1)
+        writer->failed = 1;
+}
+
+/*
+ * Flush the remaining output and close the file descriptor.
+ * Returns 0 on success and -1 if any write failed.
+ */
+int writer_close(struct output_writer *writer) {
+    writer_flush(writer);
+    if (writer->fd != -1 && writer->fd != STDOUT_FILENO && close(writer->fd) != 0)
+        writer->failed = 1;
+    if (writer->owns_buffer)
+        free(writer->buffer);
+    writer->buffer = NULL;
+    return writer->failed ? -1 : 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include "program_helper.h"
+
+// Size of the output buffer, the output is written in chunks of this size
+#define WRITER_BUFFER_SIZE (1 << 20)
+
+/*
+ * Receives the output of a writer in chunks. Returns 0 on success or -1 to stop the output, then the writer fails.
+ */
+typedef int (*output_sink)(void *user_data, const char *data, size_t len);
+
+/*
+ * Buffered output to a file descriptor or a sink. Text is collected in a large buffer which is written at once when full.
+ */
+struct output_writer {
+    // file descriptor of the output, -1 if the output goes to the sink
+    int fd;
+    // function which receives the output instead of a file descriptor
+    output_sink sink;
+    void *sink_data;
+    // collected output which is not yet written, WRITER_BUFFER_SIZE bytes, NULL if it could not be allocated,
+    // then the output is written unbuffered
+    char *buffer;
+    // set if the buffer belongs to the writer and is freed when it is closed
+    int owns_buffer;
+    // number of bytes in the buffer
+    size_t used;
+    // set if writing to the file descriptor failed
+    int failed;
+};
+
+int writer_open(struct output_writer *writer, const char *path);
+
+void writer_init_fd(struct output_writer *writer, int fd);
+
+void writer_init_sink(struct output_writer *writer, output_sink sink, void *sink_data, char *buffer);
+
+void writer_write(struct output_writer *writer, const char *data, size_t len);
+
+void writer_write_names(struct output_writer *writer, struct intern_table *names, const int *indexes, int count);
+
+void writer_write_delta(struct output_writer *writer, struct program *program, struct deltas *delta);
+
+void writer_flush(struct output_writer *writer);
+
+void writer_append_fd(struct output_writer *writer, int fd);
+
+int writer_close(struct output_writer *writer);